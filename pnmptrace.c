@@ -48,8 +48,12 @@
  *
  *    cat mqtt.txt | pnmptrace -H -n
  *
+ *    pnmptrace -I mqtt.txt -H -n
+ *
  *    mosquitto_sub -h node-api.packet.oarc.uk -t in/udp | pnmptrace
  *
+ *    pnmptrace -M node-api.packet.oarc.uk/in/udp
+ *
  *
  * Limitations:
  *
@@ -68,17 +72,39 @@
  *                   "mosquitto_sub" to download the JSON from the
  *                   server to stdout.
  *
- * To-Do:
- *
- *    - Possibly include an MQTT client, to make this self-contained,
- *      although that would prevent the program from using other
- *      data sources.
+ *    1.1   14/10/26 Single-pass JSON tokenizer with hashed field index.
+ *                   Block-buffered input, with SIMD object framing.
+ *                   "-I" option to replay a memory-mapped file.
+ *                   Buffered output, with "-F" flush policy.
+ *                   Optional multi-threaded decode pipeline ("-m").
+ *                   Filters compiled into an early-reject plan.
+ *                   Multiple and wildcard callsigns, e.g. "-t G8PZT*,
+ *                   M1BFP-1", or "@file".  Multiple types, "-T I,UI".
+ *                   Bounded table of interned callsigns, with IDs.
+ *                   Table-driven dispatch of protocols and frame types.
+ *                   Built-in MQTT client ("-M").
+ *                   Several inputs at once, merged in time order.
+ *                   Cross-reporter duplicate suppression ("-d").
+ *                   Compact, indexed binary capture files ("-B").
+ *                   Capture files written by a background thread, with
+ *                   rotation and compression, and a JSON archive.
+ *                   Statistics mode, per reporter and port ("-S").
+ *                   Prometheus metrics over HTTP ("-E").
+ *                   NetRom route table from NODES and INP3 ("-N").
+ *                   NetRom L4 circuit tracking ("-V").
+ *                   AX25 link health tracking ("-L").
+ *                   Structured NDJSON, CSV and binary output ("-O").
+ *                   Filters reloaded from a file on SIGHUP ("-e").
+ *                   Synthetic corpus ("-G") and benchmark ("-b").
+ *                   Profile of the stages and decoders ("-DPROFILE").
+ *                   Fields are extracted as bounded views, not copies.
+ *                   Objects of any size, in growable read buffers.
+ *                   JSON escapes decoded, and text made safe to show.
+ *                   Trace headers and timestamps cached per thread.
+ *                   Bounded input queue with overload policies ("-Q").
+ *                   Time range ("--from", "--to"), with seek by index.
  *
- *    - Wildcard callsign filtering, if it would be any use?
- *
- *    - Filtering on multiple callsigns, e.g. -t g8pzt*,KIDDER*,M1BFP-1
- *
- *    - Filter by multiple frame types simultaneously, e.g. "-T I,UI"
+ * To-Do:
  *
  *    - Decode L3RTT frame payload.
  *
@@ -124,30 +150,82 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <ctype.h>
+#include <limits.h>
+#include <errno.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
 
-static char VERSION[] = "1.0";
+#if defined(PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>  // For __rdtsc()
+#endif
+
+#ifndef WIN32
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static char VERSION[] = "1.1";
 static char Margin[] = "\n    ";  // Left margin for L3/L4 layers
 
 /* If filters are populated, they restrict the display to frames whose
  * fields match the filters. Unpopulated filters have no effect. The
- * compiler should set all these to null strings
+ * compiler should set all these to empty sets.
+ *
+ * A callsign filter may hold any number of exact callsigns, which are
+ * kept normalised (upper case, without "-0") in an open-addressed hash
+ * set, and any number of prefix wildcards such as "G8PZT*", which are
+ * kept in a trie.  Either way a match costs one pass over the callsign
+ * being tested, however many callsigns are in the filter.  The frame
+ * type and protocol filters are short lists of mnemonics.
  * */
-static char ReportFilter [16];   // Callsign to accept reports from
-static char SrcFilter [16];      // Source callsign filter
-static char DstFilter [16];      // Destination callsign filter
-static char AllFilter [16];      // Callsign to filter to/from
-static char ProtoFilter [16];    // Protocol to filter by
-static char TypeFilter [16];     // For filtering by L2Type
-static int  PortFilter = 0;      // For filtering by port number
-static int  DisplayWidth = 80;
-
-// TraceFlags control display options & filters
-static int  TraceFlags = 0x7ff;
+#define  CALL_MAXLEN    16       // Longest callsign stored, inc null
+#define  TRIE_CHARS     38       // A-Z, 0-9, '-' and "anything else"
+#define  LIST_MAX       16       // Max mnemonics in a type/proto list
+
+typedef struct trienode
+   {
+   struct trienode   *child [TRIE_CHARS];
+   int               wild;       // A wildcard prefix ends here
+   } TRIENODE;
+
+typedef struct
+   {
+   char     desc [80];           // Option value(s), for display
+   int      count;               // Number of callsigns and wildcards
+   int      used;                // Number of hash slots in use
+   int      size;                // Number of hash slots, power of 2
+   char     (*slot) [CALL_MAXLEN];  // Hash set of exact callsigns
+   TRIENODE *trie;               // Wildcard prefixes, or NULL
+   } CALLSET;
+
+typedef struct
+   {
+   char     desc [80];           // Option value(s), for display
+   int      count;               // Number of items
+   char     item [LIST_MAX][16];
+   } STRLIST;
+
+#define  MAX_FILTERS    8        // Max tests in the filter plan
 
 #define  TRACE_UI       0x01     // Unnumbered information frames (on)
 #define  TRACE_NETROM   0x02     // Trace Netrom L3/L4 layers (on)
@@ -165,1052 +243,10658 @@ static int  TraceFlags = 0x7ff;
 #define  TRACE_QUIET    0x2000   // Output to file only, no echo (off)
 #define  TRACE_COLOR2FILE  0x4000   // Send colour to file (off)
 #define  TRACE_WARNINGS 0x8000   // Display warnings of bad fields
+#define  TRACE_DEFAULT  0x7ff    // Those marked (on)
+
+#define  DISPLAY_WIDTH  80       // Default display width
 
-static char CaptureFile [256];   // Capture file name
-static FILE *FpCapture = NULL;   // For capturing output to file
+/* The filters and display options are held in a "snapshot", which is
+ * never changed once it is in use.  With "-e", SIGHUP builds a new
+ * snapshot from the command line and the file, and swaps it in, and
+ * each thread picks up the current snapshot at the start of each
+ * record, so a reload takes no locks on the decode path (see the
+ * CONFIGURATION FUNCTIONS).
+ * */
+typedef struct
+   {
+   int         traceFlags;       // TRACE_xxx display options & filters
+   int         displayWidth;     // Display width, columns
+   int         portFilter;       // For filtering by port number
+   CALLSET     reportFilter;     // Callsigns to accept reports from
+   CALLSET     srcFilter;        // Source callsign filter
+   CALLSET     dstFilter;        // Destination callsign filter
+   CALLSET     allFilter;        // Callsigns to filter to/from
+   STRLIST     protoFilter;      // Protocols to filter by
+   STRLIST     typeFilter;       // For filtering by L2Type
+   struct filter *plan;          // Filter plan, see filter_build()
+   int         numFilters;       // Tests in the plan
+   uint64_t    typeMask;         // L2Types rows for "-T"
+   uint64_t    protoMask;        // Protocols rows for "-P"
+   int         typeOther;        // "-T" names some not in L2Types
+   int         protoOther;       // "-P" names some not in Protocols
+   unsigned    gen;              // Incremented by each reload
+   } CONFIG;
+
+// Built from the command line, and any "-e" file, at startup
+static CONFIG  BaseConfig = { TRACE_DEFAULT, DISPLAY_WIDTH };
+
+static CONFIG  *Config = &BaseConfig;  // The current snapshot
+static __thread const CONFIG *Cfg = &BaseConfig;  // Thread's snapshot
+
+static volatile sig_atomic_t Quit = 0; // Set by SIGINT or SIGTERM
 
 
 //######################################################################
 //                         JSON FUNCTIONS
 //######################################################################
 
-/**********************************************************************/
-/* Purpose:    Find a named JSON object by name
- * Called by:  json_findArray() and json_getValue()
- * Arguments:  Pointer to serialised JSON object string. Object name.
- * Actions:    Performs a case-independent sliding match, looking for
- *             the object name (including surrounding quotes) in the
- *             serialised JSON.  If found, the pointer is advanced over
- *             the name, the colon, and any whitespace, until the start
- *             of the object's value. If the object name is not found,
- *             or there is no colon after the nem, NULL is returned.
- * Affects:    Nothing
- * Returns:    Pointer to the start of the object's value in "json", or
- *             NULL if the object is not found.
- * Notes:      Name is case independent.
- * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
-/**********************************************************************/
-
-static char *json_findObject (const char *json, const char *name)
+/* Each serialised object is tokenized once, into a fixed array of
+ * field descriptors and a small open-addressed hash table keyed by the
+ * case-folded field name.  Field lookups are then O(1), instead of
+ * rescanning the whole object with strcasestr() for every field. Only
+ * the top level of the object is indexed, but the span of each element
+ * of a top level array is recorded as the array is tokenized, so that
+ * the elements can be indexed in place when they are needed.
+ *
+ * Values are fetched as views (JSTR), a pointer into the text and a
+ * length, which the trace functions print with "%.*s".  Nothing is
+ * copied, and nothing ever reads beyond the end of a value, so there
+ * are no buffer sizes to get wrong and a malformed record can do no
+ * worse than trace oddly.  json_getValue() is kept for the few places
+ * which need a terminated copy.
+ *
+ * An object has room for the spans of JSON_MAXELEMS array elements,
+ * which is plenty for most.  The spans of any more, as in a large INP3
+ * unicast, are taken from a per-thread arena, which grows to suit the
+ * largest record seen and is emptied, not freed, for each record.  So
+ * an array can be of any length without a heap allocation per record.
+ *
+ * Strings which are shown to the user are fetched with json_getText(),
+ * which decodes the JSON escapes and makes the string safe to send to
+ * a terminal.  Almost all strings have nothing to decode, which is
+ * checked 16 or 32 bytes at a time, and they are shown in place.  The
+ * others are decoded into the arena.
+ * */
+#define  JSON_MAXFIELDS 64       // Max fields indexed per object
+#define  JSON_HASHSLOTS 128      // Power of 2, at least 2x MAXFIELDS
+#define  JSON_MAXELEMS  256      // Array elements held in the object
+#define  JSON_ARENAMIN  1024     // Initial size of arena, in spans
+#define  JSON_TEXTMIN   4096     // Initial size of its text, in bytes
+#define  JSON_EXPAND    5        // Max bytes shown per byte decoded
+
+#define  JT_STRING      1        // "quoted string" (quotes excluded)
+#define  JT_LITERAL     2        // Number, true, false or null
+#define  JT_ARRAY       3        // [...] including brackets
+#define  JT_OBJECT      4        // {...} including braces
+
+typedef struct
    {
-   char  tmp [80], *cp;
-
-   sprintf (tmp, "\"%s\"", name);
-
-   if ((cp = strcasestr (json, tmp)) == NULL)
-      return (NULL); // Name not found
+   unsigned    hash;             // Hash of case-folded field name
+   int         nameOff;          // Offset of name from start of text
+   int         nameLen;          // Length of name, excluding quotes
+   int         valOff;           // Offset of value from start of text
+   int         valLen;           // Length of value
+   int         type;             // JT_xxx
+   int         elem;             // Arrays: index of first element
+   int         nelems;           // Arrays: number of elements
+   } JFIELD;
+
+typedef struct
+   {
+   int         off;              // Offset of element from start of text
+   int         len;              // Length of element
+   } JSPAN;
 
-   cp++; // Skip opening quote of the name
+typedef struct
+   {
+   const char     *text;         // The serialised object
+   int            len;           // Length of text
+   int            nfields;       // Number of fields indexed
+   int            nelems;        // Number of array elements recorded
+   int            more;          // Arena index of element MAXELEMS
+   JFIELD         field [JSON_MAXFIELDS];
+   JSPAN          elem [JSON_MAXELEMS];
+   unsigned char  slot [JSON_HASHSLOTS];  // Field index+1, 0=empty
+   } JSONOBJ;
+
+typedef struct
+   {
+   const char  *ptr;             // Start of value, not terminated
+   int         len;              // Length of value
+   } JSTR;
 
-   while (*cp && *cp != '"') cp++;  // find end of name
+typedef struct
+   {
+   JSPAN       *span;            // Element spans beyond JSON_MAXELEMS
+   int         size;             // Allocated, in spans
+   int         used;             // Used by the current record
+   char        *text;            // Decoded strings, see json_getText()
+   int         textSize;         // Allocated, in bytes
+   int         textUsed;         // Used by the current record
+   int         textNeed;         // Enough for all of this record
+   } JSARENA;
 
-   while (*cp && *cp != ':') cp++;   // find the colon
+static __thread JSARENA Arena;
 
-   if (*cp != ':') return (NULL);   // No colon - so not a name
+/**********************************************************************/
+/* Purpose:    Hash a JSON field name, ignoring case
+ * Called by:  json_index() and json_findField()
+ * Arguments:  Pointer to name, length of name.
+ * Returns:    32 bit FNV-1a hash of the lower-cased name.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
 
-   cp++; // skip the colon
+static unsigned json_hash (const char *name, int len)
+   {
+   unsigned h = 2166136261u;
 
-   while (isspace (*cp)) cp++;   // Skip space after colon
+   while (len-- > 0)
+      {
+      h ^= (unsigned char) tolower ((unsigned char) *name++);
+      h *= 16777619u;
+      }
 
-   return (cp);   // Points at the object's value
+   return (h);
    }
 
 /**********************************************************************/
-/* Purpose:    Find a named JSON array by name.
- * Called by:  trace_nodes() and trace_inp3().
- * Arguments:  Pointer to serialised JSON object string. Array name.
- * Actions:    Performs a case-independent sliding match looking for the
- *             array name in the serialised JSON. If found, checks that
- *             the name actually belongs to an array.
- * Affects:    Nothing.
- * Returns:    Pointer to the opening square bracket in the "json"
- *             string, or NULL if the array is not found.
- * Notes:      Name is case independent.
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Skip over the body of a JSON string
+ * Called by:  json_index(), json_skipNested() and json_skipArray()
+ * Arguments:  Pointer to the first char AFTER the opening quote, and
+ *             pointer to the end of the text.
+ * Returns:    Pointer to the closing quote, or "end" if there isn't
+ *             one.  Escaped quotes do not end the string.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static char *json_findArray (const char *json, char *name)
+static const char *json_skipString (const char *cp, const char *end)
    {
-   char  *cp;
-
-   if ((cp = json_findObject (json, name)) == NULL) return (NULL);
-
-   if (*cp != '[') return (NULL);
+   while (cp < end && *cp != '"')
+      {
+      if (*cp == '\\' && cp+1 < end) cp++;  // Skip escaped char
+      cp++;
+      }
 
-   return (cp);   // Point at opening bracket
+   return (cp);
    }
 
 /**********************************************************************/
-/* Purpose:    Get the value of a named JSON "field"
- * Called by:  Many places!
- * Arguments:  Pointer to serialised JSON object string, field name,
- *             Pointer to a string to receive the result, maximum chars
- *             to copy to result string.
- * Actions:    If the field is found, its string value, up to a maximum
- *             of "maxchars" is copied to the string pointed by "result"
- *             The quotes surrouunding string values are not copied.
- * Affects:    The string pointed by "result".
- * Returns:    Pointer to the first character after the field's value,
- *             or NULL if the field was not found.
- * Notes:      x
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Skip over a JSON array or object value
+ * Called by:  json_index() and json_skipArray()
+ * Arguments:  Pointer to the opening bracket or brace, and pointer to
+ *             the end of the text.
+ * Returns:    Pointer to the first char after the matching closing
+ *             bracket or brace, or "end" if it isn't found.
+ * Notes:      Brackets and braces within strings are ignored.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static char *json_getValue (const char *json, const char *name,
-   char *result, int maxlen)
+static const char *json_skipNested (const char *cp, const char *end)
    {
-   char  *cp;
-   int   string = 0;
-
-   if ((cp = json_findObject (json, name)) == NULL)
-      return (NULL); // Name not found
+   int   level = 0;
 
-   if (*cp == '"')   // If the first char of the value is a quote,
+   for (; cp < end; cp++)
       {
-      string = 1;    // it's a string literal.
-      cp++;          // Skip the quote character to point at value
-      }
-
-   if (string)       // If it's a string literal
-      {
-      while (*cp && *cp != '"')  // Copy everything between the quotes
-         {
-         if (maxlen-- > 0) *result++ = *cp;
-         cp++;
-         }
-      }
-   else  // Not a string literal, probably number or boolean
-      {
-      // Copy the value to "result"
-      while (*cp && (*cp == '-' || *cp == '.' || isalnum (*cp)))
+      switch (*cp)
          {
-         if (maxlen-- > 0) *result++ = *cp;
-         cp++;
+         case '"':
+            cp = json_skipString (cp+1, end);
+            if (cp >= end) return (end);
+            break;
+
+         case '[':
+         case '{':
+            level++;
+            break;
+
+         case ']':
+         case '}':
+            if (--level == 0) return (cp+1);
+            break;
          }
       }
 
-   *result = 0;   // Terminate the result string
-
-   return (cp+1); // Pointer to first char AFTER the value
+   return (end);
    }
 
 /**********************************************************************/
-/* Purpose:    Get next JSON object from an array of objects
- * Called by:  trace_inp3() only. Ought to be used by decde_nodes()!
- * Arguments:  Pointer to a string containing serialised array, pointer
- *             to a string buffer to receive the object, maximum number
- *             of characters to copy.
- * Actions:    Ignores curent object and finds start of next, then
- *             copies the found object into "buffer", including its
- *             opening and closing braces.
- * Affects:    Contents of the string pointed by "buffer".
- * Returns:    Pointer to the opening brace of the found array element,
- *             or NULL if no next object found.
- * Notes:      Flat arrays of simple objects only. Does not allow braces
- *             within object values.
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Allocate the span of the next element of an object
+ * Called by:  json_skipArray()
+ * Arguments:  Pointer to the JSONOBJ being built.
+ * Actions:    Uses the object's own table until it is full, then the
+ *             arena, doubling the arena if it is full too.  The spans
+ *             of one object are contiguous in the arena, as an object
+ *             is tokenized in a single pass.
+ * Affects:    The "nelems" and "more" members of "obj", and Arena.
+ * Returns:    Pointer to the span.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static const char *json_getNextArrayElement (const char *json,
-   char *buffer, int maxlen)
+static JSPAN *json_newSpan (JSONOBJ *obj)
    {
-   const char  *cp = json;
-
-   // Find end of current element
-   while (*cp && *cp != '}' && *cp != ']') cp++;
+   JSARENA  *a = &Arena;
 
-   if (*cp != '}') return (NULL);   // Didn't find end
+   if (obj->nelems < JSON_MAXELEMS) return (&obj->elem [obj->nelems++]);
 
-   // Find start of next element
-   while (*cp && *cp != '{' && *cp != ']') cp++;
+   if (obj->nelems == JSON_MAXELEMS) obj->more = a->used;
 
-   if (*cp != '{') return (NULL); // No next element
-
-   json = cp;  // Remember pointer to start of element
-
-   // Copy up to "maxlen" characters to "buffer", including braces.
-   while (*cp && maxlen-- > 0)
+   if (a->used == a->size)
       {
-      *buffer++ = *cp;
-      if (*cp == '}') break;
-      cp++;
+      a->size = a->size ? a->size * 2 : JSON_ARENAMIN;
+      if ((a->span = realloc (a->span, a->size * sizeof (JSPAN))) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
       }
-   *buffer = 0;   // terminate the output string
-
-   return (json); // Pointer to start of element
-   }
-
 
+   a->used++;
 
-//######################################################################
-//                       PACKET TRACE FUNCTIONS
-//######################################################################
-
-/**********************************************************************/
-/* Purpose:    Output to user and optional capture file
- * Called by:  Most functions.
- * Arguments:  Format string plus zero or more additional fields
- * Actions:    Prints the data to a string, then outputs it to screen
- *             (stdout) and/or the capture file.
- * Affects:    stdout, capture file or both.
- * Returns:    Number of characters printed.
- * Notes:      The output string must not exceed 4095 bytes, but that is
- *             highly unlikely to happen. Most calls only output a few
- *             characters.
- * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
-/**********************************************************************/
+   return (&a->span [obj->more + obj->nelems++ - JSON_MAXELEMS]);
+   }
 
-static int uprintf (char *fmt, ...)
+// Get the span of element "n" of an object
+static const JSPAN *json_span (const JSONOBJ *obj, int n)
    {
-   char buff [4096];
-   va_list arg;
-
-   va_start (arg, fmt);
-   vsprintf (buff, fmt, arg);
-   va_end (arg);
-
-   // Output to capture file if it is open
-   if (FpCapture)
-      {
-      fputs (buff, FpCapture);
-      fflush (FpCapture);
-      }
+   if (n < JSON_MAXELEMS) return (&obj->elem [n]);
 
-   // Output to stdio if not in "quiet" mode
-   if ((TraceFlags & TRACE_QUIET) == 0) fputs (buff, stdout);
+   return (&Arena.span [obj->more + n - JSON_MAXELEMS]);
+   }
 
-   return (strlen (buff));
+// Empty the arena, ready for the next record of "len" bytes
+static inline void json_reset (int len)
+   {
+   Arena.used = Arena.textUsed = 0;
+   Arena.textNeed = JSON_EXPAND * len;
    }
 
+// Free the thread's arena, when the thread ends
+static void json_free (void)
+   {
+   free (Arena.span);
+   free (Arena.text);
+   memset (&Arena, 0, sizeof (Arena));
+   }
 
 /**********************************************************************/
-/* Purpose:    Decode and display a 'NODES' broadcast.
- * Called by:  trace_netromRoutingInfo() only.
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Displays the alias of the node making the broadcast,
- *             then loops through the "nodes" array, displaying details
- *             of each route.
- * Affects:    stdout only
- * Returns:    None
- * Notes:      Assumes "fromAlias" appears before "nodes" in the JSON
- *             string. This is necessary because the JSON parser is
- *             crude and case insensitive. It cannot distinguish between
- *             the field *name* "nodes" and the field *value* "NODES"
- *             which appears earlier in the string. This could be fixed
- *             by a better parser.
- * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
+/* Purpose:    Skip over a JSON array, recording its element spans
+ * Called by:  json_index()
+ * Arguments:  Pointer to the JSONOBJ being built, pointer to the field
+ *             descriptor of the array, pointer to the opening bracket,
+ *             and pointer to the end of the text.
+ * Actions:    Steps over each element in turn, appending its span to
+ *             the object's element table, until the closing bracket.
+ * Affects:    The element table of "obj", and the "elem" and "nelems"
+ *             members of "f".
+ * Returns:    Pointer to the first char after the closing bracket, or
+ *             "end" if it isn't found.
+ * Notes:      Elements beyond JSON_MAXELEMS are recorded in the arena.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to record any number of elements. */
 /**********************************************************************/
 
-static void trace_nodes (const char *json)
+static const char *json_skipArray (JSONOBJ *obj, JFIELD *f,
+   const char *cp, const char *end)
    {
-   char  tmp [80], *cp;
-
-   if ((TraceFlags & TRACE_NODES) == 0)
-      {
-      uprintf (" NODES Broadcast");
-      return; // Not wanted
-      }
+   const char  *el;
+   JSPAN       *sp;
 
-   if ((cp = json_getValue (json, "fromAlias", tmp, 6)) == NULL)
-      {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [missing 'fromAlias']");
-      return;
-      }
+   f->elem = obj->nelems;
+   f->nelems = 0;
 
-   uprintf ("%sNODES Broadcast from %s:", Margin, tmp);
+   cp++; // Skip the opening bracket
 
-   if ((cp = json_findArray (cp, "nodes")) == NULL)
+   while (cp < end)
       {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [missing 'nodes' array]");
-      return;
-      }
+      while (cp < end && (isspace ((unsigned char) *cp) || *cp == ','))
+         cp++;
 
-   // cp is pointing at the opening square bracket of nodes array
-   while (*cp)
-      {
-      // Format is "GE8PZT:BBS64 via GE8PZT qlty=20"
-      if (json_getValue (cp, "call", tmp, 9))
-         uprintf ("%s%s", Margin, tmp);
+      if (cp >= end) break;
+      if (*cp == ']') return (cp+1);   // End of array
 
-      if (json_getValue (cp, "alias", tmp, 6))
-         uprintf (":%s", tmp);
+      el = cp;
 
-      if (json_getValue (cp, "via", tmp, 9))
-         uprintf (" via %s", tmp);
+      if (*cp == '{' || *cp == '[') cp = json_skipNested (cp, end);
+
+      else if (*cp == '"')
+         {
+         cp = json_skipString (cp+1, end);
+         if (cp < end) cp++;
+         }
 
-      if (json_getValue (cp, "qual", tmp, 3))
-         uprintf (" qlty=%s", tmp);
+      else  // Literal, or something unexpected
+         {
+         while (cp < end && *cp != ',' && *cp != ']'
+         && !isspace ((unsigned char) *cp))
+            cp++;
+         if (cp == el) cp++;  // Ensure progress on junk
+         }
 
-      while (*cp && *cp != '}') cp++;   // find end of node object
-      if (*cp) cp++;
+      sp = json_newSpan (obj);
+      sp->off = el - obj->text;
+      sp->len = cp - el;
+      f->nelems++;
       }
-   }
 
-static int wrap (void)
-   {
-   uprintf ("%s    ", Margin);
-   return (8);
+   return (end);
    }
 
 /**********************************************************************/
-/* Purpose:    Decode and display an INP3 routing unicast
- * Called by:  trace_netromRoutingInfo() only.
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Loops through the "nodes" array, displaying details
- *             of each route.
- * Affects:    stdout only.
- * Returns:    None
- * Notes:      x
- * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
+/* Purpose:    Tokenize a serialised JSON object into a field index
+ * Called by:  process_json() and json_getElement()
+ * Arguments:  Pointer to JSONOBJ to receive the index, pointer to the
+ *             serialised object, length of the serialised object.
+ * Actions:    Makes a single pass over the text, recording the name
+ *             and value span of each top level field, and entering it
+ *             into the hash table.  The elements of arrays are
+ *             recorded as they are passed.  The text may either
+ *             include or exclude the outer braces.
+ * Affects:    The JSONOBJ pointed by "obj".
+ * Returns:    Number of fields indexed.
+ * Notes:      If a name occurs more than once, the first one wins, as
+ *             it did with the old sliding match.  Indexing stops at
+ *             JSON_MAXFIELDS.  Malformed input is indexed as far as
+ *             possible, never beyond "len".  Before indexing a new
+ *             record, the caller empties the arena with json_reset().
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to initialise "more". */
 /**********************************************************************/
 
-static void trace_inp3 (const char *json)
+static int json_index (JSONOBJ *obj, const char *text, int len)
    {
-   char        object [1024], tmp [80];
-   const char  *cp;
-
-   if ((TraceFlags & TRACE_INP3) == 0)
-      {
-      uprintf (" INP3");
-      return;
-      }
+   const char  *cp = text, *end = text + len, *name, *val;
+   JFIELD      *f;
+   int         i, n, type, nameLen;
 
-   uprintf ("%sINP3 Routing Unicast:", Margin);
+   obj->text = text;
+   obj->len = len;
+   obj->nfields = 0;
+   obj->nelems = obj->more = 0;
+   memset (obj->slot, 0, sizeof (obj->slot));
 
-   if ((cp = json_findArray (json, "nodes")) == NULL)
-      {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [missing 'nodes' array]");
-      return;
-      }
+   while (cp < end && isspace ((unsigned char) *cp)) cp++;
 
-   // cp is now pointing at the opening square bracket of nodes array
+   if (cp < end && *cp == '{') cp++;   // Skip the opening brace
 
-   while ((cp = json_getNextArrayElement (cp, object, 1023)) != NULL)
+   while (obj->nfields < JSON_MAXFIELDS)
       {
-      int   cols = 0;
-
-      // Minimum format is "GB7BDH    hp=2   tt=3"
+      // Find the opening quote of the next name
+      while (cp < end && *cp != '"' && *cp != '}') cp++;
 
-      if (json_getValue (object, "call", tmp, 9))
-         cols += uprintf ("%s%-9s", Margin, tmp);
+      if (cp >= end || *cp == '}') break;  // End of object
 
-      if (json_getValue (object, "hops", tmp, 2))
-         cols += uprintf ("  hp=%-2s", tmp);
+      name = ++cp;
+      cp = json_skipString (cp, end);
+      if (cp >= end) break;
+      nameLen = cp++ - name;
 
-      if (json_getValue (object, "tt", tmp, 5))
-         cols += uprintf ("  tt=%-5s", tmp);
+      while (cp < end && isspace ((unsigned char) *cp)) cp++;
 
-      // Optional fields
-      // "Alias=SWINDN 5128.75N 71582600.46E S/W=XRPi NODE PMS XRCHAT Ver=504k 25/10 06:20
+      if (cp >= end) break;
+      if (*cp != ':') continue;     // No colon - so not a name
 
-      if (json_getValue (object, "alias", tmp, 6))
-         cols += uprintf ("  Alias=%-6s", tmp);
+      cp++; // skip the colon
 
-      if (json_getValue (object, "latitude", tmp, 20))
-         cols += uprintf (" %s", tmp);
+      while (cp < end && isspace ((unsigned char) *cp)) cp++;
 
-       if (json_getValue (object, "longitude", tmp, 20))
-         cols += uprintf (" %s", tmp);
+      if (cp >= end) break;
 
-      if (json_getValue (object, "software", tmp, 20))
-         cols += uprintf (" S/W=%s", tmp);
-
-      // If could overflow 80-col line after this point
+      f = &obj->field [obj->nfields];
+      f->elem = f->nelems = 0;
 
-      if (json_getValue (object, "version", tmp, 10))
+      if (*cp == '"')   // String literal
          {
-         if (cols+2+strlen (tmp) >= DisplayWidth) cols = wrap ();
-         cols += uprintf (" v%s", tmp);
+         type = JT_STRING;
+         val = ++cp;
+         cp = json_skipString (cp, end);
+         n = cp - val;
+         if (cp < end) cp++;  // Skip the closing quote
          }
 
-      if (json_getValue (object, "isNode", tmp, 5)
-      && strcmp (tmp, "true") == 0)
+      else if (*cp == '[')  // Array
          {
-         if ((cols + 5) >= DisplayWidth) cols = wrap ();
-         cols += uprintf (" NODE");
+         type = JT_ARRAY;
+         val = cp;
+         cp = json_skipArray (obj, f, cp, end);
+         n = cp - val;
          }
 
-      if (json_getValue (object, "isBBS", tmp, 5)
-      && strcmp (tmp, "true") == 0)
+      else if (*cp == '{')  // Nested object
          {
-         if ((cols + 4) >= DisplayWidth) cols= wrap ();
-         cols += uprintf (" BBS");
+         type = JT_OBJECT;
+         val = cp;
+         cp = json_skipNested (cp, end);
+         n = cp - val;
          }
 
-      if (json_getValue (object, "isPMS", tmp, 5)
-      && strcmp (tmp, "true") == 0)
+      else  // Not a string literal, probably number or boolean
          {
-         if ((cols + 4) >= DisplayWidth) cols= wrap ();
-         cols += uprintf (" PMS");
+         type = JT_LITERAL;
+         val = cp;
+         while (cp < end && (*cp == '-' || *cp == '.'
+         || isalnum ((unsigned char) *cp)))
+            cp++;
+         n = cp - val;
          }
 
-      if (json_getValue (object, "isXRChat", tmp, 5)
-      && strcmp (tmp, "true") == 0)
-         {
-         if ((cols + 7) >= DisplayWidth) cols = wrap ();
-         cols += uprintf (" XRCHAT");
-         }
+      f->hash = json_hash (name, nameLen);
+      f->nameOff = name - text;
+      f->nameLen = nameLen;
+      f->valOff = val - text;
+      f->valLen = n;
+      f->type = type;
 
-      if (json_getValue (object, "isRTChat", tmp, 5)
-      && strcmp (tmp, "true") == 0)
+      // Enter it into the hash table, unless it's a duplicate
+      for (i = f->hash & (JSON_HASHSLOTS-1); obj->slot [i];
+         i = (i+1) & (JSON_HASHSLOTS-1))
          {
-         if ((cols + 7) >= DisplayWidth) cols = wrap ();
-         cols += uprintf (" RTCHAT");
-         }
+         JFIELD   *g = &obj->field [obj->slot [i] - 1];
 
-      if (json_getValue (object, "isRMS", tmp, 5)
-      && strcmp (tmp, "true"))
-         {
-         if ((cols + 4) >= DisplayWidth) cols = wrap ();
-         cols += uprintf (" RMS");
+         if (g->hash == f->hash && g->nameLen == nameLen
+         && strncasecmp (text + g->nameOff, name, nameLen) == 0)
+            break;
          }
 
-      if (json_getValue (object, "isDXClUS", tmp, 5)
-      && strcmp (tmp, "true") == 0)
-         {
-         if ((cols + 7) >= DisplayWidth) cols= wrap ();
-         cols += uprintf (" DXCLUS");
-         }
+      if (obj->slot [i] == 0)
+         obj->slot [i] = ++obj->nfields;
+      }
 
-      if (json_getValue (object, "timestamp", tmp, 40))
-         {
-         // There are two typs of timestamps currently in use...
-         if (strchr (tmp, 'T'))  // It's ISO-8601
-            {
-            // 2025-10-24T12:46:52Z
-            if ((cols + 21) >= DisplayWidth) cols= wrap ();
-            cols += uprintf (" %s", tmp);
-            }
+   return (obj->nfields);
+   }
 
-         else  // It's Unix time
-            {
-            time_t   t = atoi (tmp);
+/**********************************************************************/
+/* Purpose:    Look up a named field in a tokenized JSON object
+ * Called by:  json_findArray(), json_getStr() and others
+ * Arguments:  Pointer to tokenized object. Field name.
+ * Returns:    Pointer to the field descriptor, or NULL if the field is
+ *             not found.
+ * Notes:      Name is case independent.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
 
-            if (((unsigned)t) > 18000)
-               {
-               struct tm *tim = localtime (&t);
-               if ((cols + 12) >= DisplayWidth) cols= wrap ();
-               cols += uprintf (" %02d/%02d %02d:%02d",
-                  tim->tm_mday,  tim->tm_mon+1,
-                  tim->tm_hour,  tim->tm_min);
-               }
-            }
-         }
+static const JFIELD *json_findField (const JSONOBJ *obj,
+   const char *name)
+   {
+   const JFIELD   *f;
+   int            i, len = strlen (name);
+   unsigned       hash = json_hash (name, len);
 
-      if (json_getValue (object, "tzMins", tmp, 8))
-         {
-         if (cols+3+strlen (tmp) >= DisplayWidth) cols = wrap ();
-         uprintf (" tz=%s", tmp);
-         }
+   for (i = hash & (JSON_HASHSLOTS-1); obj->slot [i];
+      i = (i+1) & (JSON_HASHSLOTS-1))
+      {
+      f = &obj->field [obj->slot [i] - 1];
+
+      if (f->hash == hash && f->nameLen == len
+      && strncasecmp (obj->text + f->nameOff, name, len) == 0)
+         return (f);
       }
+
+   return (NULL);
    }
 
 /**********************************************************************/
-/* Purpose:    Decode and display ARP headers
- * Called by:  process_json() for ptcl="ARP"
- * Arguments:  Pointer to string containing serialised JSON object.
- * Returns:    None
+/* Purpose:    Find a named JSON array by name.
+ * Called by:  trace_nodes() and trace_inp3().
+ * Arguments:  Pointer to tokenized JSON object. Array name.
+ * Actions:    Looks up the name in the object's index, and checks that
+ *             the name actually belongs to an array.
+ * Affects:    Nothing.
+ * Returns:    Pointer to the array's field descriptor, or NULL if the
+ *             array is not found.
+ * Notes:      Name is case independent.
  * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
+ * Modified:   14/10/2026 to use the field index. */
 /**********************************************************************/
 
-static void trace_arp (const char *json)
+static const JFIELD *json_findArray (const JSONOBJ *json,
+   const char *name)
    {
-   char  tmp [80];
+   const JFIELD   *f;
 
-   if ((TraceFlags & TRACE_ARP) == 0) return;
+   if ((f = json_findField (json, name)) == NULL) return (NULL);
 
-   // Older software doesn't include these fields
-   if (json_getValue (json, "arpOp", tmp, 79) == NULL) return;
+   if (f->type != JT_ARRAY) return (NULL);
 
-   uprintf ("%sARP %s", Margin, tmp);
+   return (f);
+   }
 
-   if (json_getValue (json, "arpHwType", tmp, 79))
-      uprintf (" hwtype=%s", tmp);
+/**********************************************************************/
+/* Purpose:    Index an element of an array of objects
+ * Called by:  trace_nodes() and trace_inp3().
+ * Arguments:  Pointer to tokenized JSON object, pointer to the field
+ *             descriptor of one of its arrays, element number (from
+ *             0), pointer to a JSONOBJ to receive the element.
+ * Actions:    Tokenizes the element in place, using the span recorded
+ *             when the parent object was tokenized.  Nothing is copied.
+ * Affects:    The JSONOBJ pointed by "element".
+ * Returns:    1 if the element exists and is an object, else 0.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
 
-   if (json_getValue (json, "arpHwLen", tmp, 79))
-      uprintf (" hwlen=%s", tmp);
+static int json_getElement (const JSONOBJ *json, const JFIELD *array,
+   int n, JSONOBJ *element)
+   {
+   const JSPAN  *sp;
 
-   if (json_getValue (json, "arpPtcl", tmp, 79))
-      uprintf (" prot=%s", tmp);
+   if (n < 0 || n >= array->nelems) return (0);
 
-   if (json_getValue (json, "arpSndAddr", tmp, 79))
-      uprintf ("%ssnd=%s", Margin, tmp);
+   sp = json_span (json, array->elem + n);
 
-   if (json_getValue (json, "arpTgtAddr", tmp, 79))
-      uprintf (" tgt=%s", tmp);
+   if (json->text [sp->off] != '{') return (0);
 
-   if (json_getValue (json, "arpSndHw", tmp, 79))
-      uprintf (" snd_hw=%s", tmp);
+   json_index (element, json->text + sp->off, sp->len);
 
-   if (json_getValue (json, "arpTgtHw", tmp, 79))
-      uprintf (" tgt_hw=%s", tmp);
+   return (1);
    }
 
 /**********************************************************************/
-/* Purpose:    Decode and display IP headers
- * Called by:  process_json() for ptcl="IP"
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Traces the main IP header fields, but not the payload
- * Affects:    stdout only
- * Returns:    None
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Get a view of the value of a named JSON "field"
+ * Called by:  The trace functions, and json_getValue()
+ * Arguments:  Pointer to tokenized JSON object, field name, pointer to
+ *             a JSTR to receive the view, maximum length of the view.
+ * Actions:    If the field is found, points the view at its value in
+ *             the object's text, excluding the quotes around string
+ *             values, and limits its length to "maxlen".  Nothing is
+ *             copied.
+ * Affects:    The JSTR pointed by "v".
+ * Returns:    1 if the field was found, else 0.
+ * Notes:      The view is not terminated, so it is printed with "%.*s"
+ *             and is only valid while the text is.  "v" is left
+ *             untouched if the field is not found.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static void trace_ip (const char *json)
+static int json_getStr (const JSONOBJ *json, const char *name,
+   JSTR *v, int maxlen)
    {
-   char     tmp [80], src [16], dst [16];
+   const JFIELD   *f;
 
-   if ((TraceFlags & TRACE_IP) == 0) return;
+   if ((f = json_findField (json, name)) == NULL)
+      return (0); // Name not found
 
-   // Older software doesn't include these fields
-   if (json_getValue (json, "ipFrom", src, 15) == NULL
-   || json_getValue (json, "ipTo", dst, 15) == NULL)
-      return;
+   v->ptr = json->text + f->valOff;
+   v->len = (f->valLen < maxlen) ? f->valLen : maxlen;
+   if (v->len < 0) v->len = 0;
 
-   // IP: 44.136.16.50 > 44.136.16.52 iplen=28 ttl=127 id=ABA0 ptcl=1 ICMP
-   uprintf ("%sIP: %s > %s", Margin, src, dst);
+   return (1);
+   }
+
+// Test whether a view holds exactly the given string
+static int json_strIs (const JSTR *v, const char *str)
+   {
+   return ((int) strlen (str) == v->len
+      && memcmp (v->ptr, str, v->len) == 0);
+   }
 
-   if (json_getValue (json, "ipLen", tmp, 6)) uprintf (" iplen=%s", tmp);
+/* Parse the integer at the start of a view, as atol() would, but
+ * without reading beyond the end of it.
+ * */
+static long json_strLong (const JSTR *v)
+   {
+   const char  *cp = v->ptr, *end = v->ptr + v->len;
+   long        n = 0;
+   int         neg = 0;
 
-   if (json_getValue (json, "ipTTL", tmp, 3)) uprintf (" ttl=%s", tmp);
+   while (cp < end && isspace ((unsigned char) *cp)) cp++;
 
-   if (json_getValue (json, "ipID", tmp, 6)) uprintf (" id=%s", tmp);
+   if (cp < end && (*cp == '-' || *cp == '+')) neg = (*cp++ == '-');
 
-   if (json_getValue (json, "ipPtcl", tmp, 6)) uprintf (" ptcl=%s", tmp);
+   while (cp < end && isdigit ((unsigned char) *cp)
+   && n < (LONG_MAX - 9) / 10)
+      n = n * 10 + (*cp++ - '0');
 
-   if (json_getValue (json, "ipProto", tmp, 8)) uprintf (" %s", tmp);
+   return (neg ? -n : n);
    }
 
-/**********************************************************************/
-/* Purpose:    Decode and display NetRom routing information frames
- * Called by:  trace_netrom() only.
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Checks the value of "l3Type", vcalling the appropriate
- *             function according to that value.
- * Returns:    None
- * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
-/**********************************************************************/
-
-static void trace_netromRoutingInfo (const char *json)
+// Get a named integer field, or "dflt" if it is missing
+static long json_getLong (const JSONOBJ *json, const char *name,
+   long dflt)
    {
-   char  type [16];
+   JSTR  v;
 
-   if (json_getValue (json, "type", type, 15) == NULL)
-      {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [missing 'type']");
-      return;
-      }
+   if (!json_getStr (json, name, &v, 20)) return (dflt);
 
-   if (strcmp (type, "NODES") == 0) trace_nodes (json);
+   return (json_strLong (&v));
+   }
+
+// Get the first char of a named field, e.g. 't' for true, else 0
+static int json_getChar (const JSONOBJ *json, const char *name)
+   {
+   JSTR  v;
+
+   if (!json_getStr (json, name, &v, 1) || v.len == 0) return (0);
+
+   return (*v.ptr);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the end of the plain text at the start of a string
+ * Called by:  json_getText()
+ * Arguments:  Pointer to string, its length.
+ * Actions:    Scans for a backslash, a control char, DEL, or any byte
+ *             of a multi-byte UTF-8 character, 32 or 16 bytes at a
+ *             time with AVX2 or SSE2 if the compiler is targetting
+ *             them.  The last few bytes are checked one at a time.
+ * Returns:    Offset of the first such byte, or "len" if there are
+ *             none, i.e. the string can be shown as it is.
+ * Notes:      As signed chars, control chars and bytes from 0x80 up
+ *             are all less than a space, so one compare finds both.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int json_plain (const char *cp, int len)
+   {
+   int   i = 0;
+
+#if defined(__AVX2__)
+   const __m256i  sp = _mm256_set1_epi8 (' ');
+   const __m256i  bs = _mm256_set1_epi8 ('\\');
+   const __m256i  del = _mm256_set1_epi8 (0x7f);
+
+   while (i + 32 <= len)
+      {
+      __m256i  v = _mm256_loadu_si256 ((const __m256i *) (cp + i));
+      unsigned mask = _mm256_movemask_epi8 (_mm256_or_si256 (
+         _mm256_cmpgt_epi8 (sp, v), _mm256_or_si256 (
+            _mm256_cmpeq_epi8 (v, bs), _mm256_cmpeq_epi8 (v, del))));
+
+      if (mask) return (i + __builtin_ctz (mask));
+      i += 32;
+      }
+#endif
+
+#if defined(__SSE2__)
+   const __m128i  sp16 = _mm_set1_epi8 (' ');
+   const __m128i  bs16 = _mm_set1_epi8 ('\\');
+   const __m128i  del16 = _mm_set1_epi8 (0x7f);
+
+   while (i + 16 <= len)
+      {
+      __m128i  v = _mm_loadu_si128 ((const __m128i *) (cp + i));
+      unsigned mask = _mm_movemask_epi8 (_mm_or_si128 (
+         _mm_cmplt_epi8 (v, sp16), _mm_or_si128 (
+            _mm_cmpeq_epi8 (v, bs16), _mm_cmpeq_epi8 (v, del16))));
+
+      if (mask) return (i + __builtin_ctz (mask));
+      i += 16;
+      }
+#endif
+
+   for (; i < len; i++)
+      {
+      unsigned char  ch = cp [i];
+
+      if (ch < ' ' || ch >= 0x7f || ch == '\\') break;
+      }
+
+   return (i);
+   }
+
+/* Get the length of the UTF-8 sequence at the start of a string, and
+ * its code point.  Returns 0 if it isn't a valid sequence, i.e. is
+ * truncated, overlong, a surrogate or beyond U+10FFFF.
+ * */
+static int json_utf8 (const unsigned char *cp, int len, unsigned *code)
+   {
+   unsigned c = cp [0], min;
+   int      i, n;
+
+   if (c < 0x80) n = 1, min = 0;
+   else if ((c & 0xe0) == 0xc0) n = 2, c &= 0x1f, min = 0x80;
+   else if ((c & 0xf0) == 0xe0) n = 3, c &= 0x0f, min = 0x800;
+   else if ((c & 0xf8) == 0xf0) n = 4, c &= 0x07, min = 0x10000;
+   else return (0);
+
+   if (n > len) return (0);
+
+   for (i = 1; i < n; i++)
+      {
+      if ((cp [i] & 0xc0) != 0x80) return (0);
+      c = (c << 6) | (cp [i] & 0x3f);
+      }
+
+   if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+      return (0);
+
+   *code = c;
+   return (n);
+   }
+
+/* Put a character into decoded text, making it safe for a terminal.
+ * Line breaks start a new line at the margin, other control chars are
+ * shown as "^X", and C1 controls as U+FFFD.  Returns the new end of
+ * the text, at most JSON_EXPAND bytes on.
+ * */
+static char *json_putChar (char *op, unsigned c)
+   {
+   if (c == '\n' || c == '\r')
+      {
+      memcpy (op, Margin, sizeof (Margin) - 1);
+      return (op + sizeof (Margin) - 1);
+      }
+
+   if ((c < ' ' && c != '\t') || c == 0x7f)
+      {
+      *op++ = '^';
+      *op++ = c ^ 0x40;    // ^@..^_, and ^? for DEL
+      return (op);
+      }
+
+   if (c < 0x80)
+      *op++ = c;
+
+   else if (c < 0xa0 || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff)
+      op = json_putChar (op, 0xfffd);  // C1 control or not a char
+
+   else if (c < 0x800)
+      {
+      *op++ = 0xc0 | (c >> 6);
+      *op++ = 0x80 | (c & 0x3f);
+      }
+
+   else if (c < 0x10000)
+      {
+      *op++ = 0xe0 | (c >> 12);
+      *op++ = 0x80 | ((c >> 6) & 0x3f);
+      *op++ = 0x80 | (c & 0x3f);
+      }
+
+   else
+      {
+      *op++ = 0xf0 | (c >> 18);
+      *op++ = 0x80 | ((c >> 12) & 0x3f);
+      *op++ = 0x80 | ((c >> 6) & 0x3f);
+      *op++ = 0x80 | (c & 0x3f);
+      }
+
+   return (op);
+   }
+
+// Get the value of the 4 hex digits of a "\uXXXX", or -1 if not hex
+static int json_hex4 (const char *cp)
+   {
+   int   i, c, n = 0;
+
+   for (i = 0; i < 4; i++)
+      {
+      c = (unsigned char) cp [i];
+
+      if (c >= '0' && c <= '9') c -= '0';
+      else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+         c = (c | 0x20) - 'a' + 10;
+      else return (-1);
+
+      n = (n << 4) | c;
+      }
+
+   return (n);
+   }
+
+/**********************************************************************/
+/* Purpose:    Decode a JSON string for display
+ * Called by:  json_getText()
+ * Arguments:  Pointer to the string (without its quotes), its length,
+ *             pointer to a buffer of at least JSON_EXPAND * len bytes.
+ * Actions:    Copies the string to the buffer, decoding the escapes
+ *             \", \\, \/, \b, \f, \n, \r, \t and \uXXXX (including
+ *             surrogate pairs), and passing each character through
+ *             json_putChar().  "\r\n" is one line break.  Bytes which
+ *             aren't valid UTF-8 are shown as U+FFFD, and a malformed
+ *             escape is shown as it is.
+ * Affects:    The buffer.
+ * Returns:    Length of the decoded text.
+ * Notes:      Each byte of the string gives at most JSON_EXPAND bytes
+ *             of text, when a raw CR or LF is shown as the margin.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int json_decode (const char *cp, int len, char *out)
+   {
+   const char  *end = cp + len;
+   char        *op = out;
+   unsigned    c;
+   int         n, lo;
+
+   while (cp < end)
+      {
+      // Copy runs of plain text as they are
+      if ((n = json_plain (cp, end - cp)) > 0)
+         {
+         memcpy (op, cp, n);
+         op += n;
+         cp += n;
+         continue;
+         }
+
+      if (*cp != '\\')  // Control char or multi-byte character
+         {
+         if ((n = json_utf8 ((const unsigned char *) cp, end - cp, &c))
+         == 0)
+            c = 0xfffd, n = 1;   // Not valid UTF-8
+
+         if (c == '\r' && cp + 1 < end && cp [1] == '\n') n++;
+
+         op = json_putChar (op, c);
+         cp += n;
+         continue;
+         }
+
+      if (cp + 1 >= end)   // Lone backslash at the end
+         {
+         *op++ = *cp++;
+         continue;
+         }
+
+      n = 2;
+
+      switch (cp [1])
+         {
+         case 'b':   c = '\b';   break;
+         case 'f':   c = '\f';   break;
+         case 'n':   c = '\n';   break;
+         case 'r':   c = '\r';   break;
+         case 't':   c = '\t';   break;
+
+         case 'u':
+            if (end - cp < 6 || (lo = json_hex4 (cp + 2)) < 0)
+               {
+               c = '\\', n = 1;  // Malformed, so show it as it is
+               break;
+               }
+
+            c = lo, n = 6;
+
+            // A high surrogate should be followed by a low one
+            if (c >= 0xd800 && c <= 0xdbff && end - cp >= 12
+            && cp [6] == '\\' && cp [7] == 'u'
+            && (lo = json_hex4 (cp + 8)) >= 0xdc00 && lo <= 0xdfff)
+               {
+               c = 0x10000 + ((c - 0xd800) << 10) + (lo - 0xdc00);
+               n = 12;
+               }
+            break;
+
+         case '"':
+         case '\\':
+         case '/':   c = cp [1]; break;
+
+         default:    c = '\\', n = 1;  break;  // Malformed
+         }
+
+      // "\r\n" is one line break, as is a raw CR LF
+      if (c == '\r' && end - cp >= n + 2 && cp [n] == '\\'
+      && cp [n + 1] == 'n')
+         n += 2;
+
+      op = json_putChar (op, c);
+      cp += n;
+      }
+
+   return (op - out);
+   }
+
+/**********************************************************************/
+/* Purpose:    Get a view of a named JSON "field", for display
+ * Called by:  The trace functions
+ * Arguments:  As json_getStr()
+ * Actions:    Gets the view as json_getStr() does.  Unless it is plain
+ *             text, it is then decoded by json_decode() into the
+ *             thread's arena, and the view points at the decoded text.
+ * Affects:    The JSTR pointed by "v", and the arena.
+ * Returns:    1 if the field was found, else 0.
+ * Notes:      The arena's text is emptied by json_reset() for each
+ *             record, so the view is valid until the next record.  It
+ *             is only grown while it is empty, to the size needed for
+ *             every string in the record, as growing it would move the
+ *             views already given out.  So only a field fetched more
+ *             than once might not fit, and it is then cut short.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int json_getText (const JSONOBJ *json, const char *name,
+   JSTR *v, int maxlen)
+   {
+   JSARENA  *a = &Arena;
+   int      room;
+
+   if (!json_getStr (json, name, v, maxlen)) return (0);
+
+   if (json_plain (v->ptr, v->len) == v->len) return (1);
+
+   if (a->textUsed == 0 && a->textSize < a->textNeed)
+      {
+      a->textSize = a->textNeed;
+      if (a->textSize < JSON_TEXTMIN) a->textSize = JSON_TEXTMIN;
+
+      if ((a->text = realloc (a->text, a->textSize)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+      }
+
+   room = (a->textSize - a->textUsed) / JSON_EXPAND;
+   if (v->len > room) v->len = room;
+
+   v->len = json_decode (v->ptr, v->len, a->text + a->textUsed);
+   v->ptr = a->text + a->textUsed;
+   a->textUsed += v->len;
+
+   return (1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Get a copy of the value of a named JSON "field"
+ * Called by:  Those which need the value as a C string.
+ * Arguments:  Pointer to tokenized JSON object, field name, pointer to
+ *             a string to receive the result, size of that string.
+ * Actions:    If the field is found, its string value, up to a maximum
+ *             of "size" - 1 chars, is copied to the string pointed by
+ *             "result", and terminated.  The quotes surrouunding
+ *             string values are not copied.
+ * Affects:    The string pointed by "result".
+ * Returns:    Pointer to the value in the object's text, or NULL if
+ *             the field was not found.
+ * Notes:      "result" is left untouched if the field is not found.
+ *             Passing "sizeof (result)" ensures it can't overflow.
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to use the field index, and to take the size
+ *             of the result instead of the maximum length. */
+/**********************************************************************/
+
+static const char *json_getValue (const JSONOBJ *json,
+   const char *name, char *result, int size)
+   {
+   JSTR  v;
+
+   if (size < 1 || !json_getStr (json, name, &v, size - 1))
+      return (NULL); // Name not found
+
+   memcpy (result, v.ptr, v.len);
+   result [v.len] = 0;   // Terminate the result string
+
+   return (v.ptr);
+   }
+
+
+
+//######################################################################
+//                       MNEMONIC TABLE FUNCTIONS
+//######################################################################
+
+/* Fields such as "ptcl", "l3Type", "type", "l4type" and "l2Type" each
+ * hold one of a small set of mnemonics.  Rather than comparing them
+ * with a string of literals one after another, each set is kept in a
+ * table whose rows give the mnemonic, a code for it, and optionally
+ * the function which traces it.  The tables are hashed at startup, so
+ * a mnemonic is found with one hash and one compare, however many rows
+ * there are.  Adding a new protocol or frame type is a matter of adding
+ * a row to the table.
+ *
+ * The "-P" and "-T" filters are bitmasks of row numbers.  Mnemonics
+ * named in them which aren't in the tables are not added, as the
+ * tables are shared by the pipeline workers while a reloaded snapshot
+ * is being built.  A field which isn't in the table is compared with
+ * the filter's list instead, which is rare.
+ * */
+#define  MNEM_MAX       64       // Max rows per table, for the masks
+#define  MNEM_HASHSLOTS 128      // Power of 2, at least 2x MNEM_MAX
+
+typedef struct
+   {
+   const char  *name;            // The mnemonic, NULL ends the list
+   int         code;             // XX_xxx code for it
+   void        (*trace) (const JSONOBJ *json);  // Handler, or NULL
+   } MNEMONIC;
+
+typedef struct
+   {
+   int            count;         // Number of rows
+   MNEMONIC       row [MNEM_MAX];
+   unsigned char  slot [MNEM_HASHSLOTS];  // Row index+1, 0=empty
+   } MNEMTABLE;
+
+/**********************************************************************/
+/* Purpose:    Find a mnemonic in a table
+ * Called by:  The trace and filter functions
+ * Arguments:  Pointer to table, pointer to mnemonic (which need not be
+ *             terminated), its length.
+ * Returns:    Row number, or -1 if not found.
+ * Notes:      Not case sensitive, as the source data isn't always
+ *             consistent.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int mnem_find (const MNEMTABLE *t, const char *str, int len)
+   {
+   const MNEMONIC *m;
+   int            i;
+
+   for (i = json_hash (str, len) & (MNEM_HASHSLOTS-1); t->slot [i];
+      i = (i+1) & (MNEM_HASHSLOTS-1))
+      {
+      m = &t->row [t->slot [i] - 1];
+
+      if (strncasecmp (m->name, str, len) == 0 && m->name [len] == 0)
+         return (t->slot [i] - 1);
+      }
+
+   return (-1);
+   }
+
+// Enter row "n" of a table into its hash
+static void mnem_hash (MNEMTABLE *t, int n)
+   {
+   const char  *name = t->row [n].name;
+   int         i;
+
+   for (i = json_hash (name, strlen (name)) & (MNEM_HASHSLOTS-1);
+      t->slot [i]; i = (i+1) & (MNEM_HASHSLOTS-1));
+
+   t->slot [i] = n + 1;
+   }
+
+/**********************************************************************/
+/* Purpose:    Hash a table's rows
+ * Called by:  mnem_initAll(), at startup.
+ * Arguments:  Pointer to table.
+ * Actions:    Counts the rows, and enters each into the hash.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void mnem_init (MNEMTABLE *t)
+   {
+   memset (t->slot, 0, sizeof (t->slot));
+
+   for (t->count = 0; t->count < MNEM_MAX && t->row [t->count].name;
+      t->count++)
+      {
+      mnem_hash (t, t->count);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Convert a list of mnemonics into a bitmask of row numbers
+ * Called by:  filter_build()
+ * Arguments:  Pointer to table, pointer to list from "-P" or "-T",
+ *             pointer to flag to set if any aren't in the table.
+ * Returns:    Bitmask, with bit "n" set if row "n" is in the list.
+ * Notes:      The table isn't changed, as it is shared by all threads.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to flag the mnemonics which aren't in the
+ *             table, instead of adding them to it. */
+/**********************************************************************/
+
+static uint64_t mnem_mask (const MNEMTABLE *t, const STRLIST *list,
+   int *other)
+   {
+   uint64_t mask = 0;
+   int      i, n;
+
+   for (i = 0, *other = 0; i < list->count; i++)
+      {
+      if ((n = mnem_find (t, list->item [i], strlen (list->item [i])))
+      >= 0) mask |= (uint64_t) 1 << n;
+      else *other = 1;
+      }
+
+   return (mask);
+   }
+
+/**********************************************************************/
+/* Purpose:    Look up the mnemonic held in a field
+ * Called by:  The trace and filter functions.
+ * Arguments:  Pointer to tokenized JSON object, field name, table.
+ * Actions:    Looks the value up straight from the token, no copying.
+ * Returns:    Row number, -1 if not in table, or -2 if no such field.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int mnem_field (const JSONOBJ *json, const char *name,
+   const MNEMTABLE *t)
+   {
+   const JFIELD   *f;
+
+   if ((f = json_findField (json, name)) == NULL) return (-2);
+
+   return (mnem_find (t, json->text + f->valOff, f->valLen));
+   }
+
+/**********************************************************************/
+/* Purpose:    Check a field which isn't in a table against a list
+ * Called by:  filter_type() and filter_proto()
+ * Arguments:  Pointer to tokenized JSON object, field name, pointer to
+ *             list from "-P" or "-T".
+ * Returns:    1 if the field's value is in the list, else 0.
+ * Notes:      Not case sensitive, like mnem_find().
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int mnem_other (const JSONOBJ *json, const char *name,
+   const STRLIST *list)
+   {
+   const JFIELD   *f;
+   const char     *val;
+   int            i;
+
+   if ((f = json_findField (json, name)) == NULL) return (0);
+
+   val = json->text + f->valOff;
+
+   for (i = 0; i < list->count; i++)
+      {
+      if (strncasecmp (list->item [i], val, f->valLen) == 0
+      && list->item [i][f->valLen] == 0) return (1);
+      }
+
+   return (0);
+   }
+
+/* AX25 L2 frame types, as found in "l2Type".  These are only used for
+ * filtering, so there are no handlers.
+ * */
+#define  L2_I           1
+#define  L2_RR          2
+#define  L2_RNR         3
+#define  L2_REJ         4
+#define  L2_SREJ        5
+#define  L2_SABM        6
+#define  L2_SABME       7
+#define  L2_DISC        8
+#define  L2_DM          9
+#define  L2_UA          10
+#define  L2_FRMR        11
+#define  L2_UI          12
+#define  L2_XID         13
+#define  L2_TEST        14
+
+static MNEMTABLE L2Types =
+   {
+   0,
+      {
+      { "I",      L2_I,       NULL },
+      { "RR",     L2_RR,      NULL },
+      { "RNR",    L2_RNR,     NULL },
+      { "REJ",    L2_REJ,     NULL },
+      { "SREJ",   L2_SREJ,    NULL },
+      { "SABM",   L2_SABM,    NULL },
+      { "SABME",  L2_SABME,   NULL },
+      { "DISC",   L2_DISC,    NULL },
+      { "DM",     L2_DM,      NULL },
+      { "UA",     L2_UA,      NULL },
+      { "FRMR",   L2_FRMR,    NULL },
+      { "UI",     L2_UI,      NULL },
+      { "XID",    L2_XID,     NULL },
+      { "TEST",   L2_TEST,    NULL },
+      { NULL }
+      }
+   };
+
+//######################################################################
+//                          METRICS COUNTERS
+//######################################################################
+
+/* Counters for the metrics exported by "-E".  Each thread counts into
+ * its own block, with relaxed atomic increments, so counting costs
+ * next to nothing and threads never fight over a cache line.  The
+ * blocks are only added up when the metrics are scraped (see
+ * metric_scrape()).  Block 0 is for the main thread, 1 to MAX_THREADS
+ * for the decode workers, the next for the input queue thread, and
+ * the last for the pipeline writer.
+ *
+ * The latency histograms, and the time spent in each stage, are only
+ * kept when "-E" or "-b" is used, as reading the clock costs more than
+ * the increments.
+ * */
+#define  M_SLOTS        67       // MAX_THREADS + 3
+#define  M_BUCKETS      12       // Latency histogram buckets, inc +Inf
+
+#define  M_ERR_OVERSIZE   0      // Parse errors, by reason
+#define  M_ERR_TYPE       1
+#define  M_ERR_MANDATORY  2
+#define  M_ERR_FIELD      3
+#define  M_ERRORS         4
+
+typedef struct
+   {
+   uint64_t    count [M_BUCKETS];   // Observations in each bucket
+   uint64_t    ns;               // Total of observations
+   } MHIST;
+
+typedef struct
+   {
+   uint64_t    records;          // Records read from the inputs
+   uint64_t    bytes;            // Bytes in those records
+   uint64_t    examined;         // Frames offered to the filters
+   uint64_t    shown;            // Frames passing the filters
+   uint64_t    rejects [MAX_FILTERS];  // Frames rejected, by filter
+   uint64_t    errors [M_ERRORS];   // Parse errors, by reason
+   MHIST       decode;           // Time to decode a record
+   MHIST       output;           // Time to write out the output
+   uint64_t    frameNs;          // Time spent framing, ns
+   uint64_t    extractNs;        // Time spent tokenizing, ns
+   uint64_t    filterNs;         // Time spent in the filter plan, ns
+   } __attribute__ ((aligned (64))) METRICS;
+
+static METRICS MetricSlot [M_SLOTS];
+static __thread METRICS *Metric = &MetricSlot [0];
+static int     Metrics = 0;      // Set if the metrics are exported
+static int     Timing = 0;       // Set if the clock is read, -E or -b
+
+// Upper bounds of the histogram buckets, in ns
+static const uint64_t MetricBound [M_BUCKETS - 1] =
+   {
+   1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+   1000000, 10000000, 100000000
+   };
+
+#define  METRIC_INC(field)  \
+   __atomic_fetch_add (&Metric->field, 1, __ATOMIC_RELAXED)
+
+#define  METRIC_ADD(field, n)  \
+   __atomic_fetch_add (&Metric->field, (n), __ATOMIC_RELAXED)
+
+// Read the monotonic clock, in ns
+static uint64_t metric_now (void)
+   {
+   struct timespec ts;
+
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return ((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec);
+   }
+
+/**********************************************************************/
+/* Purpose:    Add up the counters of all the threads
+ * Called by:  metric_scrape() and filter_report_counts()
+ * Arguments:  Pointer to block to receive the totals
+ * Notes:      METRICS holds nothing but uint64_t counters, so it can
+ *             be added up as an array of them.  The counters may be
+ *             changing as they are read, so the totals are a snapshot,
+ *             which is all a scrape needs.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void metric_sum (METRICS *total)
+   {
+   uint64_t *sum = (uint64_t *) total, *n;
+   size_t   i, j;
+
+   memset (total, 0, sizeof (METRICS));
+
+   for (i = 0; i < M_SLOTS; i++)
+      {
+      n = (uint64_t *) &MetricSlot [i];
+
+      for (j = 0; j < sizeof (METRICS) / sizeof (uint64_t); j++)
+         sum [j] += __atomic_load_n (&n [j], __ATOMIC_RELAXED);
+      }
+   }
+
+// Add an observation, since "start", to a latency histogram
+static void metric_observe (MHIST *h, uint64_t start)
+   {
+   uint64_t ns = metric_now () - start;
+   int      i;
+
+   for (i = 0; i < M_BUCKETS - 1 && ns > MetricBound [i]; i++);
+
+   __atomic_fetch_add (&h->count [i], 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add (&h->ns, ns, __ATOMIC_RELAXED);
+   }
+
+// Add the time since "start" to a stage counter, and return the time
+static uint64_t metric_stage (uint64_t *total, uint64_t start)
+   {
+   uint64_t now = metric_now ();
+
+   __atomic_fetch_add (total, now - start, __ATOMIC_RELAXED);
+   return (now);
+   }
+
+//######################################################################
+//                         PROFILING FUNCTIONS
+//######################################################################
+
+/* Built with "-DPROFILE", the program finds out where the time goes on
+ * the real feed.  At each stage boundary, and at the entry of each of
+ * the trace_xxx() decoders, PROF_MARK() reads the time stamp counter
+ * (or the monotonic clock if there isn't one), and charges the time
+ * since the last mark to whatever was running until then.  Marking
+ * only the entries means a decoder with several returns needs just
+ * one mark, at the cost of charging whatever its caller does after it
+ * returns to the decoder, which is little.
+ *
+ * The cost of each whole record is also added to a log2 histogram,
+ * keyed by its "@type", "ptcl" and "l4type", in a small table.  As with
+ * the metrics, each thread has its own slot (the same index as its
+ * METRICS block), so nothing is shared or locked.  The report is
+ * written to stderr on exit, and on SIGUSR2.  It is read without
+ * stopping the threads, so it may be a record out of date.
+ *
+ * Without PROFILE, the macros compile to nothing at all.
+ * */
+#ifdef PROFILE
+
+#define  P_OTHER        0        // Reading, waiting etc.
+#define  P_FRAME        1        // Framing the objects in the input
+#define  P_EXTRACT      2        // Tokenizing
+#define  P_FILTER       3        // Applying the filter plan
+#define  P_FORMAT       4        // Formatting the L2 header
+#define  P_OUTPUT       5        // Writing the output
+#define  P_DATA         6        // The trace_xxx() decoders
+#define  P_IP           7
+#define  P_ARP          8
+#define  P_NETROM       9
+#define  P_L3           10
+#define  P_L3RTT        11
+#define  P_L4           12
+#define  P_ROUTEINFO    13
+#define  P_ROUTEPOLL    14
+#define  P_NODES        15
+#define  P_INP3         16
+#define  P_CENTRES      17
+
+#define  PROF_KEYS      64       // Record kinds per thread, power of 2
+#define  PROF_KEYLEN    40       // Longest "type/ptcl/l4type"
+#define  PROF_BUCKETS   32       // log2 histogram buckets
+
+static const char *ProfCentre [P_CENTRES] =
+   {
+   "other", "frame", "extract", "filter", "format", "output",
+   "trace_data", "trace_ip", "trace_arp", "trace_netrom",
+   "trace_netromL3", "trace_l3rtt", "trace_netromL4",
+   "trace_netromRoutingInfo", "trace_netromRoutingPoll",
+   "trace_nodes", "trace_inp3"
+   };
+
+typedef struct
+   {
+   char        key [PROF_KEYLEN];   // "type/ptcl/l4type", "" if unused
+   uint64_t    records;          // Records of this kind
+   uint64_t    ticks;            // Total of their costs
+   uint64_t    hist [PROF_BUCKETS];  // Records by log2 of cost
+   } PROFKEY;
+
+typedef struct
+   {
+   uint64_t    ticks [P_CENTRES];   // Time charged to each centre
+   uint64_t    marks [P_CENTRES];   // Times each centre was entered
+   uint64_t    last;             // Time of the last mark
+   int         centre;           // Centre running since then
+   char        part [3][16];     // Key of the current record
+   uint64_t    start;            // When the current record started
+   PROFKEY     kind [PROF_KEYS];
+   } PROFSLOT;
+
+static PROFSLOT   ProfSlot [M_SLOTS];
+static volatile sig_atomic_t ProfQuery = 0;  // Set by SIGUSR2
+
+#define  PROF_MARK(c)      prof_mark (c)
+#define  PROF_KEY(i, v)    prof_key (i, v)
+#define  PROF_BEGIN()      prof_begin ()
+#define  PROF_END()        prof_end ()
+#define  PROF_POLL()       if (ProfQuery) prof_report ()
+
+// Read the time stamp counter, or the clock if there isn't one
+static inline uint64_t prof_now (void)
+   {
+#if defined(__x86_64__) || defined(__i386__)
+   return (__rdtsc ());
+#else
+   return (metric_now ());
+#endif
+   }
+
+// The thread's slot is the one with the same index as its METRICS
+#define  PROF_SLOT()    (&ProfSlot [Metric - MetricSlot])
+
+// Charge the time since the last mark, and start timing centre "c"
+static inline void prof_mark (int c)
+   {
+   PROFSLOT *ps = PROF_SLOT ();
+   uint64_t now = prof_now ();
+
+   if (ps->last) ps->ticks [ps->centre] += now - ps->last;
+
+   ps->marks [c]++;
+   ps->centre = c;
+   ps->last = now;
+   }
+
+// Note part of the current record's key: 0 @type, 1 ptcl, 2 l4type
+static inline void prof_key (int i, const JSTR *v)
+   {
+   snprintf (PROF_SLOT ()->part [i], 16, "%.*s",
+      v->len < 15 ? v->len : 15, v->ptr);
+   }
+
+// Start timing a record
+static inline void prof_begin (void)
+   {
+   PROFSLOT *ps = PROF_SLOT ();
+
+   ps->part [0][0] = ps->part [1][0] = ps->part [2][0] = 0;
+   ps->start = prof_now ();
+   }
+
+/**********************************************************************/
+/* Purpose:    Finish timing a record
+ * Called by:  PROF_END() in metric_process()
+ * Actions:    Builds the record's key from the parts noted while it was
+ *             decoded, finds it in the thread's table, entering it if
+ *             there's room, and adds the record's cost to its
+ *             histogram.  Charges anything more to "other".
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void prof_end (void)
+   {
+   PROFSLOT *ps = PROF_SLOT ();
+   PROFKEY  *pk;
+   char     key [PROF_KEYLEN];
+   uint64_t ticks = prof_now () - ps->start;
+   unsigned i, n;
+   int      b;
+
+   snprintf (key, sizeof (key), "%s/%s/%s", *ps->part [0] ?
+      ps->part [0] : "-", *ps->part [1] ? ps->part [1] : "-",
+      *ps->part [2] ? ps->part [2] : "-");
+
+   i = json_hash (key, strlen (key));
+
+   for (n = 0; n < PROF_KEYS; n++, i++)
+      {
+      pk = &ps->kind [i & (PROF_KEYS - 1)];
+
+      if (*pk->key == 0) strcpy (pk->key, key);
+      if (strcmp (pk->key, key) == 0) break;
+      }
+
+   if (n < PROF_KEYS)   // Else the table is full, so not counted
+      {
+      for (b = 0; b < PROF_BUCKETS - 1 && (ticks >> b) > 1; b++);
+      pk->records++;
+      pk->ticks += ticks;
+      pk->hist [b]++;
+      }
+
+   prof_mark (P_OTHER);
+   }
+
+// Find the upper bound of the bucket holding a fraction of the records
+static uint64_t prof_centile (const PROFKEY *pk, double fraction)
+   {
+   uint64_t n = 0, want = pk->records * fraction;
+   int      b;
+
+   for (b = 0; b < PROF_BUCKETS - 1; b++)
+      if ((n += pk->hist [b]) > want) break;
+
+   return ((uint64_t) 2 << b);
+   }
+
+/**********************************************************************/
+/* Purpose:    Write the profile report
+ * Called by:  main() on exit, and the input loops on SIGUSR2
+ * Actions:    Adds up the threads' slots, then writes the time charged
+ *             to each stage and decoder, and the number, mean cost and
+ *             approximate median and 99th centile cost of each kind of
+ *             record.
+ * Affects:    stderr, so as not to pollute the trace output.
+ * Notes:      The costs are in time stamp counter ticks, which are
+ *             roughly CPU cycles, or in ns if there is no TSC.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void prof_report (void)
+   {
+   static PROFKEY kind [PROF_KEYS * M_SLOTS];
+   PROFSLOT *ps;
+   PROFKEY  *pk, *sum;
+   uint64_t ticks [P_CENTRES] = { 0 }, marks [P_CENTRES] = { 0 };
+   uint64_t total = 0;
+   int      i, j, b, nkinds = 0;
+
+   ProfQuery = 0;
+
+   for (i = 0; i < M_SLOTS; i++)
+      {
+      ps = &ProfSlot [i];
+
+      for (j = 0; j < P_CENTRES; j++)
+         {
+         ticks [j] += ps->ticks [j];
+         marks [j] += ps->marks [j];
+         }
+
+      // Merge each thread's kinds of record
+      for (j = 0; j < PROF_KEYS; j++)
+         {
+         pk = &ps->kind [j];
+         if (*pk->key == 0) continue;
+
+         for (sum = kind; sum < kind + nkinds; sum++)
+            if (strcmp (sum->key, pk->key) == 0) break;
+
+         if (sum == kind + nkinds)
+            {
+            memset (sum, 0, sizeof (PROFKEY));
+            strcpy (sum->key, pk->key);
+            nkinds++;
+            }
+
+         sum->records += pk->records;
+         sum->ticks += pk->ticks;
+         for (b = 0; b < PROF_BUCKETS; b++)
+            sum->hist [b] += pk->hist [b];
+         }
+      }
+
+   for (j = 0; j < P_CENTRES; j++) total += ticks [j];
+   if (total == 0) total = 1;
+
+   fprintf (stderr, "\n%-26s %12s %7s %14s\n", "Profile by stage",
+      "calls", "%", "ticks");
+
+   for (j = 0; j < P_CENTRES; j++)
+      {
+      if (marks [j] == 0) continue;
+
+      fprintf (stderr, "%-26s %12llu %6.2f%% %14llu\n", ProfCentre [j],
+         (unsigned long long) marks [j], 100.0 * ticks [j] / total,
+         (unsigned long long) ticks [j]);
+      }
+
+   fprintf (stderr, "\n%-32s %10s %9s %9s %9s\n", "Profile by record",
+      "records", "mean", "median", "99%");
+
+   for (pk = kind; pk < kind + nkinds; pk++)
+      {
+      fprintf (stderr, "%-32s %10llu %9llu %9llu %9llu\n", pk->key,
+         (unsigned long long) pk->records,
+         (unsigned long long) (pk->ticks / pk->records),
+         (unsigned long long) prof_centile (pk, 0.5),
+         (unsigned long long) prof_centile (pk, 0.99));
+      }
+   }
+
+#else    // Not PROFILE, so the hooks cost nothing
+
+#define  PROF_MARK(c)
+#define  PROF_KEY(i, v)
+#define  PROF_BEGIN()
+#define  PROF_END()
+#define  PROF_POLL()
+
+#endif   // PROFILE
+
+//######################################################################
+//                       PACKET TRACE FUNCTIONS
+//######################################################################
+
+/* Output is not written piecemeal.  Each trace is assembled in a pair
+ * of growable buffers, one for the screen and one for the capture
+ * file, which differ only in whether they carry colour information.
+ * At the end of each trace the buffers are written out whole, and
+ * flushed according to the flush policy set by the "-F" option.
+ *
+ * "Out" points at the buffers the current thread is formatting into.
+ * Normally that is MainOut, but each decode pipeline worker formats
+ * into the buffers of the record it is working on.
+ * */
+typedef struct
+   {
+   char     *buf;                // Start of buffer (heap)
+   size_t   len;                 // Bytes currently in buffer
+   size_t   size;                // Allocated size of buffer
+   } OUTBUF;
+
+typedef struct
+   {
+   size_t   file;                // End of a trace in the capture file
+   size_t   json;                // And in the JSON archive
+   } OUTMARK;
+
+typedef struct
+   {
+   OUTBUF   screen;              // Pending output for stdout
+   OUTBUF   file;                // Pending output for capture file
+   OUTBUF   json;                // Pending output for JSON archive
+   int      records;             // Number of traces pending
+   uint64_t dupHash;             // Pending duplicate check, 0 = none
+   long     dupTime;             // Time of the frame to check
+   unsigned dupReporter;         // Intern ID of its reporter
+   OUTMARK  *marks;              // Where the pending traces end, if -X
+   int      nMarks;              // Number of them
+   int      maxMarks;            // Allocated number
+   } OUTPUT;
+
+static OUTPUT  MainOut;          // Output waiting to be written
+static __thread OUTPUT *Out = &MainOut;  // Where uprintf() goes
+static int     FlushRecords = 1; // Flush every N traces (default 1)
+static int     FlushSecs = 0;    // Or if non-zero, every N seconds
+static time_t  LastFlush = 0;
+
+/**********************************************************************/
+/* Purpose:    Ensure there is room in an output buffer
+ * Called by:  out_append() and uprintf()
+ * Arguments:  Pointer to output buffer, number of bytes required in
+ *             addition to those already in the buffer.
+ * Actions:    Grows the buffer if necessary, doubling its size.
+ * Affects:    The output buffer.
+ * Returns:    None.  Exits the program if memory is exhausted.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void out_reserve (OUTBUF *ob, size_t need)
+   {
+   size_t   size = ob->size ? ob->size : 4096;
+
+   while (ob->len + need + 1 > size) size *= 2;
+
+   if (size != ob->size)
+      {
+      if ((ob->buf = realloc (ob->buf, size)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+      ob->size = size;
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Append bytes to an output buffer
+ * Called by:  uprintf(), out_screen() and pipe_writer()
+ * Arguments:  Pointer to output buffer, pointer to data, length.
+ * Affects:    The output buffer.
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to do nothing if there is nothing to add. */
+/**********************************************************************/
+
+static void out_append (OUTBUF *ob, const char *data, size_t len)
+   {
+   if (len == 0) return;   // The buffers may not be allocated yet
+
+   out_reserve (ob, len);
+   memcpy (ob->buf + ob->len, data, len);
+   ob->len += len;
+   }
+
+/**********************************************************************/
+/* Purpose:    Output a string to the screen only
+ * Called by:  process_json() and frame_stream()
+ * Arguments:  String to output.
+ * Actions:    Appends the string to the screen buffer, even in "quiet"
+ *             mode.  Used for colour changes and warnings, which were
+ *             previously printf()'d directly.
+ * Affects:    The screen buffer.
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void out_screen (const char *str)
+   {
+   out_append (&Out->screen, str, strlen (str));
+   }
+
+/* The capture file ("-o") and the JSON archive ("-J") are written by a
+ * background thread, so that a slow disk or compressor never holds up
+ * the decoding.  out_flush() just appends the pending output to the
+ * file's queue, and the thread writes it out.  The output is queued in
+ * whole traces, so the files can be rotated cleanly between records,
+ * after a given size ("-X") or at a given interval ("-Y"), and can be
+ * compressed by piping them through "gzip" or "zstd" ("-z").  If the
+ * thread falls too far behind, out_flush() waits for it.
+ * */
+#define  LOG_PLAIN      0        // Compression methods
+#define  LOG_GZIP       1
+#define  LOG_ZSTD       2
+#define  LOG_MAXQUEUE   (64 * 1024 * 1024)  // Max bytes queued per file
+#define  LOG_RETRY      60       // Seconds before retrying after errors
+
+typedef struct
+   {
+   OUTBUF      out;              // Output waiting to be written
+   int         batches;          // Number of batches in it
+   int         size;             // Allocated number of batch ends
+   size_t      *end;             // Where each batch ends (heap)
+   } LOGQUEUE;
+
+typedef struct
+   {
+   const char  *what;            // What it is, for messages
+   char        name [256];       // File name given, "" if not used
+   char        path [300];       // Name of the current file
+   int         fd;               // Current file or pipe, -1 if none
+   pid_t       pid;              // Compressor process, or 0
+   long long   bytes;            // Bytes written to current file
+   long long   lost;             // Bytes that couldn't be written
+   time_t      opened;           // When it was opened
+   time_t      failed;           // When writing it last failed, or 0
+   LOGQUEUE    queue [2];        // Filled and written alternately
+   int         fill;             // Which one out_flush() fills
+   } LOGFILE;
+
+static LOGFILE TraceLog = { "capture file", "", "", -1 };
+static LOGFILE JsonLog = { "JSON archive", "", "", -1 };
+static long long LogMaxBytes = 0;      // Rotate after this many bytes
+static int     LogMaxSecs = 0;         // Or every this many seconds
+static int     LogCompress = LOG_PLAIN;
+static int     LogEnd = 0;             // Set to stop the writer
+static pthread_t LogThread;
+static pthread_mutex_t LogLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t LogWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t LogRoom = PTHREAD_COND_INITIALIZER;
+
+static const char *LogExt [] = { "", ".gz", ".zst" };
+static const char *LogProg [] = { NULL, "gzip", "zstd" };
+
+/**********************************************************************/
+/* Purpose:    Parse a "-X" or "-Y" option
+ * Called by:  main()
+ * Arguments:  Option value, e.g. "100M" for "-X", or "1h" for "-Y",
+ *             0 for a size or 1 for an interval.
+ * Returns:    Bytes or seconds, or -1 if the value isn't valid.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static long long log_limit (const char *value, int interval)
+   {
+   static const long long bytes [] = { 1 << 10, 1 << 20, 1 << 30 };
+   static const long long secs [] = { 1, 60, 3600, 86400 };
+   const char  *suffixes = interval ? "smhd" : "KMG", *cp;
+   const long long *scale = interval ? secs : bytes;
+   char        *end;
+   long long   n = strtoll (value, &end, 10);
+
+   if (end == value || n <= 0) return (-1);
+   if (*end == 0) return (n);
+
+   if (end [1] || (cp = strchr (suffixes, *end)) == NULL) return (-1);
+
+   return (n * scale [cp - suffixes]);
+   }
+
+/**********************************************************************/
+/* Purpose:    Parse a "-z" option
+ * Called by:  main()
+ * Arguments:  Option value, "gzip" or "zstd"
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int log_option (const char *value)
+   {
+#ifndef WIN32
+   if (strcmp (value, "gzip") == 0 || strcmp (value, "gz") == 0)
+      LogCompress = LOG_GZIP;
+
+   else if (strcmp (value, "zstd") == 0 || strcmp (value, "zst") == 0)
+      LogCompress = LOG_ZSTD;
+
+   else
+#endif
+      {
+      printf ("Unknown compression '%s'\n", value);
+      return (-1);
+      }
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Start a compressor for a log file
+ * Called by:  log_open()
+ * Arguments:  Pointer to log file, descriptor of the file opened for
+ *             the compressed output.
+ * Actions:    Runs gzip or zstd with its stdin on a new pipe and its
+ *             stdout on the file.  The compressor is put in its own
+ *             process group, so that Ctrl-C doesn't kill it before it
+ *             has written out the end of the file.
+ * Returns:    Descriptor of the pipe, or -1 if it failed.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+#ifndef WIN32
+static int log_compressor (LOGFILE *lf, int fd)
+   {
+   int   p [2];
+
+   if (pipe (p) < 0) return (-1);
+
+   // The write end mustn't be inherited by the other compressor
+   fcntl (p [1], F_SETFD, FD_CLOEXEC);
+
+   if ((lf->pid = fork ()) == 0)
+      {
+      setpgid (0, 0);
+      dup2 (p [0], STDIN_FILENO);
+      dup2 (fd, STDOUT_FILENO);
+      close (p [0]);
+      close (fd);
+      execlp (LogProg [LogCompress], LogProg [LogCompress], "-c", NULL);
+      _exit (127);
+      }
+
+   close (p [0]);
+
+   if (lf->pid < 0)
+      {
+      lf->pid = 0;
+      close (p [1]);
+      return (-1);
+      }
+
+   return (p [1]);
+   }
+#endif
+
+/**********************************************************************/
+/* Purpose:    Open a new file for a log
+ * Called by:  main() at startup, and log_write() to rotate the file.
+ * Arguments:  Pointer to log file
+ * Actions:    If rotating, the date and time is added to the name, and
+ *             a serial number too if that name is already taken, e.g.
+ *             "trace.txt.20261014-090000_02.gz".  If
+ *             compressing, the extension for the compressor is added,
+ *             if it isn't already there, and the compressor started.
+ * Returns:    0 if successful, else -1
+ * Notes:      Without rotation, an existing file is overwritten, but
+ *             only the first time.  If it has to be opened again, it
+ *             is appended to, so nothing already captured is lost.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to append if opened again. */
+/**********************************************************************/
+
+static int log_open (LOGFILE *lf)
+   {
+   const char  *ext = LogExt [LogCompress];
+   char        stamp [32];
+   int         fd, n, len, flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+   if (*lf->path) flags = O_WRONLY | O_CREAT | O_APPEND;
+
+   lf->opened = time (NULL);
+   lf->bytes = 0;
+
+   len = snprintf (lf->path, 256, "%s", lf->name);
+
+   if (LogMaxBytes || LogMaxSecs)
+      {
+      strftime (stamp, 32, ".%Y%m%d-%H%M%S", localtime (&lf->opened));
+      len += sprintf (lf->path + len, "%s", stamp);
+      flags |= O_EXCL;
+      }
+
+   // Don't add the extension if it's already there
+   n = strlen (ext);
+   if (len >= n && strcmp (lf->path + len - n, ext) == 0) ext = "";
+
+   sprintf (lf->path + len, "%s", ext);
+
+   for (n = 2; (fd = open (lf->path, flags, 0644)) < 0; n++)
+      {
+      if (errno != EEXIST || n > 99) return (-1);
+      sprintf (lf->path + len, "_%02d%s", n, ext);
+      }
+
+#ifndef WIN32
+   if (LogCompress)
+      {
+      lf->fd = log_compressor (lf, fd);
+      close (fd);
+      return (lf->fd < 0 ? -1 : 0);
+      }
+#endif
+
+   lf->fd = fd;
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Close the current file of a log
+ * Called by:  log_write() to rotate the file, and log_stop().
+ * Arguments:  Pointer to log file
+ * Actions:    Closes the file, and waits for the compressor to finish.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void log_close (LOGFILE *lf)
+   {
+   if (lf->fd < 0) return;
+
+   close (lf->fd);
+   lf->fd = -1;
+
+#ifndef WIN32
+   if (lf->pid) waitpid (lf->pid, NULL, 0);
+   lf->pid = 0;
+#endif
+   }
+
+/**********************************************************************/
+/* Purpose:    Write a batch of output to a log file
+ * Called by:  log_write()
+ * Arguments:  Pointer to log file, pointer to output, its length.
+ * Actions:    Rotates the file first if it has reached the size limit,
+ *             or crossed a multiple of the rotation interval, then
+ *             writes the output.  If the file can't be opened or
+ *             written, that is reported once, and the output is
+ *             discarded for LOG_RETRY seconds before trying again.
+ * Notes:      A batch is always whole traces or records, so the files
+ *             are only rotated between them.  With a size limit each
+ *             batch is one trace, so a file exceeds the limit by less
+ *             than the last trace or record written to it.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to keep the file open after a write error,
+ *             and to back off instead of retrying every batch. */
+/**********************************************************************/
+
+static void log_batch (LOGFILE *lf, const char *buf, size_t len)
+   {
+   time_t   now = time (NULL);
+   size_t   done;
+   ssize_t  n;
+
+   if (lf->failed && now - lf->failed < LOG_RETRY)
+      {
+      lf->lost += len;
+      return;
+      }
+
+   if (lf->fd >= 0 && ((LogMaxBytes && lf->bytes >= LogMaxBytes)
+   || (LogMaxSecs && now / LogMaxSecs != lf->opened / LogMaxSecs)))
+      {
+      log_close (lf);
+      }
+
+   if (lf->fd < 0 && log_open (lf) < 0)
+      {
+      if (lf->failed == 0)
+         fprintf (stderr, "Can't open %s '%s'\n", lf->what, lf->path);
+
+      lf->failed = now;
+      lf->lost += len;
+      return;
+      }
+
+   for (done = 0; done < len; done += n)
+      {
+      if ((n = write (lf->fd, buf + done, len - done)) < 0
+      && errno == EINTR) n = 0;
+
+      else if (n <= 0)
+         {
+         if (lf->failed == 0)
+            fprintf (stderr, "Can't write %s '%s': %s\n", lf->what,
+               lf->path, n < 0 ? strerror (errno) : "nothing written");
+
+         lf->failed = now;
+         lf->lost += len - done;
+         break;
+         }
+      }
+
+   lf->bytes += done;
+
+   if (done == len && lf->failed)
+      {
+      fprintf (stderr, "Writing %s '%s' again\n", lf->what, lf->path);
+      lf->failed = 0;
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Write the output taken from a log's queue
+ * Called by:  log_thread()
+ * Arguments:  Pointer to log file
+ * Actions:    Writes each batch in the queue which isn't being filled,
+ *             then empties it.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void log_write (LOGFILE *lf)
+   {
+   LOGQUEUE *q = &lf->queue [lf->fill ^ 1];
+   size_t   start;
+   int      i;
+
+   for (i = 0, start = 0; i < q->batches; start = q->end [i++])
+      log_batch (lf, q->out.buf + start, q->end [i] - start);
+
+   q->out.len = 0;
+   q->batches = 0;
+   }
+
+/**********************************************************************/
+/* Purpose:    Log file writer thread
+ * Called by:  Created by log_start()
+ * Actions:    Waits for output to be queued, then swaps the queues, so
+ *             out_flush() can carry on filling the other one, and
+ *             writes them, until told to stop and there's nothing left.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void *log_thread (void *arg)
+   {
+   pthread_mutex_lock (&LogLock);
+
+   while (1)
+      {
+      while (!LogEnd && TraceLog.queue [TraceLog.fill].batches == 0
+      && JsonLog.queue [JsonLog.fill].batches == 0)
+         pthread_cond_wait (&LogWork, &LogLock);
+
+      if (TraceLog.queue [TraceLog.fill].batches == 0
+      && JsonLog.queue [JsonLog.fill].batches == 0) break;
+
+      TraceLog.fill ^= 1;
+      JsonLog.fill ^= 1;
+
+      pthread_cond_signal (&LogRoom);
+      pthread_mutex_unlock (&LogLock);
+
+      log_write (&TraceLog);
+      log_write (&JsonLog);
+
+      pthread_mutex_lock (&LogLock);
+      }
+
+   pthread_mutex_unlock (&LogLock);
+
+   return (NULL);
+   }
+
+/**********************************************************************/
+/* Purpose:    Open the log files, and start the writer thread
+ * Called by:  main(), if "-o" or "-J" is used
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int log_start (void)
+   {
+   LOGFILE  *lf;
+   int      i;
+
+   for (i = 0; i < 2; i++)
+      {
+      lf = i ? &JsonLog : &TraceLog;
+      if (*lf->name == 0) continue;
+
+      if (log_open (lf) < 0)
+         {
+         printf ("Can't open %s '%s'\n", lf->what, lf->path);
+         return (-1);
+         }
+      }
+
+#ifndef WIN32
+   // A compressor that dies shouldn't take the program with it
+   if (LogCompress) signal (SIGPIPE, SIG_IGN);
+#endif
+
+   if (pthread_create (&LogThread, NULL, log_thread, NULL) != 0)
+      {
+      printf ("Can't start log writer\n");
+      return (-1);
+      }
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Append output to a log file's queue
+ * Called by:  log_queue()
+ * Arguments:  Pointer to queue, pointer to output, the pending output
+ *             it came from, 1 if it is for the JSON archive, else 0.
+ * Actions:    Appends the output, and ends a batch after each trace
+ *             marked in it, and after the last of it.
+ * Affects:    The queue, whose table of batch ends grows as needed.
+ * Returns:    None.  Exits the program if memory is exhausted.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to keep every trace as a batch of its own, so
+ *             the size limit can be kept to. */
+/**********************************************************************/
+
+static void log_append (LOGQUEUE *q, const OUTBUF *ob, const OUTPUT *o,
+   int json)
+   {
+   size_t   base = q->out.len, prev = 0, end;
+   int      i;
+
+   if (ob->len == 0) return;
+
+   out_append (&q->out, ob->buf, ob->len);
+
+   for (i = 0; i <= o->nMarks; i++)
+      {
+      if (i == o->nMarks) end = ob->len;
+      else end = json ? o->marks [i].json : o->marks [i].file;
+
+      if (end <= prev) continue;    // Nothing for this file
+
+      if (q->batches == q->size)
+         {
+         q->size = q->size ? q->size * 2 : 1024;
+
+         if ((q->end = realloc (q->end, q->size * sizeof (size_t)))
+         == NULL)
+            {
+            fprintf (stderr, "Out of memory\n");
+            exit (-1);
+            }
+         }
+
+      q->end [q->batches++] = base + end;
+      prev = end;
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Queue output for the log files
+ * Called by:  out_flush()
+ * Arguments:  Pending output, for the capture file and JSON archive
+ * Actions:    Appends the output to the queues and wakes the writer,
+ *             first waiting for it if it has fallen too far behind.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to pass on where each trace ends. */
+/**********************************************************************/
+
+static void log_queue (const OUTPUT *o)
+   {
+   pthread_mutex_lock (&LogLock);
+
+   while (TraceLog.queue [TraceLog.fill].out.len >= LOG_MAXQUEUE
+   || JsonLog.queue [JsonLog.fill].out.len >= LOG_MAXQUEUE)
+      pthread_cond_wait (&LogRoom, &LogLock);
+
+   log_append (&TraceLog.queue [TraceLog.fill], &o->file, o, 0);
+   log_append (&JsonLog.queue [JsonLog.fill], &o->json, o, 1);
+
+   pthread_cond_signal (&LogWork);
+   pthread_mutex_unlock (&LogLock);
+   }
+
+/**********************************************************************/
+/* Purpose:    Stop the writer thread, and close the log files
+ * Called by:  main() on exit
+ * Actions:    Waits for all the queued output to be written, then
+ *             reports any that couldn't be.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to report the output lost. */
+/**********************************************************************/
+
+static void log_stop (void)
+   {
+   LOGFILE  *lf;
+   int      i;
+
+   if (*TraceLog.name == 0 && *JsonLog.name == 0) return;
+
+   pthread_mutex_lock (&LogLock);
+   LogEnd = 1;
+   pthread_cond_signal (&LogWork);
+   pthread_mutex_unlock (&LogLock);
+
+   pthread_join (LogThread, NULL);
+
+   for (i = 0; i < 2; i++)
+      {
+      lf = i ? &JsonLog : &TraceLog;
+      log_close (lf);
+
+      if (lf->lost) fprintf (stderr, "%lld bytes not written to %s\n",
+         lf->lost, lf->what);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Write all pending output
+ * Called by:  out_policy() and main()
+ * Actions:    Writes the screen buffer in one operation and flushes
+ *             stdout, and queues the capture and JSON archive buffers
+ *             for the log writer thread.
+ * Affects:    stdout, and the log file queues.
+ * Returns:    None
+ * Notes:      Only ever called by one thread at a time.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to queue the files for the writer thread,
+ *             to time it for the metrics and the profile, and to clear
+ *             the trace marks once queued. */
+/**********************************************************************/
+
+static void out_flush (void)
+   {
+   uint64_t start = Timing ? metric_now () : 0;
+
+   PROF_MARK (P_OUTPUT);
+
+   if (MainOut.file.len || MainOut.json.len)
+      log_queue (&MainOut);
+
+   if (MainOut.screen.len)
+      {
+      fwrite (MainOut.screen.buf, 1, MainOut.screen.len, stdout);
+      fflush (stdout);
+      }
+
+   if (Timing) metric_observe (&Metric->output, start);
+
+   MainOut.file.len = MainOut.screen.len = MainOut.json.len = 0;
+   MainOut.records = MainOut.nMarks = 0;
+
+   PROF_MARK (P_OTHER);
+   }
+
+/**********************************************************************/
+/* Purpose:    Mark the end of a trace in the pending output
+ * Called by:  out_endRecord() and pipe_writer()
+ * Actions:    Notes how far the capture file and JSON archive output
+ *             have got, so that the log writer can rotate the files
+ *             between any two traces, even when several are flushed
+ *             together.  Only needed with a size limit ("-X").
+ * Affects:    MainOut, whose table of marks grows as needed.
+ * Returns:    None.  Exits the program if memory is exhausted.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void out_mark (void)
+   {
+   OUTMARK  *m;
+
+   if (LogMaxBytes == 0) return;
+
+   if (MainOut.nMarks == MainOut.maxMarks)
+      {
+      MainOut.maxMarks = MainOut.maxMarks ? MainOut.maxMarks * 2 : 64;
+
+      if ((MainOut.marks = realloc (MainOut.marks,
+         MainOut.maxMarks * sizeof (OUTMARK))) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+      }
+
+   m = &MainOut.marks [MainOut.nMarks++];
+   m->file = MainOut.file.len;
+   m->json = MainOut.json.len;
+   }
+
+/**********************************************************************/
+/* Purpose:    Apply the flush policy to the pending output
+ * Called by:  out_endRecord() and pipe_writer()
+ * Actions:    Writes out the pending output if the flush policy says
+ *             so.  The policy is either "every N traces" or "every N
+ *             seconds", checked at the end of each trace.
+ * Affects:    stdout and capture file, if flushed.
+ * Returns:    None
+ * Notes:      With a time based policy and a quiet input, the last
+ *             traces are held until the next one arrives.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void out_policy (void)
+   {
+   if (FlushSecs)
+      {
+      time_t   now = time (NULL);
+
+      if (now - LastFlush < FlushSecs) return;
+      LastFlush = now;
+      }
+
+   else if (MainOut.records < FlushRecords) return;
+
+   out_flush ();
+   }
+
+/**********************************************************************/
+/* Purpose:    Mark the end of a trace
+ * Called by:  process_json()
+ * Actions:    Counts the trace.  If not running as a pipeline worker,
+ *             applies the flush policy.  A worker's output is written
+ *             by the pipeline writer instead.
+ * Affects:    stdout and capture file, if flushed.
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to mark the trace's end for the log writer. */
+/**********************************************************************/
+
+static void out_endRecord (void)
+   {
+   Out->records++;
+
+   if (Out == &MainOut)
+      {
+      out_mark ();
+      out_policy ();
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Output to user and optional capture file
+ * Called by:  Most functions.
+ * Arguments:  Format string plus zero or more additional fields
+ * Actions:    Prints the data into the capture buffer if capturing,
+ *             and/or the screen buffer if not in "quiet" mode.  They
+ *             are written out at the end of the trace.
+ * Affects:    Screen and capture buffers.
+ * Returns:    Number of characters printed.
+ * Notes:      There is no limit on the length of the output.  The
+ *             data is only formatted once, then copied if needed.
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to buffer each trace. */
+/**********************************************************************/
+
+static int uprintf (char *fmt, ...)
+   {
+   OUTBUF   *ob;
+   va_list  arg;
+   int      n;
+
+   // Output to capture file if it is open, else to stdio
+   ob = *TraceLog.name ? &Out->file : &Out->screen;
+
+   if (ob == &Out->screen && (Cfg->traceFlags & TRACE_QUIET))
+      return (0);
+
+   out_reserve (ob, 256);
+
+   va_start (arg, fmt);
+   n = vsnprintf (ob->buf + ob->len, ob->size - ob->len, fmt, arg);
+   va_end (arg);
+
+   if (n < 0) return (0);
+
+   if ((size_t) n >= ob->size - ob->len)  // Didn't fit, so try again
+      {
+      out_reserve (ob, n);
+      va_start (arg, fmt);
+      vsnprintf (ob->buf + ob->len, ob->size - ob->len, fmt, arg);
+      va_end (arg);
+      }
+
+   // Also to stdio if not in "quiet" mode
+   if (ob == &Out->file && (Cfg->traceFlags & TRACE_QUIET) == 0)
+      out_append (&Out->screen, ob->buf + ob->len, n);
+
+   ob->len += n;
+
+   return (n);
+   }
+
+/**********************************************************************/
+/* Purpose:    Output unformatted text to user and optional capture file
+ * Called by:  process_json(), for the cached trace headers
+ * Arguments:  Pointer to text, its length.
+ * Actions:    As uprintf(), but copies the text as it is.
+ * Affects:    Screen and capture buffers.
+ * Returns:    Number of characters output.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int uwrite (const char *data, int len)
+   {
+   OUTBUF   *ob;
+
+   ob = *TraceLog.name ? &Out->file : &Out->screen;
+
+   if (ob == &Out->screen && (Cfg->traceFlags & TRACE_QUIET))
+      return (0);
+
+   out_append (ob, data, len);
+
+   if (ob == &Out->file && (Cfg->traceFlags & TRACE_QUIET) == 0)
+      out_append (&Out->screen, data, len);
+
+   return (len);
+   }
+
+
+/**********************************************************************/
+/* Purpose:    Decode and display a 'NODES' broadcast.
+ * Called by:  trace_netromRoutingInfo() only.
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    Displays the alias of the node making the broadcast,
+ *             then loops through the "nodes" array, displaying details
+ *             of each route.
+ * Affects:    stdout only
+ * Returns:    None
+ * Notes:      The "nodes" array is located via the field index, so
+ *             the field *name* "nodes" can't be confused with the
+ *             field *value* "NODES" which appears earlier in the
+ *             string, and "fromAlias" may appear anywhere.
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to index each node in place, and to
+ *             count parse errors, and to format from views of the
+ *             fields, and to decode the strings shown. */
+/**********************************************************************/
+
+static void trace_nodes (const JSONOBJ *json)
+   {
+   JSTR           v;
+   const JFIELD   *nodes;
+   JSONOBJ        node;
+   int            n;
+
+   PROF_MARK (P_NODES);
+
+   if ((Cfg->traceFlags & TRACE_NODES) == 0)
+      {
+      uprintf (" NODES Broadcast");
+      return; // Not wanted
+      }
+
+   if (!json_getText (json, "fromAlias", &v, 6))
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [missing 'fromAlias']");
+      return;
+      }
+
+   uprintf ("%sNODES Broadcast from %.*s:", Margin, v.len, v.ptr);
+
+   if ((nodes = json_findArray (json, "nodes")) == NULL)
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [missing 'nodes' array]");
+      return;
+      }
+
+   for (n = 0; json_getElement (json, nodes, n, &node); n++)
+      {
+      // Format is "GE8PZT:BBS64 via GE8PZT qlty=20"
+      if (json_getText (&node, "call", &v, 9))
+         uprintf ("%s%.*s", Margin, v.len, v.ptr);
+
+      if (json_getText (&node, "alias", &v, 6))
+         uprintf (":%.*s", v.len, v.ptr);
+
+      if (json_getText (&node, "via", &v, 9))
+         uprintf (" via %.*s", v.len, v.ptr);
+
+      if (json_getText (&node, "qual", &v, 3))
+         uprintf (" qlty=%.*s", v.len, v.ptr);
+      }
+   }
+
+static int wrap (void)
+   {
+   uprintf ("%s    ", Margin);
+   return (8);
+   }
+
+/**********************************************************************/
+/* Purpose:    Decode and display an INP3 routing unicast
+ * Called by:  trace_netromRoutingInfo() only.
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    Loops through the "nodes" array, displaying details
+ *             of each route.
+ * Affects:    stdout only.
+ * Returns:    None
+ * Notes:      Each element is indexed in place, rather than copied.
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to index each node in place, and to
+ *             count parse errors, and to format from views of the
+ *             fields, and to decode the strings shown. */
+/**********************************************************************/
+
+static void trace_inp3 (const JSONOBJ *json)
+   {
+   JSTR           v;
+   const JFIELD   *nodes;
+   JSONOBJ        object;
+   int            n;
+
+   PROF_MARK (P_INP3);
+
+   if ((Cfg->traceFlags & TRACE_INP3) == 0)
+      {
+      uprintf (" INP3");
+      return;
+      }
+
+   uprintf ("%sINP3 Routing Unicast:", Margin);
+
+   if ((nodes = json_findArray (json, "nodes")) == NULL)
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [missing 'nodes' array]");
+      return;
+      }
+
+   for (n = 0; json_getElement (json, nodes, n, &object); n++)
+      {
+      int   cols = 0;
+
+      // Minimum format is "GB7BDH    hp=2   tt=3"
+
+      if (json_getText (&object, "call", &v, 9))
+         cols += uprintf ("%s%-9.*s", Margin, v.len, v.ptr);
+
+      if (json_getText (&object, "hops", &v, 2))
+         cols += uprintf ("  hp=%-2.*s", v.len, v.ptr);
+
+      if (json_getText (&object, "tt", &v, 5))
+         cols += uprintf ("  tt=%-5.*s", v.len, v.ptr);
+
+      // Optional fields
+      // "Alias=SWINDN 5128.75N 71582600.46E S/W=XRPi NODE PMS XRCHAT Ver=504k 25/10 06:20
+
+      if (json_getText (&object, "alias", &v, 6))
+         cols += uprintf ("  Alias=%-6.*s", v.len, v.ptr);
+
+      if (json_getText (&object, "latitude", &v, 20))
+         cols += uprintf (" %.*s", v.len, v.ptr);
+
+       if (json_getText (&object, "longitude", &v, 20))
+         cols += uprintf (" %.*s", v.len, v.ptr);
+
+      if (json_getText (&object, "software", &v, 20))
+         cols += uprintf (" S/W=%.*s", v.len, v.ptr);
+
+      // If could overflow 80-col line after this point
+
+      if (json_getText (&object, "version", &v, 10))
+         {
+         if (cols+2+v.len >= Cfg->displayWidth) cols = wrap ();
+         cols += uprintf (" v%.*s", v.len, v.ptr);
+         }
+
+      if (json_getText (&object, "isNode", &v, 5)
+      && json_strIs (&v, "true"))
+         {
+         if ((cols + 5) >= Cfg->displayWidth) cols = wrap ();
+         cols += uprintf (" NODE");
+         }
+
+      if (json_getText (&object, "isBBS", &v, 5)
+      && json_strIs (&v, "true"))
+         {
+         if ((cols + 4) >= Cfg->displayWidth) cols= wrap ();
+         cols += uprintf (" BBS");
+         }
+
+      if (json_getText (&object, "isPMS", &v, 5)
+      && json_strIs (&v, "true"))
+         {
+         if ((cols + 4) >= Cfg->displayWidth) cols= wrap ();
+         cols += uprintf (" PMS");
+         }
+
+      if (json_getText (&object, "isXRChat", &v, 5)
+      && json_strIs (&v, "true"))
+         {
+         if ((cols + 7) >= Cfg->displayWidth) cols = wrap ();
+         cols += uprintf (" XRCHAT");
+         }
+
+      if (json_getText (&object, "isRTChat", &v, 5)
+      && json_strIs (&v, "true"))
+         {
+         if ((cols + 7) >= Cfg->displayWidth) cols = wrap ();
+         cols += uprintf (" RTCHAT");
+         }
+
+      if (json_getText (&object, "isRMS", &v, 5)
+      && !json_strIs (&v, "true"))
+         {
+         if ((cols + 4) >= Cfg->displayWidth) cols = wrap ();
+         cols += uprintf (" RMS");
+         }
+
+      if (json_getText (&object, "isDXClUS", &v, 5)
+      && json_strIs (&v, "true"))
+         {
+         if ((cols + 7) >= Cfg->displayWidth) cols= wrap ();
+         cols += uprintf (" DXCLUS");
+         }
+
+      if (json_getText (&object, "timestamp", &v, 40))
+         {
+         // There are two typs of timestamps currently in use...
+         if (memchr (v.ptr, 'T', v.len))  // It's ISO-8601
+            {
+            // 2025-10-24T12:46:52Z
+            if ((cols + 21) >= Cfg->displayWidth) cols= wrap ();
+            cols += uprintf (" %.*s", v.len, v.ptr);
+            }
+
+         else  // It's Unix time
+            {
+            time_t   t = json_strLong (&v);
+
+            if (((unsigned)t) > 18000)
+               {
+               struct tm tim;
+
+               localtime_r (&t, &tim);
+               if ((cols + 12) >= Cfg->displayWidth) cols= wrap ();
+               cols += uprintf (" %02d/%02d %02d:%02d",
+                  tim.tm_mday,  tim.tm_mon+1,
+                  tim.tm_hour,  tim.tm_min);
+               }
+            }
+         }
+
+      if (json_getText (&object, "tzMins", &v, 8))
+         {
+         if (cols+3+v.len >= Cfg->displayWidth) cols = wrap ();
+         uprintf (" tz=%.*s", v.len, v.ptr);
+         }
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Decode and display ARP headers
+ * Called by:  process_json() for ptcl="ARP"
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Returns:    None
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to format from views of the fields, and to
+ *             decode the strings shown. */
+/**********************************************************************/
+
+static void trace_arp (const JSONOBJ *json)
+   {
+   JSTR  v;
+
+   PROF_MARK (P_ARP);
+
+   if ((Cfg->traceFlags & TRACE_ARP) == 0) return;
+
+   // Older software doesn't include these fields
+   if (!json_getText (json, "arpOp", &v, 79)) return;
+
+   uprintf ("%sARP %.*s", Margin, v.len, v.ptr);
+
+   if (json_getText (json, "arpHwType", &v, 79))
+      uprintf (" hwtype=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "arpHwLen", &v, 79))
+      uprintf (" hwlen=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "arpPtcl", &v, 79))
+      uprintf (" prot=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "arpSndAddr", &v, 79))
+      uprintf ("%ssnd=%.*s", Margin, v.len, v.ptr);
+
+   if (json_getText (json, "arpTgtAddr", &v, 79))
+      uprintf (" tgt=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "arpSndHw", &v, 79))
+      uprintf (" snd_hw=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "arpTgtHw", &v, 79))
+      uprintf (" tgt_hw=%.*s", v.len, v.ptr);
+   }
+
+/**********************************************************************/
+/* Purpose:    Decode and display IP headers
+ * Called by:  process_json() for ptcl="IP"
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    Traces the main IP header fields, but not the payload
+ * Affects:    stdout only
+ * Returns:    None
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to format from views of the fields, and to
+ *             decode the strings shown. */
+/**********************************************************************/
+
+static void trace_ip (const JSONOBJ *json)
+   {
+   JSTR     v, src, dst;
+
+   PROF_MARK (P_IP);
+
+   if ((Cfg->traceFlags & TRACE_IP) == 0) return;
+
+   // Older software doesn't include these fields
+   if (!json_getText (json, "ipFrom", &src, 15)
+   || !json_getText (json, "ipTo", &dst, 15))
+      return;
+
+   // IP: 44.136.16.50 > 44.136.16.52 iplen=28 ttl=127 id=ABA0 ptcl=1 ICMP
+   uprintf ("%sIP: %.*s > %.*s", Margin, src.len, src.ptr, dst.len,
+      dst.ptr);
+
+   if (json_getText (json, "ipLen", &v, 6))
+      uprintf (" iplen=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "ipTTL", &v, 3))
+      uprintf (" ttl=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "ipID", &v, 6))
+      uprintf (" id=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "ipPtcl", &v, 6))
+      uprintf (" ptcl=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "ipProto", &v, 8))
+      uprintf (" %.*s", v.len, v.ptr);
+   }
+
+// NetRom routing info types, as found in "type"
+#define  RT_NODES       1
+#define  RT_INP3        2
+
+static MNEMTABLE RoutingTypes =
+   {
+   0,
+      {
+      { "NODES",  RT_NODES,   trace_nodes },
+      { "INP3",   RT_INP3,    trace_inp3 },
+      { NULL }
+      }
+   };
+
+/**********************************************************************/
+/* Purpose:    Decode and display NetRom routing information frames
+ * Called by:  trace_netrom() only.
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    Checks the value of "type", calling the appropriate
+ *             function from the RoutingTypes table.
+ * Returns:    None
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to use the RoutingTypes table, and to count
+ *             parse errors, and to format from views of the fields,
+ *             and to decode the strings shown. */
+/**********************************************************************/
+
+static void trace_netromRoutingInfo (const JSONOBJ *json)
+   {
+   JSTR  type;
+   int   n;
+
+   PROF_MARK (P_ROUTEINFO);
+
+   if (!json_getText (json, "type", &type, 15))
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [missing 'type']");
+      return;
+      }
+
+   // Future types go in the RoutingTypes table
+   if ((n = mnem_find (&RoutingTypes, type.ptr, type.len)) >= 0)
+      RoutingTypes.row [n].trace (json);
+
+   else
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [unknown 'type' '%.*s'", type.len, type.ptr);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Trace a netrom routing poll
+ * Called by:  x
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    x
+ * Affects:    x
+ * Returns:    x
+ * Notes:      x
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   */
+/**********************************************************************/
+
+static void trace_netromRoutingPoll (const JSONOBJ *json)
+   {
+   PROF_MARK (P_ROUTEPOLL);
+
+   /// TODO: Populate me
+   }
+
+// NetRom L4 frame types, as found in "l4type"
+#define  L4_UNKNOWN     1
+#define  L4_PROTEXT     2
+#define  L4_IP          3
+#define  L4_NCMP        4
+#define  L4_NDP         5
+#define  L4_GNET        6
+#define  L4_NRRREQ      7
+#define  L4_NRRREPLY    8
+#define  L4_CONNREQ     9
+#define  L4_CONNREQX    10
+#define  L4_CONNACK     11
+#define  L4_CONNNAK     12
+#define  L4_DREQ        13
+#define  L4_DACK        14
+#define  L4_RSET        15
+#define  L4_INFO        16
+#define  L4_INFOACK     17
+
+static MNEMTABLE L4Types =
+   {
+   0,
+      {
+      { "unknown",      L4_UNKNOWN,    NULL },
+      { "PROT EXT",     L4_PROTEXT,    NULL },
+      { "IP",           L4_IP,         NULL },
+      { "NCMP",         L4_NCMP,       NULL },
+      { "NDP",          L4_NDP,        NULL },
+      { "GNET",         L4_GNET,       NULL },
+      { "NRR Request",  L4_NRRREQ,     NULL },
+      { "NRR Reply",    L4_NRRREPLY,   NULL },
+      { "CONN REQ",     L4_CONNREQ,    NULL },
+      { "CONN_REQX",    L4_CONNREQX,   NULL },
+      { "CONN ACK",     L4_CONNACK,    NULL },
+      { "CONN NAK",     L4_CONNNAK,    NULL },
+      { "DREQ",         L4_DREQ,       NULL },
+      { "DACK",         L4_DACK,       NULL },
+      { "RSET",         L4_RSET,       NULL },
+      { "INFO",         L4_INFO,       NULL },
+      { "INFO ACK",     L4_INFOACK,    NULL },
+      { NULL }
+      }
+   };
+
+/**********************************************************************/
+/* Purpose:    Decode and display NetRom layer 4 segments
+ * Called by:  trace_netromL3() only
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    For l4Type "PROT_EXT" this currently displays only the
+ *             protocol type (if known), else the protocol family and
+ *             protocol number (if protocol not known).
+ *             If l4Type is not "PROT_EXT", the frame is either a L4
+ *             transport frame, or a "Netrom Record Route" frame. Both
+ *             types are traced. For L4 transport, only the headers are
+ *             traced, the payloads are considered sensitive.
+ * Affects:    stdout only.
+ * Returns:    None
+ * Notes:      Tracing of NCMP, NDP, GNET etc could be added if required
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to switch on the L4Types code, and to count
+ *             parse errors, and to format from views of the fields,
+ *             and to decode the strings shown. */
+/**********************************************************************/
+
+static void trace_netromL4 (const JSONOBJ *json)
+   {
+   JSTR  l4type, v;
+   int   n, code;
+
+   PROF_MARK (P_L4);
+
+   if ((Cfg->traceFlags & TRACE_L4) == 0) return;
+
+   //   NetRom L4 Frame Type
+   if (!json_getText (json, "l4type", &l4type, 15))
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [missing l4type]\n");
+      return;
+      }
+
+   PROF_KEY (2, &l4type);
+
+   n = mnem_find (&L4Types, l4type.ptr, l4type.len);
+   code = (n >= 0) ? L4Types.row [n].code : 0;
+
+   switch (code)
+      {
+      case L4_UNKNOWN:
+         METRIC_INC (errors [M_ERR_FIELD]);
+         if (Cfg->traceFlags & TRACE_WARNINGS)
+            uprintf (" [unknown l4type]\n");
+         return;
+
+      case L4_PROTEXT:
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+         if (json_getText (json, "l4Family", &v, 80))
+            uprintf (" pf=%.*s", v.len, v.ptr);
+         if (json_getText (json, "l4Proto", &v, 80))
+            uprintf (" prot=%.*s", v.len, v.ptr);
+         return;
+
+      case L4_IP:
+      case L4_NCMP:
+      case L4_NDP:
+      case L4_GNET:
+         /// TODO: Decode these properly one day
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+         return;
+
+      case L4_NRRREQ:   // Netrom Record Route Request
+      case L4_NRRREPLY: // Netrom Record Route Reply
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+
+         if (json_getText (json, "nrrId", &v, 80))
+            uprintf (" id=%.*s", v.len, v.ptr);
+
+         if (json_getText (json, "nrrRoute", &v, 2047))
+            uprintf ("%sRoute: %.*s", Margin, v.len, v.ptr);
+         return;
+      }
+
+   if (json_getText (json, "toCct", &v, 8))
+      uprintf (" cct=%.*s", v.len, v.ptr);
+
+   switch (code)
+      {
+      case L4_CONNREQ:
+      case L4_CONNREQX:
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+
+         if (json_getText (json, "window", &v, 8))
+            uprintf (" w=%.*s", v.len, v.ptr);
+
+         if (json_getText (json, "srcUser", &v, 9))
+            uprintf ("\n          %.*s", v.len, v.ptr);
+         else return;
+
+         if (json_getText (json, "srcNode", &v, 9))
+            uprintf (" at %.*s", v.len, v.ptr);
+
+         if (json_getText (json, "service", &v, 8))
+            uprintf (" svc=%.*s", v.len, v.ptr);
+
+         if (json_getText (json, "l4t1", &v, 8))
+            uprintf (" t/o=%.*s", v.len, v.ptr);
+
+         if (json_getText (json, "bpqSpy", &v, 8))
+            uprintf (" bpqSpy=%.*s", v.len, v.ptr);
+
+         return;
+
+      case L4_CONNACK:
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+         if (json_getText (json, "window", &v, 8))
+            uprintf (" w=%.*s", v.len, v.ptr);
+         if (json_getText (json, "fromCct", &v, 8))
+            uprintf (" myCct=%.*s", v.len, v.ptr);
+         return; // ??
+
+      case L4_CONNNAK:
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+         return; // ??
+
+      case L4_DREQ:
+      case L4_DACK:
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+         return;
+
+      case L4_RSET:
+         uprintf (" <%.*s>", l4type.len, l4type.ptr);
+         if (json_getText (json, "fromCct", &v, 8))
+            uprintf (" myCct=%.*s", v.len, v.ptr);
+         return;
+
+      case L4_INFO:
+         uprintf (" <%.*s", l4type.len, l4type.ptr);
+
+         if (json_getText (json, "txSeq", &v, 8))
+            uprintf (" S%.*s", v.len, v.ptr);
+
+         if (json_getText (json, "rxSeq", &v, 8))
+            uprintf (" R%.*s", v.len, v.ptr);
+
+         uprintf (">");
+
+         if (json_getText (json, "paylen", &v, 8))
+            uprintf (" ilen=%.*s", v.len, v.ptr);
+
+         if (json_getText (json, "payload", &v, 2047))
+            uprintf (":%s%.*s", Margin, v.len, v.ptr);
+         break;
+
+      case L4_INFOACK:
+         uprintf (" <%.*s", l4type.len, l4type.ptr);
+
+         if (json_getText (json, "rxSeq", &v, 8))
+            uprintf (" R%.*s", v.len, v.ptr);
+
+         uprintf (">");
+         break;
+      }
+
+   if (json_getText (json, "chokeFlag", &v, 8))
+         uprintf (" <CHOKE>");
+
+   if (json_getText (json, "nakFlag", &v, 8))
+         uprintf (" <NAK>");
+
+   if (json_getText (json, "moreFlag", &v, 8))
+         uprintf (" <MORE>");
+
+   }
+
+/**********************************************************************/
+/* Purpose:    Trace L3RTT frames
+ * Called by:  trace_netromL3() if l3Dest is "L3RTT"
+ * Arguments:  Pointer to serialised JSON object.
+ * Notes:      L3RTT is a "retrofit" to NetRom. It includes an L4 header
+ *             which makes it look like an L4 INFO frame with circuit
+ *             number, send and receive sequence numbers all zero. But
+ *             it most definitely belongs in layer 3.
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to format from views of the fields, and to
+ *             decode the strings shown. */
+/**********************************************************************/
+
+static void trace_l3rtt (const JSONOBJ *json)
+   {
+   JSTR  v;
+
+   PROF_MARK (P_L3RTT);
+
+   /* "l4type" should be "INFO", "toCct", "txSeq" and "rxSeq" should all
+    * be 0, if you want to bother to check them
+    * */
+
+   if (json_getText (json, "paylen", &v, 8))
+         uprintf (" ilen=%.*s", v.len, v.ptr);
+
+   if ((Cfg->traceFlags & TRACE_L3RTT) == 0) return;
+
+   // Payload chan be up to 236 chara, so it will wrap untidily
+   /// TODO: parse the payload & present the fields in a neater form
+
+   if (json_getText (json, "payload", &v, 511))
+      uprintf (":%s%.*s", Margin, v.len, v.ptr);
+   }
+
+
+/**********************************************************************/
+/* Purpose:    Display the L3 routing header, then trace layer 4
+ * Called by:  trace_netrom() if l3Type is "netrom".
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    Displays the L3 source and dest calls, and TTL, then
+ *             traces layer 4.
+ * Affects:    stdout only
+ * Returns:    None
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to format from views of the fields, and to
+ *             decode the strings shown. */
+/**********************************************************************/
+
+static void trace_netromL3 (const JSONOBJ *json)
+   {
+   JSTR  v = { "", 0 };
+   bool  isL3RTT;
+
+   PROF_MARK (P_L3);
+
+   if (json_getText (json, "l3src", &v, 10))
+      uprintf ("%sNTRM: %.*s", Margin, v.len, v.ptr); // Layer 3 source
+
+   if (json_getText (json, "l3dst", &v, 10))
+      uprintf (" to %.*s", v.len, v.ptr);       // layer 3 dest
+
+   isL3RTT = json_strIs (&v, "L3RTT");
+
+   if (json_getText (json, "ttl", &v, 8))
+      uprintf (" ttl=%.*s", v.len, v.ptr);      // Layer 3 time to live
+
+   if (isL3RTT) trace_l3rtt (json);
+   else trace_netromL4 (json);
+   }
+
+// NetRom L3 frame types, as found in "l3Type"
+#define  L3_NETROM      1
+#define  L3_ROUTEINFO   2
+#define  L3_ROUTEPOLL   3
+
+static MNEMTABLE L3Types =
+   {
+   0,
+      {
+      { "NetRom",       L3_NETROM,     trace_netromL3 },
+      { "Routing info", L3_ROUTEINFO,  trace_netromRoutingInfo },
+      { "Routing poll", L3_ROUTEPOLL,  trace_netromRoutingPoll },
+      { NULL }
+      }
+   };
+
+/**********************************************************************/
+/* Purpose:    Trace NetRom (PID 0xCF) frames
+ * Called by:  process_json() only.
+ * Arguments:  Pointer to string containing serialised JSON object.
+ * Actions:    Calls the appropriate decoder from the L3Types table,
+ *             based on l3Type
+ * Affects:    stdout only
+ * Returns:    None
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to use the L3Types table, and to count parse
+ *             errors, and to format from views of the fields, and to
+ *             decode the strings shown. */
+/**********************************************************************/
+
+static void trace_netrom (const JSONOBJ *json)
+   {
+   JSTR  v;
+   int   n;
+
+   PROF_MARK (P_NETROM);
+
+   if ((Cfg->traceFlags & TRACE_NETROM) == 0) return;
+
+   if (!json_getText (json, "l3Type", &v, 79))
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [missing 'l3Type']");
+      return;
+      }
+
+   if ((n = mnem_find (&L3Types, v.ptr, v.len)) >= 0)
+      L3Types.row [n].trace (json);
+
+   else
+      {
+      METRIC_INC (errors [M_ERR_FIELD]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         uprintf (" [unknown 'l3type': '%.*s'", v.len, v.ptr);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Trace the payload of a "DATA" (PID 0xF0) frame
+ * Called by:  process_json(), from the Protocols table.
+ * Arguments:  Pointer to tokenized JSON object.
+ * Created:    14/10/2026, moved out of process_json()
+ * Modified:   14/10/2026 to format from views of the fields, and to
+ *             decode the strings shown. */
+/**********************************************************************/
+
+static void trace_data (const JSONOBJ *json)
+   {
+   JSTR  v;
+
+   PROF_MARK (P_DATA);
+
+   // The "info" field is present only for "UI" frames
+   if (json_getText (json, "info", &v, 1023))
+      uprintf (":%s%.*s", Margin, v.len, v.ptr);
+
+   // The "icrc" field is present only for "I" frames
+   else if (json_getText (json, "icrc", &v, 8))
+      uprintf (" CRC=%.*s", v.len, v.ptr);
+   }
+
+// L3 protocols, as found in "ptcl"
+#define  PT_NETROM      1
+#define  PT_DATA        2
+#define  PT_IP          3
+#define  PT_ARP         4
+
+static MNEMTABLE Protocols =
+   {
+   0,
+      {
+      { "NET/ROM",   PT_NETROM,  trace_netrom },
+      { "DATA",      PT_DATA,    trace_data },
+      { "IP",        PT_IP,      trace_ip },
+      { "ARP",       PT_ARP,     trace_arp },
+      /// TODO: Add flexnet
+      { NULL }
+      }
+   };
+
+// Hash all the mnemonic tables, at startup
+static void mnem_initAll (void)
+   {
+   mnem_init (&L2Types);
+   mnem_init (&L4Types);
+   mnem_init (&L3Types);
+   mnem_init (&RoutingTypes);
+   mnem_init (&Protocols);
+   }
+
+//######################################################################
+//                       CALLSIGN SET FUNCTIONS
+//######################################################################
+
+/**********************************************************************/
+/* Purpose:    Normalise a callsign for comparison
+ * Called by:  callset_add() and callset_match()
+ * Arguments:  Pointer to callsign, its length, pointer to a buffer of
+ *             at least CALL_MAXLEN chars to receive the result.
+ * Actions:    Copies the callsign in upper case, dropping any "-0"
+ *             SSID, since "G8PZT-0" and "G8PZT" are the same station.
+ * Returns:    Length of the result, or -1 if the callsign is too long
+ *             to be stored (so can't be in any set).
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int call_normalise (const char *call, int len, char *out)
+   {
+   int   i;
+
+   if (len >= CALL_MAXLEN) return (-1);
+
+   for (i = 0; i < len; i++)
+      out [i] = toupper ((unsigned char) call [i]);
+
+   if (len > 2 && out [len-2] == '-' && out [len-1] == '0') len -= 2;
+
+   out [len] = 0;
+   return (len);
+   }
+
+// Map a callsign character to a trie branch
+static int trie_index (int ch)
+   {
+   if (ch >= 'A' && ch <= 'Z') return (ch - 'A');
+   if (ch >= '0' && ch <= '9') return (26 + ch - '0');
+   if (ch == '-') return (36);
+   return (37);
+   }
+
+/**********************************************************************/
+/* Purpose:    Add an exact callsign to a set's hash table
+ * Called by:  callset_add() and itself when rehashing
+ * Arguments:  Pointer to set, normalised callsign.
+ * Actions:    Grows the table if it is more than half full, then
+ *             inserts the callsign unless it's already present.
+ * Returns:    None.  Exits if memory is exhausted.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void callset_insert (CALLSET *set, const char *call)
+   {
+   unsigned i;
+
+   if ((set->used + 1) * 2 > set->size)
+      {
+      char  (*old) [CALL_MAXLEN] = set->slot;
+      int   n = set->size;
+
+      set->size = n ? n * 2 : 64;
+      set->used = 0;
+
+      if ((set->slot = calloc (set->size, CALL_MAXLEN)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+
+      while (n-- > 0)
+         if (old [n][0]) callset_insert (set, old [n]);
+
+      free (old);
+      }
+
+   for (i = json_hash (call, strlen (call)) & (set->size-1);
+      set->slot [i][0]; i = (i+1) & (set->size-1))
+      {
+      if (strcmp (set->slot [i], call) == 0) return;  // Duplicate
+      }
+
+   strcpy (set->slot [i], call);
+   set->used++;
+   }
+
+/**********************************************************************/
+/* Purpose:    Add a callsign or wildcard to a callsign set
+ * Called by:  callset_load()
+ * Arguments:  Pointer to set, pointer to callsign, its length.
+ * Actions:    A callsign ending in '*' is a prefix wildcard, and is
+ *             added to the trie.  Anything else is an exact callsign,
+ *             added to the hash set.
+ * Returns:    0 if successful, else -1 if the callsign is too long.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int callset_add (CALLSET *set, const char *call, int len)
+   {
+   char     norm [CALL_MAXLEN];
+   TRIENODE **np;
+   int      i, wild = 0;
+
+   if (len > 0 && call [len-1] == '*')
+      {
+      wild = 1;
+      len--;
+      }
+
+   if (wild)   // Don't strip "-0" from a prefix
+      {
+      if (len >= CALL_MAXLEN) return (-1);
+      for (i = 0; i < len; i++)
+         norm [i] = toupper ((unsigned char) call [i]);
+      norm [len] = 0;
+      }
+
+   else if (call_normalise (call, len, norm) < 0) return (-1);
+
+   set->count++;
+
+   if (!wild)
+      {
+      callset_insert (set, norm);
+      return (0);
+      }
+
+   for (np = &set->trie, i = 0; ; i++)
+      {
+      if (*np == NULL && (*np = calloc (1, sizeof (TRIENODE))) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+
+      if (norm [i] == 0) break;
+
+      np = &(*np)->child [trie_index (norm [i])];
+      }
+
+   (*np)->wild = 1;
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Add a list of callsigns to a callsign set
+ * Called by:  main() for the "-a", "-f", "-r" and "-t" options.
+ * Arguments:  Pointer to set, option value.
+ * Actions:    The value is a list of callsigns and/or wildcards
+ *             separated by commas, e.g. "g8pzt*,KIDDER*,M1BFP-1".  If
+ *             it starts with '@' the rest is the name of a file
+ *             containing callsigns separated by commas, spaces or
+ *             newlines, where '#' starts a comment.  The option may be
+ *             given more than once, adding to the set each time.
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int callset_load (CALLSET *set, const char *value)
+   {
+   const char  *cp = value, *end;
+   char        *text = NULL;
+   int         rc = 0;
+
+   if (*value == '@')   // Read the list from a file
+      {
+      FILE  *fp;
+      long  size;
+      char  *sp;
+
+      if ((fp = fopen (value+1, "r")) == NULL)
+         {
+         printf ("Can't open callsign file '%s'\n", value+1);
+         return (-1);
+         }
+
+      fseek (fp, 0, SEEK_END);
+      size = ftell (fp);
+      rewind (fp);
+
+      if (size < 0 || (text = malloc (size + 1)) == NULL)
+         {
+         fclose (fp);
+         return (-1);
+         }
+
+      size = fread (text, 1, size, fp);
+      text [size] = 0;
+      fclose (fp);
+
+      // Blank out the comments
+      for (sp = text; (sp = strchr (sp, '#')) != NULL; )
+         while (*sp && *sp != '\n') *sp++ = ' ';
+
+      cp = text;
+      }
+
+   while (*cp)
+      {
+      while (*cp == ',' || isspace ((unsigned char) *cp)) cp++;
+
+      end = cp;
+      while (*end && *end != ',' && !isspace ((unsigned char) *end))
+         end++;
+
+      if (end > cp && callset_add (set, cp, end - cp) < 0)
+         {
+         printf ("Callsign too long: '%.*s'\n", (int) (end - cp), cp);
+         rc = -1;
+         break;
+         }
+
+      cp = end;
+      }
+
+   free (text);
+
+   if (*set->desc) strncat (set->desc, ",",
+      sizeof (set->desc) - strlen (set->desc) - 1);
+
+   strncat (set->desc, value,
+      sizeof (set->desc) - strlen (set->desc) - 1);
+
+   return (rc);
+   }
+
+/**********************************************************************/
+/* Purpose:    Test whether a callsign is in a callsign set
+ * Called by:  The filter tests.
+ * Arguments:  Pointer to set, callsign.
+ * Actions:    Looks the normalised callsign up in the hash set, then
+ *             walks the trie, matching if a wildcard ends anywhere on
+ *             the path.
+ * Returns:    1 if it matches, else 0.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int callset_match (const CALLSET *set, const char *call)
+   {
+   char           norm [CALL_MAXLEN];
+   const TRIENODE *np;
+   unsigned       i;
+   int            len = strlen (call);
+
+   if (set->used)
+      {
+      if (call_normalise (call, len, norm) < 0) return (0);
+
+      for (i = json_hash (norm, strlen (norm)) & (set->size-1);
+         set->slot [i][0]; i = (i+1) & (set->size-1))
+         {
+         if (strcmp (set->slot [i], norm) == 0) return (1);
+         }
+      }
+
+   for (np = set->trie, i = 0; np; i++)
+      {
+      if (np->wild) return (1);
+      if (call [i] == 0) break;
+      np = np->child [trie_index (toupper ((unsigned char) call [i]))];
+      }
+
+   return (0);
+   }
+
+// Free a trie node and everything below it
+static void trie_free (TRIENODE *np)
+   {
+   int   i;
+
+   if (np == NULL) return;
+
+   for (i = 0; i < TRIE_CHARS; i++) trie_free (np->child [i]);
+   free (np);
+   }
+
+/**********************************************************************/
+/* Purpose:    Free the memory of a callsign set
+ * Called by:  config_free()
+ * Arguments:  Pointer to set.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void callset_free (CALLSET *set)
+   {
+   free (set->slot);
+   trie_free (set->trie);
+   memset (set, 0, sizeof (CALLSET));
+   }
+
+/**********************************************************************/
+/* Purpose:    Load a comma separated list of mnemonics
+ * Called by:  main() for the "-P" and "-T" options.
+ * Arguments:  Pointer to list, option value, e.g. "I,UI".
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int strlist_load (STRLIST *list, const char *value)
+   {
+   const char  *cp = value, *end;
+
+   while (*cp)
+      {
+      while (*cp == ',') cp++;
+
+      for (end = cp; *end && *end != ','; end++);
+
+      if (end > cp)
+         {
+         if (list->count >= LIST_MAX || end - cp > 15)
+            {
+            printf ("Too many or too long: '%s'\n", value);
+            return (-1);
+            }
+         sprintf (list->item [list->count++], "%.*s",
+            (int) (end - cp), cp);
+         }
+
+      cp = end;
+      }
+
+   if (*list->desc) strncat (list->desc, ",",
+      sizeof (list->desc) - strlen (list->desc) - 1);
+
+   strncat (list->desc, value,
+      sizeof (list->desc) - strlen (list->desc) - 1);
+
+   return (0);
+   }
+
+//######################################################################
+//                     CALLSIGN INTERNING FUNCTIONS
+//######################################################################
+
+/* Every callsign seen (reporter, source, destination etc.) is entered,
+ * normalised, into a single process-wide table, and is thereafter
+ * referred to by a small integer ID, so that anything which needs to
+ * compare callsigns can compare integers instead of strings.  When a
+ * callsign is first entered, it is tested against each of the callsign
+ * filters and the results are kept in the entry as "match bits", so
+ * the filters cost one table lookup however many callsigns they hold.
+ * The bits are worked out again if the filters have been reloaded
+ * since, i.e. if the generation of the thread's snapshot has changed.
+ *
+ * The table has a fixed capacity, so memory stays bounded on the full
+ * network feed.  When it is full, the least recently used callsign is
+ * evicted using the "CLOCK" approximation of LRU.  Each ID includes a
+ * generation count, so an ID kept after its entry was evicted can be
+ * detected, instead of silently referring to a different callsign.
+ *
+ * The table is shared by the decode threads, so it is protected by a
+ * mutex, held only for the lookup itself.
+ * */
+#define  INTERN_BITS    12       // log2 of table capacity
+#define  INTERN_MAX     (1 << INTERN_BITS)  // Max callsigns held
+#define  INTERN_HASH    (INTERN_MAX * 2)    // Hash chain heads
+
+#define  CALLF_REPORT   0x01     // Matches the "-r" filter
+#define  CALLF_SRC      0x02     // Matches the "-f" filter
+#define  CALLF_DST      0x04     // Matches the "-t" filter
+#define  CALLF_ALL      0x08     // Matches the "-a" filter
+
+typedef struct
+   {
+   char     call [CALL_MAXLEN];  // Normalised callsign, "" if unused
+   unsigned hash;                // Hash of callsign
+   unsigned gen;                 // Incremented when entry is reused
+   int      next;                // Next in hash chain, index+1, 0=end
+   int      used;                // CLOCK reference bit
+   unsigned bits;                // CALLF_xxx filter match bits
+   unsigned cfg;                 // CONFIG generation of the bits
+   } CALLENTRY;
+
+static CALLENTRY        Intern [INTERN_MAX];
+static int              InternHead [INTERN_HASH];  // Index+1, 0=empty
+static int              InternCount = 0;  // Entries in use
+static int              InternHand = 0;   // CLOCK hand
+static unsigned long    InternEvictions = 0;
+static pthread_mutex_t  InternLock = PTHREAD_MUTEX_INITIALIZER;
+
+// An ID is (generation, index) plus 1, so that 0 means "no callsign"
+#define  INTERN_ID(i)   (((Intern [i].gen << INTERN_BITS) | (i)) + 1)
+#define  INTERN_IDX(id) (((id) - 1) & (INTERN_MAX - 1))
+
+/**********************************************************************/
+/* Purpose:    Work out which callsign filters a callsign matches
+ * Called by:  intern_call()
+ * Arguments:  Normalised callsign.
+ * Returns:    CALLF_xxx bits, for the thread's CONFIG snapshot.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static unsigned intern_filterBits (const char *call)
+   {
+   unsigned bits = 0;
+
+   if (Cfg->reportFilter.count
+   && callset_match (&Cfg->reportFilter, call))
+      bits |= CALLF_REPORT;
+
+   if (Cfg->srcFilter.count && callset_match (&Cfg->srcFilter, call))
+      bits |= CALLF_SRC;
+
+   if (Cfg->dstFilter.count && callset_match (&Cfg->dstFilter, call))
+      bits |= CALLF_DST;
+
+   if (Cfg->allFilter.count && callset_match (&Cfg->allFilter, call))
+      bits |= CALLF_ALL;
+
+   return (bits);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find an entry to (re)use for a new callsign
+ * Called by:  intern_call(), with InternLock held
+ * Actions:    Uses the next never-used entry if there is one.  If not,
+ *             sweeps the CLOCK hand round the table, clearing the
+ *             reference bits, until it finds an entry that hasn't been
+ *             used since the last sweep, and unlinks it from its hash
+ *             chain.
+ * Returns:    Index of the entry.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int intern_evict (void)
+   {
+   CALLENTRY   *e;
+   int         i, *lp;
+
+   if (InternCount < INTERN_MAX) return (InternCount++);
+
+   for (;;)
+      {
+      i = InternHand;
+      InternHand = (InternHand + 1) & (INTERN_MAX - 1);
+      e = &Intern [i];
+
+      if (e->used)
+         {
+         e->used = 0;
+         continue;
+         }
+
+      for (lp = &InternHead [e->hash & (INTERN_HASH - 1)];
+         *lp != i + 1; lp = &Intern [*lp - 1].next);
+
+      *lp = e->next;
+      e->gen++;
+      InternEvictions++;
+      return (i);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Look up a callsign, entering it if not already present
+ * Called by:  rec_call(), and anything else wanting a callsign ID
+ * Arguments:  Pointer to callsign (need not be terminated), its
+ *             length, pointer to receive the filter match bits (may be
+ *             NULL).
+ * Actions:    Normalises the callsign and looks it up.  If it is new,
+ *             works out its filter match bits and enters it, evicting
+ *             the least recently used entry if the table is full.  If
+ *             the bits are wanted and were worked out for a different
+ *             snapshot, works them out again.
+ * Returns:    The callsign's ID, or 0 if the callsign is too long.
+ * Notes:      An ID is only valid until the entry is evicted, which may
+ *             happen as soon as this returns, but it will never match
+ *             any other callsign's ID.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 for reloaded filters. */
+/**********************************************************************/
+
+static unsigned intern_call (const char *call, int len, unsigned *bits)
+   {
+   char        norm [CALL_MAXLEN];
+   CALLENTRY   *e;
+   unsigned    hash, id = 0;
+   int         i;
+
+   if (bits) *bits = 0;
+
+   if ((len = call_normalise (call, len, norm)) < 0) return (0);
+
+   hash = json_hash (norm, len);
+
+   pthread_mutex_lock (&InternLock);
+
+   for (i = InternHead [hash & (INTERN_HASH - 1)]; i; i = e->next)
+      {
+      e = &Intern [i - 1];
+
+      if (e->hash == hash && strcmp (e->call, norm) == 0)
+         {
+         e->used = 1;
+
+         if (bits && e->cfg != Cfg->gen)  // Filters were reloaded
+            {
+            e->bits = intern_filterBits (norm);
+            e->cfg = Cfg->gen;
+            }
+
+         if (bits) *bits = e->bits;
+         id = INTERN_ID (i - 1);
+         pthread_mutex_unlock (&InternLock);
+         return (id);
+         }
+      }
+
+   i = intern_evict ();
+   e = &Intern [i];
+   strcpy (e->call, norm);
+   e->hash = hash;
+   e->used = 1;
+   e->bits = intern_filterBits (norm);
+   e->cfg = Cfg->gen;
+   e->next = InternHead [hash & (INTERN_HASH - 1)];
+   InternHead [hash & (INTERN_HASH - 1)] = i + 1;
+
+   if (bits) *bits = e->bits;
+   id = INTERN_ID (i);
+
+   pthread_mutex_unlock (&InternLock);
+
+   return (id);
+   }
+
+/* Each callsign in a record is looked up at most once, the first time
+ * it is needed, and the result is kept in the record's TRACEREC so
+ * that the filters, and whatever comes after them, can share it.
+ * */
+#define  RC_REPORTER    0        // "reportFrom"
+#define  RC_SRCE        1        // "srce"
+#define  RC_DEST        2        // "dest"
+#define  RC_NUMCALLS    3
+
+typedef struct
+   {
+   int         looked [RC_NUMCALLS];   // 1 if looked up already
+   unsigned    id [RC_NUMCALLS];       // Callsign IDs, 0=none
+   unsigned    bits [RC_NUMCALLS];     // Their filter match bits
+   } TRACEREC;
+
+static const char *RecCallField [RC_NUMCALLS] =
+   { "reportFrom", "srce", "dest" };
+
+/**********************************************************************/
+/* Purpose:    Get the filter match bits of one of a record's callsigns
+ * Called by:  The filter tests
+ * Arguments:  Pointer to tokenized JSON object, pointer to its
+ *             TRACEREC, which callsign (RC_xxx).
+ * Actions:    On first use, finds the field and interns its value,
+ *             without copying it, and keeps the ID and match bits.
+ * Returns:    CALLF_xxx bits, or 0 if the field is missing.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static unsigned rec_call (const JSONOBJ *json, TRACEREC *rec, int which)
+   {
+   const JFIELD   *f;
+
+   if (!rec->looked [which])
+      {
+      rec->looked [which] = 1;
+
+      if ((f = json_findField (json, RecCallField [which])) != NULL)
+         rec->id [which] = intern_call (json->text + f->valOff,
+            f->valLen, &rec->bits [which]);
+      }
+
+   return (rec->bits [which]);
+   }
+
+//######################################################################
+//                          FILTER FUNCTIONS
+//######################################################################
+
+/* The filters given on the command line are compiled into a "plan",
+ * i.e. a list of tests ordered so that the one most likely to reject a
+ * frame is tried first.  Each test extracts only the field it needs,
+ * so most unwanted frames are thrown away after a single lookup,
+ * before any other fields are extracted or any formatting is done.
+ * The callsign tests use the match bits of the interned callsign, so
+ * they don't even copy the field.
+ * The number of frames rejected by each test is reported on exit, and
+ * in the metrics.
+ * */
+typedef struct filter
+   {
+   char           option [40];   // e.g. "-r G8PZT", for the report
+   int            (*match) (const JSONOBJ *json, TRACEREC *rec);
+   } FILTER;
+
+// Each test returns 1 if the frame is wanted, else 0
+
+static int filter_ui (const JSONOBJ *json, TRACEREC *rec)
+   {
+   int   n = mnem_field (json, "l2Type", &L2Types);
+
+   return (n < 0 || L2Types.row [n].code != L2_UI);
+   }
+
+static int filter_report (const JSONOBJ *json, TRACEREC *rec)
+   {
+   return ((rec_call (json, rec, RC_REPORTER) & CALLF_REPORT) != 0);
+   }
+
+static int filter_port (const JSONOBJ *json, TRACEREC *rec)
+   {
+   JSTR  v;
+
+   if (!json_getStr (json, "port", &v, 15)) return (0);
+   return (json_strLong (&v) == Cfg->portFilter);
+   }
+
+static int filter_type (const JSONOBJ *json, TRACEREC *rec)
+   {
+   int   n = mnem_field (json, "l2Type", &L2Types);
+
+   if (n >= 0) return ((Cfg->typeMask >> n) & 1);
+
+   return (n == -1 && Cfg->typeOther
+      && mnem_other (json, "l2Type", &Cfg->typeFilter));
+   }
+
+static int filter_src (const JSONOBJ *json, TRACEREC *rec)
+   {
+   return ((rec_call (json, rec, RC_SRCE) & CALLF_SRC) != 0);
+   }
+
+static int filter_dst (const JSONOBJ *json, TRACEREC *rec)
+   {
+   return ((rec_call (json, rec, RC_DEST) & CALLF_DST) != 0);
+   }
+
+static int filter_all (const JSONOBJ *json, TRACEREC *rec)
+   {
+   return ((rec_call (json, rec, RC_SRCE) & CALLF_ALL)
+      || (rec_call (json, rec, RC_DEST) & CALLF_ALL));
+   }
+
+static int filter_proto (const JSONOBJ *json, TRACEREC *rec)
+   {
+   int   n = mnem_field (json, "ptcl", &Protocols);
+
+   if (n >= 0) return ((Cfg->protoMask >> n) & 1);
+
+   return (n == -1 && Cfg->protoOther
+      && mnem_other (json, "ptcl", &Cfg->protoFilter));
+   }
+
+/**********************************************************************/
+/* Purpose:    Add a test to the filter plan
+ * Called by:  filter_build() only
+ * Arguments:  Pointer to snapshot, test function, option letter and
+ *             value for the report.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to build the plan of a CONFIG snapshot. */
+/**********************************************************************/
+
+static void filter_add (CONFIG *cfg,
+   int (*match) (const JSONOBJ *, TRACEREC *),
+   char option, const char *value)
+   {
+   FILTER   *fp = &cfg->plan [cfg->numFilters++];
+
+   fp->match = match;
+   snprintf (fp->option, sizeof (fp->option), "-%c %.36s", option,
+      value);
+   }
+
+/**********************************************************************/
+/* Purpose:    Compile the filter options into a filter plan
+ * Called by:  config_build()
+ * Arguments:  Pointer to the snapshot being built.
+ * Actions:    Adds a test for each enabled filter, most selective
+ *             first.  On the national feed a single reporting node or
+ *             callsign accounts for a tiny fraction of the frames,
+ *             whereas a port number or frame type matches many.  The
+ *             "-P" and "-T" lists are converted to bitmasks of rows in
+ *             the mnemonic tables, noting if they name any others.
+ * Affects:    The snapshot's plan, numFilters, protoMask, typeMask,
+ *             protoOther and typeOther
+ * Notes:      The mnemonic tables must be initialised first.  They are
+ *             only read, so a reload doesn't disturb the workers.
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to build the plan of a CONFIG snapshot, and
+ *             to leave the mnemonic tables as they are. */
+/**********************************************************************/
+
+static void filter_build (CONFIG *cfg)
+   {
+   char  tmp [16];
+
+   if ((cfg->plan = calloc (MAX_FILTERS, sizeof (FILTER))) == NULL)
+      {
+      fprintf (stderr, "Out of memory\n");
+      exit (-1);
+      }
+
+   cfg->numFilters = 0;
+
+   if (cfg->reportFilter.count)
+      filter_add (cfg, filter_report, 'r', cfg->reportFilter.desc);
+
+   if (cfg->srcFilter.count)
+      filter_add (cfg, filter_src, 'f', cfg->srcFilter.desc);
+
+   if (cfg->dstFilter.count)
+      filter_add (cfg, filter_dst, 't', cfg->dstFilter.desc);
+
+   if (cfg->allFilter.count)
+      filter_add (cfg, filter_all, 'a', cfg->allFilter.desc);
+
+   if (cfg->protoFilter.count)
+      {
+      cfg->protoMask = mnem_mask (&Protocols, &cfg->protoFilter,
+         &cfg->protoOther);
+      filter_add (cfg, filter_proto, 'P', cfg->protoFilter.desc);
+      }
+
+   if (cfg->typeFilter.count)
+      {
+      cfg->typeMask = mnem_mask (&L2Types, &cfg->typeFilter,
+         &cfg->typeOther);
+      filter_add (cfg, filter_type, 'T', cfg->typeFilter.desc);
+      }
+
+   if (cfg->portFilter)
+      {
+      sprintf (tmp, "%d", cfg->portFilter);
+      filter_add (cfg, filter_port, 'p', tmp);
+      }
+
+   if ((cfg->traceFlags & TRACE_UI) == 0)
+      filter_add (cfg, filter_ui, 'u', "");
+   }
+
+/**********************************************************************/
+/* Purpose:    Apply the filter plan to a frame
+ * Called by:  process_json()
+ * Arguments:  Pointer to tokenized JSON object, pointer to a cleared
+ *             TRACEREC for it, which collects the callsign lookups.
+ * Actions:    Runs each test in turn, stopping at the first one which
+ *             rejects the frame.
+ * Affects:    The thread's filter counters.
+ * Returns:    1 if the frame is wanted, else 0
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to count in the thread's METRICS block. */
+/**********************************************************************/
+
+static int filter_apply (const JSONOBJ *json, TRACEREC *rec)
+   {
+   int   i;
+
+   METRIC_INC (examined);
+
+   for (i = 0; i < Cfg->numFilters; i++)
+      {
+      if (Cfg->plan [i].match (json, rec) == 0)
+         {
+         METRIC_INC (rejects [i]);
+         return (0);
+         }
+      }
+
+   METRIC_INC (shown);
+
+   return (1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Report how many frames each filter rejected
+ * Called by:  main() on exit
+ * Actions:    If any filters are in use, prints the number of frames
+ *             examined and passed, and the rejects for each filter, in
+ *             the order they were applied.
+ * Affects:    stderr, so as not to pollute the trace output.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to add up the threads' counters. */
+/**********************************************************************/
+
+static void filter_report_counts (void)
+   {
+   METRICS  total;
+   int      i;
+
+   if (Cfg->numFilters == 0) return;
+
+   metric_sum (&total);
+
+   fprintf (stderr, "\nFrames examined: %llu, shown: %llu\n",
+      (unsigned long long) total.examined,
+      (unsigned long long) total.shown);
+
+   fprintf (stderr, "Callsigns held: %d, evicted: %lu\n",
+      InternCount, InternEvictions);
+
+   for (i = 0; i < Cfg->numFilters; i++)
+      fprintf (stderr, "   %-20s rejected %llu\n",
+         Cfg->plan [i].option, (unsigned long long) total.rejects [i]);
+   }
+
+//######################################################################
+//                      CONFIGURATION FUNCTIONS
+//######################################################################
+
+/* With "-e <file>", the filters and display options are taken from the
+ * command line plus the file, which holds more options written as they
+ * would be on the command line, e.g. "-r G8PZT* -T I,UI", with '#'
+ * starting a comment.  On SIGHUP, the input loop builds a new CONFIG
+ * snapshot from the command line and the file again, including the
+ * filter plan, and swaps it in with an atomic store.  Each thread
+ * loads the pointer once at the start of each record, and uses that
+ * snapshot for the whole record, so the decode path takes no locks and
+ * never sees a half-built snapshot.  If the file can't be read, or
+ * holds a bad option, the old snapshot is kept.
+ *
+ * A decode thread may still be using the old snapshot after a reload,
+ * and there is no cheap way of knowing when it has finished, so old
+ * snapshots are never freed.  They only hold the filters, and reloads
+ * are rare.  The plan is rebuilt on each reload, so the counts of
+ * frames rejected by each test start again from zero.
+ * */
+#define  CONFIG_MAXARGS 256      // Max words in a "-e" file
+
+static char Options [] = "34a:bcCd:e:ijklnqsuhHWB:E:f:F:G:I:J:L:m:M:N:"
+   "o:p:r:Q:R:S:t:P:T:V:w:O:X:Y:z:";
+
+#define  OPT_FROM       256      // Long options, after the chars
+#define  OPT_TO         257
+
+static struct option LongOptions [] =
+   {
+   { "from",   required_argument,   NULL,    OPT_FROM },
+   { "to",     required_argument,   NULL,    OPT_TO },
+   { NULL,     0,                   NULL,    0 }
+   };
+
+static char    ConfigFile [256] = "";  // "-e" file, "" if none
+static int     ConfigArgc = 0;         // The command line, for reloads
+static char    **ConfigArgv = NULL;
+static volatile sig_atomic_t Reload = 0;  // Set by SIGHUP
+
+/**********************************************************************/
+/* Purpose:    Get the current CONFIG snapshot
+ * Called by:  process_json() at the start of each record, and anything
+ *             else outside the input loop that needs the filters.
+ * Returns:    Pointer to the snapshot, which won't change or be freed.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static const CONFIG *config_get (void)
+   {
+   return (__atomic_load_n (&Config, __ATOMIC_ACQUIRE));
+   }
+
+/**********************************************************************/
+/* Purpose:    Apply a filter or display option to a snapshot
+ * Called by:  main() and config_parse()
+ * Arguments:  Pointer to snapshot being built, option letter and
+ *             value (if it takes one).
+ * Returns:    0 if successful, -1 if the value is bad (message already
+ *             printed), or 1 if it isn't a filter or display option.
+ * Created:    14/10/2026, from main()
+ * Modified:   */
+/**********************************************************************/
+
+static int config_option (CONFIG *cfg, int c, const char *arg)
+   {
+   switch (c)
+      {
+      case 'c':   cfg->traceFlags &= ~TRACE_COLOR;       break;
+      case 'C':   cfg->traceFlags |= TRACE_COLOR2FILE;   break;
+      case 'u':   cfg->traceFlags &= ~TRACE_UI;          break;
+      case 'i':   cfg->traceFlags &= ~TRACE_INP3;        break;
+      case 'n':   cfg->traceFlags &= ~TRACE_NODES;       break;
+      case '3':   cfg->traceFlags &= ~TRACE_NETROM;      break;
+      case '4':   cfg->traceFlags &= ~TRACE_L4;          break;
+      case 's':   cfg->traceFlags &= ~TRACE_STAMP;       break;
+      case 'k':   cfg->traceFlags &= ~TRACE_L3RTT;       break;
+      case 'l':   cfg->traceFlags &= ~TRACE_LBRK;        break;
+      case 'j':   cfg->traceFlags |= TRACE_JSON;         break;
+      case 'H':   cfg->traceFlags |= TRACE_HDRLIN;       break;
+      case 'q':   cfg->traceFlags |= TRACE_QUIET;        break;
+      case 'W':   cfg->traceFlags |= TRACE_WARNINGS;     break;
+
+      // Callsign filters may be lists, wildcards or "@file"
+      case 'a':   return (callset_load (&cfg->allFilter, arg));
+      case 'f':   return (callset_load (&cfg->srcFilter, arg));
+      case 't':   return (callset_load (&cfg->dstFilter, arg));
+      case 'r':   return (callset_load (&cfg->reportFilter, arg));
+      case 'T':   return (strlist_load (&cfg->typeFilter, arg));
+      case 'P':   return (strlist_load (&cfg->protoFilter, arg));
+
+      case 'p':   cfg->portFilter = atoi (arg);          break;
+      case 'w':   cfg->displayWidth = atoi (arg);        break;
+
+      default:    return (1);
+      }
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Apply the filter and display options of an argument list
+ * Called by:  config_file() and config_build()
+ * Arguments:  Pointer to snapshot being built, argument count and list
+ *             (the first is the program name), 1 to reject any other
+ *             options, or 0 to ignore them.
+ * Actions:    Runs getopt_long() over the list, with the same options
+ *             as the command line, passing each one to config_option().
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Notes:      Uses the getopt() state, so only the main thread may
+ *             call this, after the command line has been processed.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to take the long options. */
+/**********************************************************************/
+
+static int config_parse (CONFIG *cfg, int argc, char **argv, int strict)
+   {
+   int   c, n, rc = 0;
+
+   optind = 1;
+   opterr = strict;  // The command line's errors were shown already
+
+   while ((c = getopt_long (argc, argv, Options, LongOptions, NULL))
+      >= 0)
+      {
+      if ((n = config_option (cfg, c, optarg)) < 0) rc = -1;
+
+      else if (n > 0 && strict)
+         {
+         if (c >= OPT_FROM) fprintf (stderr, "Option --%s can't be "
+            "used in '%s'\n", LongOptions [c - OPT_FROM].name,
+            argv [0]);
+         else if (c != '?') fprintf (stderr, "Option -%c can't be used "
+            "in '%s'\n", c, argv [0]);
+         rc = -1;
+         }
+      }
+
+   if (strict && optind < argc)
+      {
+      fprintf (stderr, "Unexpected '%s' in '%s'\n", argv [optind],
+         argv [0]);
+      rc = -1;
+      }
+
+   opterr = 1;
+   return (rc);
+   }
+
+/**********************************************************************/
+/* Purpose:    Apply the options in a "-e" file
+ * Called by:  main() and config_build()
+ * Arguments:  Pointer to snapshot being built, file name.
+ * Actions:    Reads the file, blanks out the comments and splits it
+ *             into words at white space, then applies them as options.
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int config_file (CONFIG *cfg, const char *name)
+   {
+   char  *args [CONFIG_MAXARGS + 2], *text, *cp;
+   FILE  *fp;
+   long  size;
+   int   n = 0, rc;
+
+   if ((fp = fopen (name, "r")) == NULL)
+      {
+      fprintf (stderr, "Can't open options file '%s'\n", name);
+      return (-1);
+      }
+
+   fseek (fp, 0, SEEK_END);
+   size = ftell (fp);
+   rewind (fp);
+
+   if (size < 0 || (text = malloc (size + 1)) == NULL)
+      {
+      fclose (fp);
+      return (-1);
+      }
+
+   size = fread (text, 1, size, fp);
+   text [size] = 0;
+   fclose (fp);
+
+   for (cp = text; (cp = strchr (cp, '#')) != NULL; )
+      while (*cp && *cp != '\n') *cp++ = ' ';
+
+   args [n++] = (char *) name;   // getopt() starts at the second
+
+   for (cp = strtok (text, " \t\r\n"); cp && n <= CONFIG_MAXARGS;
+      cp = strtok (NULL, " \t\r\n")) args [n++] = cp;
+
+   args [n] = NULL;
+
+   if (cp)
+      {
+      fprintf (stderr, "Too many words in '%s'\n", name);
+      rc = -1;
+      }
+
+   else rc = config_parse (cfg, n, args, 1);
+
+   free (text);
+   return (rc);
+   }
+
+// Free a snapshot which was never put into use
+static void config_free (CONFIG *cfg)
+   {
+   callset_free (&cfg->reportFilter);
+   callset_free (&cfg->srcFilter);
+   callset_free (&cfg->dstFilter);
+   callset_free (&cfg->allFilter);
+   free (cfg->plan);
+   free (cfg);
+   }
+
+/**********************************************************************/
+/* Purpose:    Build a new snapshot and put it into use
+ * Called by:  The input loops, when SIGHUP has set "Reload".
+ * Actions:    Applies the filter and display options of the command
+ *             line, then those of the "-e" file, to a new snapshot,
+ *             and compiles its filter plan.  If all is well, clears the
+ *             filter reject counts, which belong to the old plan, and
+ *             swaps the new snapshot in.
+ * Affects:    Config, and the main thread's Cfg.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void config_build (void)
+   {
+   CONFIG   *cfg;
+   int      i, j;
+
+   Reload = 0;
+
+   if ((cfg = calloc (1, sizeof (CONFIG))) == NULL) return;
+
+   cfg->traceFlags = TRACE_DEFAULT;
+   cfg->displayWidth = DISPLAY_WIDTH;
+
+   if (config_parse (cfg, ConfigArgc, ConfigArgv, 0) < 0
+   || config_file (cfg, ConfigFile) < 0)
+      {
+      fprintf (stderr, "Keeping the old filters\n");
+      config_free (cfg);
+      return;
+      }
+
+   filter_build (cfg);
+   cfg->gen = Config->gen + 1;
+
+   for (i = 0; i < M_SLOTS; i++)
+      for (j = 0; j < MAX_FILTERS; j++)
+         __atomic_store_n (&MetricSlot [i].rejects [j], 0,
+            __ATOMIC_RELAXED);
+
+   __atomic_store_n (&Config, cfg, __ATOMIC_RELEASE);
+   Cfg = cfg;
+
+   fprintf (stderr, "Reloaded '%s', %d filter tests\n", ConfigFile,
+      cfg->numFilters);
+   }
+
+//######################################################################
+//                          TIME RANGE FUNCTIONS
+//######################################################################
+
+/* With "--from <time>" and/or "--to <time>", only the records whose
+ * "time" is within the range, from the first up to but not including
+ * the second, are decoded.  Records without a time are dropped.  A
+ * time may be given as seconds since 1970, as "YYYY-MM-DD HH:MM[:SS]"
+ * (or with a 'T' between), or as just "HH:MM[:SS]", all UTC, like the
+ * time stamps shown.  A time of day is on the day of the first record
+ * seen, and if the range ends before it starts, it ends the next day.
+ *
+ * The test is made on every record, whatever the input.  Besides that,
+ * a binary capture skips the blocks outside the range by their time
+ * ranges, and a replayed text file is read only from and to the places
+ * found in its time index (see tix_seek()), so the records before and
+ * after the range aren't even framed.
+ * */
+#define  RANGE_FROM     1        // Bits of RangeClock
+#define  RANGE_TO       2
+#define  RANGE_DAY      86400    // Seconds in a day
+
+static int     Ranged = 0;             // Set if "--from" or "--to"
+static long    RangeFrom = LONG_MIN;   // Start of the range
+static long    RangeTo = LONG_MAX;     // End of the range
+static int     RangeClock = 0;         // RANGE_xxx if a time of day
+static long    RangeDay = -1;          // Their day, -1 until known
+static const char *RangeDesc [2] = { "the start", "the end" };
+
+// Convert a date to days since 1/1/1970, after H. Hinnant
+static long range_days (int y, int m, int d)
+   {
+   long  era, yoe, doy, doe;
+
+   y -= (m <= 2);
+   era = y / 400;
+   yoe = y - era * 400;
+   doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+   return (era * 146097 + doe - 719468);
+   }
+
+/**********************************************************************/
+/* Purpose:    Parse the "--from" and "--to" options
+ * Called by:  main()
+ * Arguments:  Option value, 0 for "--from" or 1 for "--to".
+ * Actions:    Converts the time to seconds since 1970, or to seconds
+ *             since midnight, noting it in RangeClock, if it's only a
+ *             time of day.
+ * Affects:    RangeFrom or RangeTo, RangeClock, Ranged and RangeDesc
+ * Returns:    0 if successful, else -1
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int range_option (const char *value, int which)
+   {
+   int         y, mo, d, h, mi, sec = 0, n = 0;
+   long        t;
+   char        sep;
+   const char  *cp;
+   char        *end;
+
+   if (sscanf (value, "%d-%d-%d%c%d:%d%n", &y, &mo, &d, &sep, &h, &mi,
+      &n) == 6 && (sep == ' ' || sep == 'T') && mo >= 1 && mo <= 12
+   && d >= 1 && d <= 31)
+      {
+      t = range_days (y, mo, d) * RANGE_DAY;
+      }
+
+   else if (sscanf (value, "%d:%d%n", &h, &mi, &n) == 2)
+      {
+      t = 0;
+      RangeClock |= which ? RANGE_TO : RANGE_FROM;
+      }
+
+   else
+      {
+      // Seconds since 1970
+      t = strtol (value, &end, 10);
+      if (end == value || *end || t < 0) n = -1;
+      h = mi = 0;
+      }
+
+   cp = value + n;
+
+   if (n > 0 && *cp == ':')
+      {
+      sec = strtol (cp+1, &end, 10);
+      if (end == cp+1) n = -1;
+      cp = end;
+      }
+
+   if (n < 0 || (n > 0 && *cp) || h < 0 || h > 23 || mi < 0 || mi > 59
+   || sec < 0 || sec > 60)
+      {
+      printf ("Bad time '%s'\n", value);
+      return (-1);
+      }
+
+   t += h * 3600L + mi * 60 + sec;
+
+   if (which) RangeTo = t;
+   else RangeFrom = t;
+
+   RangeDesc [which] = value;
+   Ranged = 1;
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Get the time range
+ * Called by:  range_wanted(), cap_wanted() and tix_seek()
+ * Arguments:  Time of a record, for the day of a time of day, if it
+ *             isn't known yet, pointers to receive the start and end.
+ * Notes:      The first caller sets the day.  The decode threads may
+ *             race to be first, but only one can set it.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void range_get (long t, long *from, long *to)
+   {
+   long  day, unset = -1;
+
+   *from = RangeFrom;
+   *to = RangeTo;
+
+   if (RangeClock == 0) return;
+
+   if ((day = __atomic_load_n (&RangeDay, __ATOMIC_RELAXED)) < 0)
+      {
+      day = t - t % RANGE_DAY;
+
+      // If another thread got there first, "unset" is given its day
+      if (!__atomic_compare_exchange_n (&RangeDay, &unset, day, 0,
+         __ATOMIC_RELAXED, __ATOMIC_RELAXED)) day = unset;
+      }
+
+   if (RangeClock & RANGE_FROM) *from += day;
+   if (RangeClock & RANGE_TO) *to += day;
+
+   // Ending before it starts, so it must end the next day
+   if (RangeClock == (RANGE_FROM | RANGE_TO) && *to <= *from)
+      *to += RANGE_DAY;
+   }
+
+// Test whether a record is within the time range
+static int range_wanted (const JSONOBJ *json)
+   {
+   long  t = json_getLong (json, "time", -1), from, to;
+
+   if (t < 0) return (0);
+
+   range_get (t, &from, &to);
+
+   return (t >= from && t < to);
+   }
+
+//######################################################################
+//                    DUPLICATE SUPPRESSION FUNCTIONS
+//######################################################################
+
+/* On the national feed the same frame is often reported by several
+ * nodes, e.g. a NODES broadcast is heard by everyone in range of the
+ * sender.  With "-d <seconds>", only the first report of each frame is
+ * traced, and copies reported by other nodes within that many seconds
+ * are dropped before they are formatted.
+ *
+ * A frame's identity is a 64 bit hash of the fields which describe the
+ * frame itself, as opposed to how it was seen (reporter, port, time,
+ * direction).  NODES broadcasts and INP3 unicasts have no "info" or
+ * "icrc", but the routes in their "nodes" arrays tell one frame from
+ * the next, e.g. the parts of a broadcast too long for one frame, so
+ * the whole array is hashed, along with the sender's alias.  The
+ * hashes are kept, with the time and the reporter's ID, in a
+ * fixed-size open-addressed table, so memory use is constant.  An
+ * entry older than the window counts as empty.  If every slot within
+ * reach is in use, the oldest is overwritten, so at worst a duplicate
+ * is let through.
+ *
+ * A repeat from the same reporter is a genuine retransmission, and is
+ * traced as normal.
+ *
+ * With the decode pipeline, the check is made by the writer thread in
+ * input order, so that the same copy is kept whatever the number of
+ * threads.  So the table is only ever used by one thread at a time,
+ * and needs no lock.
+ * */
+#define  DEDUP_SLOTS    65536    // Default table size, power of 2
+#define  DEDUP_PROBES   8        // Max slots examined per lookup
+
+typedef struct
+   {
+   uint64_t hash;                // Frame identity, 0 = empty
+   long     time;                // Time it was last reported
+   unsigned reporter;            // Intern ID of the reporter
+   } DEDUPENT;
+
+static DEDUPENT      *DedupTable = NULL;
+static int           DedupSlots = DEDUP_SLOTS;
+static int           DedupWindow = 0;     // Seconds, 0 = disabled
+static unsigned long DedupDropped = 0;    // Duplicates dropped
+
+// The fields which identify a frame, whoever reported it
+static const char *DedupFields [] =
+   {
+   "srce", "dest", "l2Type", "cr", "pf", "rseq", "tseq", "pid",
+   "ilen", "icrc", "info", "l3src", "l3dst", "l4type", "toCct",
+   "txSeq", "rxSeq", "type", "fromAlias", "nodes", NULL
+   };
+
+/**********************************************************************/
+/* Purpose:    Parse the "-d" option
+ * Called by:  main()
+ * Arguments:  Option value, "<seconds>[:<slots>]"
+ * Affects:    DedupWindow and DedupSlots, which is rounded up to a
+ *             power of 2.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void dedup_option (const char *value)
+   {
+   const char  *cp;
+   int         n;
+
+   DedupWindow = atoi (value);
+
+   if ((cp = strchr (value, ':')) != NULL && (n = atoi (cp+1)) > 0)
+      {
+      for (DedupSlots = 64; DedupSlots < n && DedupSlots < (1 << 26);
+         DedupSlots *= 2);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Work out the identity of a frame
+ * Called by:  process_json()
+ * Arguments:  Pointer to tokenized JSON object.
+ * Actions:    Hashes the name and value of each of the DedupFields
+ *             that is present, straight from the tokens.  The white
+ *             space between the elements of an array is left out, in
+ *             case the reporters lay it out differently.
+ * Returns:    64 bit FNV-1a hash, never 0.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to hash the routes of NODES and INP3 frames,
+ *             and their sender's alias. */
+/**********************************************************************/
+
+static uint64_t dedup_hash (const JSONOBJ *json)
+   {
+   const JFIELD   *f;
+   const char     *cp;
+   uint64_t       h = 14695981039346656037ULL;
+   int            i, n, inString, escaped;
+
+   for (i = 0; DedupFields [i]; i++)
+      {
+      if ((f = json_findField (json, DedupFields [i])) == NULL)
+         continue;
+
+      h ^= i + 1;    // Which field, so "a","" isn't "","a"
+      h *= 1099511628211ULL;
+
+      inString = escaped = 0;
+
+      for (cp = json->text + f->valOff, n = f->valLen; n-- > 0; cp++)
+         {
+         if (f->type == JT_ARRAY)
+            {
+            if (escaped) escaped = 0;
+            else if (inString && *cp == '\\') escaped = 1;
+            else if (*cp == '"') inString = !inString;
+            else if (!inString && isspace ((unsigned char) *cp))
+               continue;
+            }
+
+         h ^= (unsigned char) *cp;
+         h *= 1099511628211ULL;
+         }
+      }
+
+   return (h ? h : 1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Check whether a frame is a duplicate, and remember it
+ * Called by:  process_json(), or pipe_writer() if multi-threaded.
+ * Arguments:  Frame identity, time it was reported, reporter's ID.
+ * Actions:    Looks for the identity in the DEDUP_PROBES slots from its
+ *             hash position.  If it is found within the window with a
+ *             different reporter, it's a duplicate.  Otherwise the
+ *             frame is remembered, in its old slot, the first free one,
+ *             or the oldest if none are free.
+ * Returns:    1 if the frame is a duplicate, else 0.
+ * Notes:      The times are the reporters' own stamps, so reporters
+ *             whose clocks differ by more than the window defeat it.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int dedup_check (uint64_t hash, long t, unsigned reporter)
+   {
+   DEDUPENT *e, *use = NULL, *oldest = NULL;
+   int      i;
+
+   for (i = 0; i < DEDUP_PROBES; i++)
+      {
+      e = &DedupTable [(hash + i) & (DedupSlots - 1)];
+
+      if (e->hash == 0 || labs (t - e->time) > DedupWindow)
+         {
+         if (use == NULL) use = e;     // Free, or expired
+         continue;
+         }
+
+      if (e->hash == hash)
+         {
+         if (e->reporter != reporter)
+            {
+            DedupDropped++;
+            return (1);
+            }
+
+         use = e;    // Retransmission, just refresh the entry
+         break;
+         }
+
+      if (oldest == NULL || e->time < oldest->time) oldest = e;
+      }
+
+   if (use == NULL) use = oldest;   // No free slots, so overwrite
+
+   use->hash = hash;
+   use->time = t;
+   use->reporter = reporter;
+
+   return (0);
+   }
+
+// Report the number of duplicates dropped, on exit
+static void dedup_report (void)
+   {
+   if (DedupWindow)
+      fprintf (stderr, "Duplicate frames dropped: %lu\n", DedupDropped);
+   }
+
+//######################################################################
+//                          STATISTICS FUNCTIONS
+//######################################################################
+
+/* With "-S <secs>" the traces aren't formatted at all.  Instead each
+ * frame which passes the filters is counted against its reporter and
+ * port, and a table of the counts is shown every <secs> seconds, and
+ * on exit.  The counters for each reporter and port are held in one
+ * small row, found by hashing the interned ID of the reporter and the
+ * port number, so counting a frame touches a single cache line or two
+ * besides the JSON itself.
+ *
+ * The table shows, for the period since the last one, the number of
+ * frames, the percentage on RF and sent, the total of the "ilen"
+ * fields, the counts of the commonest frame types, and the percentage
+ * of REJ and SREJ frames to I frames, as a measure of how lossy the
+ * link is.
+ *
+ * Statistics are counted by a single thread, so "-m" is ignored.
+ * */
+#define  STAT_MAX       4096     // Max reporter/port pairs
+#define  STAT_SLOTS     8192     // Power of 2, at least 2x STAT_MAX
+#define  STAT_TYPES     16       // Counters for L2Types codes 0-15
+
+typedef struct
+   {
+   unsigned    id;               // Intern ID of reporter
+   int         port;             // Port number
+   char        call [CALL_MAXLEN];  // Reporter callsign
+   unsigned    frames;           // Frames counted
+   unsigned    rf;               // Of which on RF
+   unsigned    sent;             // Of which sent
+   unsigned    type [STAT_TYPES];   // Frames by L2Types code, 0=other
+   uint64_t    bytes;            // Total of "ilen" fields
+   } STATROW;
+
+static int     StatSecs = -1;          // Table interval, -1 = off
+static time_t  StatLast;               // When the last table was shown
+static STATROW *StatRow = NULL;        // The rows
+static int     StatRows = 0;           // Number of rows in use
+static unsigned short StatSlot [STAT_SLOTS];  // Row index+1, 0=empty
+static unsigned long StatLost = 0;     // Frames with no room for a row
+
+/**********************************************************************/
+/* Purpose:    Find or add the row for a reporter and port
+ * Called by:  stat_count()
+ * Arguments:  Intern ID of reporter, port number, pointer to reporter
+ *             callsign (not null terminated), its length.
+ * Returns:    Pointer to row, or NULL if the table is full.
+ * Notes:      If a reporter is evicted from the intern table, and comes
+ *             back, it gets another ID and so another row.  Both have
+ *             the same callsign, so it makes no difference to the
+ *             table, except that it may appear twice in one period.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static STATROW *stat_row (unsigned id, int port, const char *call,
+   int len)
+   {
+   STATROW  *row;
+   unsigned i;
+
+   for (i = (id * 31 + port) & (STAT_SLOTS-1); StatSlot [i];
+      i = (i+1) & (STAT_SLOTS-1))
+      {
+      row = &StatRow [StatSlot [i] - 1];
+      if (row->id == id && row->port == port) return (row);
+      }
+
+   if (StatRows >= STAT_MAX) return (NULL);
+
+   row = &StatRow [StatRows++];
+   StatSlot [i] = StatRows;
+
+   row->id = id;
+   row->port = port;
+   if (len >= CALL_MAXLEN) len = CALL_MAXLEN - 1;
+   memcpy (row->call, call, len);
+   row->call [len] = 0;
+
+   return (row);
+   }
+
+// Sort rows by the number of frames, busiest first
+static int stat_compare (const void *a, const void *b)
+   {
+   const STATROW  *ra = *(const STATROW **) a;
+   const STATROW  *rb = *(const STATROW **) b;
+
+   if (ra->frames != rb->frames)
+      return (ra->frames < rb->frames ? 1 : -1);
+
+   return (strcmp (ra->call, rb->call));
+   }
+
+/**********************************************************************/
+/* Purpose:    Show the statistics table, and clear the counters
+ * Called by:  stat_count() every StatSecs seconds, and main() on exit
+ * Arguments:  Time now
+ * Actions:    Lists each reporter and port which has had frames since
+ *             the last table, busiest first.
+ * Affects:    StatRow and StatLast
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void stat_print (time_t now)
+   {
+   STATROW     **list, *row;
+   unsigned    frames = 0, rejects;
+   char        stamp [16], rate [8];
+   int         i, n;
+
+   if ((list = malloc ((StatRows + 1) * sizeof (STATROW *))) == NULL)
+      return;
+
+   for (i = n = 0; i < StatRows; i++)
+      {
+      if (StatRow [i].frames == 0) continue;
+      list [n++] = &StatRow [i];
+      frames += StatRow [i].frames;
+      }
+
+   qsort (list, n, sizeof (STATROW *), stat_compare);
+
+   strftime (stamp, 16, "%H:%M:%S", localtime (&now));
+   uprintf ("%s  %u frames in %ld secs\n", stamp, frames,
+      (long) (now - StatLast));
+
+   uprintf ("Reporter  Port Frames RF%% Tx%%     Bytes     I    UI"
+      "    RR   REJ  SREJ  FRMR  Rej%%\n");
+
+   for (i = 0; i < n; i++)
+      {
+      row = list [i];
+      rejects = row->type [L2_REJ] + row->type [L2_SREJ];
+
+      if (row->type [L2_I])
+         sprintf (rate, "%5.1f", 100.0 * rejects / row->type [L2_I]);
+      else strcpy (rate, "    -");
+
+      uprintf ("%-9s %4d %6u %3u %3u %9llu %5u %5u %5u %5u %5u %5u"
+         " %s\n", row->call, row->port, row->frames,
+         row->rf * 100 / row->frames, row->sent * 100 / row->frames,
+         (unsigned long long) row->bytes, row->type [L2_I],
+         row->type [L2_UI], row->type [L2_RR], row->type [L2_REJ],
+         row->type [L2_SREJ], row->type [L2_FRMR], rate);
+      }
+
+   if (StatLost)
+      uprintf ("%lu frames not counted, too many reporters\n",
+         StatLost);
+
+   uprintf ("\n");
+   out_endRecord ();
+
+   // Clear the counters, but keep the rows
+   for (i = 0; i < StatRows; i++)
+      {
+      row = &StatRow [i];
+      memset (&row->frames, 0,
+         sizeof (STATROW) - offsetof (STATROW, frames));
+      }
+
+   StatLost = 0;
+   StatLast = now;
+   free (list);
+   }
+
+/**********************************************************************/
+/* Purpose:    Count a frame in the statistics
+ * Called by:  process_json(), instead of tracing the frame
+ * Arguments:  Pointer to tokenized JSON object, pointer to its TRACEREC
+ * Actions:    Updates the counters for the reporter and port, and
+ *             shows the table if it's due.
+ * Affects:    StatRow and StatLost
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to read numbers without going past the
+ *             field. */
+/**********************************************************************/
+
+static void stat_count (const JSONOBJ *json, TRACEREC *rec)
+   {
+   const JFIELD   *r;
+   const char     *text = json->text;
+   STATROW        *row;
+   time_t         now = time (NULL);
+   int            n;
+
+   if ((r = json_findField (json, "reportFrom")) != NULL)
+      {
+      rec_call (json, rec, RC_REPORTER);
+
+      n = json_getLong (json, "port", 0);
+
+      row = stat_row (rec->id [RC_REPORTER], n, text + r->valOff,
+         r->valLen);
+      }
+
+   else row = NULL;
+
+   if (row == NULL) StatLost++;
+
+   else
+      {
+      row->frames++;
+
+      n = mnem_field (json, "l2Type", &L2Types);
+      n = n >= 0 ? L2Types.row [n].code : 0;
+      row->type [n < STAT_TYPES ? n : 0]++;
+
+      if (json_getChar (json, "isRF") == 't') row->rf++;
+      if (json_getChar (json, "dirn") == 's') row->sent++;
+
+      row->bytes += json_getLong (json, "ilen", 0);
+      }
+
+   if (StatSecs > 0 && now - StatLast >= StatSecs) stat_print (now);
+   }
+
+//######################################################################
+//                          ROUTE TABLE FUNCTIONS
+//######################################################################
+
+/* With "-N <secs>" the traces are replaced by a table of the NetRom
+ * routes in use across the network, rebuilt from the NODES broadcasts
+ * and INP3 unicasts as they arrive.  A route is identified by its
+ * destination and the neighbour which advertised it, i.e. the "srce"
+ * of the frame, and holds the latest quality and "via" from NODES, the
+ * hop count and trip time from INP3, and when it was last heard.
+ *
+ * NODES floods arrive in bursts, so the routes are kept in a fixed
+ * size open-addressed table, like the duplicate table, and each one
+ * is updated in place with a few probes.  If every slot within reach
+ * is in use, the route heard longest ago is overwritten.
+ *
+ * The table is shown every <secs> seconds, when SIGUSR1 is received,
+ * and on exit.  Routes are tracked by a single thread, so "-m" is
+ * ignored.
+ * */
+#define  ROUTE_SLOTS    65536    // Default table size, power of 2
+#define  ROUTE_PROBES   8        // Max slots examined per lookup
+
+typedef struct
+   {
+   uint64_t    hash;             // Destination and neighbour, 0=empty
+   char        dest [CALL_MAXLEN];  // Destination callsign
+   char        neighbour [CALL_MAXLEN];   // Who advertised it
+   char        via [CALL_MAXLEN];   // Neighbour's neighbour, from NODES
+   char        alias [8];        // Destination alias, if known
+   int         qual;             // NODES quality, -1 if not known
+   int         hops;             // INP3 hop count, -1 if not known
+   int         tt;               // INP3 trip time, -1 if not known
+   long        heard;            // Time last advertised
+   } ROUTE;
+
+static ROUTE   *RouteTable = NULL;
+static int     RouteSlots = ROUTE_SLOTS;
+static int     RouteSecs = -1;         // Table interval, -1 = off
+static int     RouteCount = 0;         // Slots in use
+static long    RouteLatest = 0;        // Newest report time seen
+static time_t  RouteLast;              // When the last table was shown
+static unsigned long RouteLost = 0;    // Routes overwritten
+static volatile sig_atomic_t RouteQuery = 0;  // Set by SIGUSR1
+
+/**********************************************************************/
+/* Purpose:    Parse the "-N" option
+ * Called by:  main()
+ * Arguments:  Option value, "<seconds>[:<slots>]"
+ * Affects:    RouteSecs and RouteSlots, which is rounded up to a
+ *             power of 2.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void route_option (const char *value)
+   {
+   const char  *cp;
+   int         n;
+
+   RouteSecs = atoi (value);
+
+   if ((cp = strchr (value, ':')) != NULL && (n = atoi (cp+1)) > 0)
+      {
+      for (RouteSlots = 64; RouteSlots < n && RouteSlots < (1 << 24);
+         RouteSlots *= 2);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the route to a destination via a neighbour
+ * Called by:  route_count()
+ * Arguments:  Normalised destination and neighbour callsigns.
+ * Actions:    Looks for the route in the ROUTE_PROBES slots from its
+ *             hash position.  If it isn't there, it is added, in the
+ *             first free slot or in place of the route heard longest
+ *             ago.
+ * Returns:    Pointer to the route.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static ROUTE *route_find (const char *dest, const char *neighbour)
+   {
+   ROUTE       *r, *oldest = NULL;
+   const char  *cp;
+   uint64_t    h = 14695981039346656037ULL;
+   int         i;
+
+   for (cp = dest; *cp; cp++)
+      {
+      h ^= (unsigned char) *cp;
+      h *= 1099511628211ULL;
+      }
+
+   h ^= '>';   // So "AB","C" isn't "A","BC"
+   h *= 1099511628211ULL;
+
+   for (cp = neighbour; *cp; cp++)
+      {
+      h ^= (unsigned char) *cp;
+      h *= 1099511628211ULL;
+      }
+
+   if (h == 0) h = 1;
+
+   for (i = 0; i < ROUTE_PROBES; i++)
+      {
+      r = &RouteTable [(h + i) & (RouteSlots - 1)];
+
+      if (r->hash == 0)
+         {
+         RouteCount++;
+         break;
+         }
+
+      if (r->hash == h && strcmp (r->dest, dest) == 0
+      && strcmp (r->neighbour, neighbour) == 0)
+         return (r);
+
+      if (oldest == NULL || r->heard < oldest->heard) oldest = r;
+      }
+
+   if (i == ROUTE_PROBES)  // No free slots, so overwrite
+      {
+      r = oldest;
+      RouteLost++;
+      }
+
+   memset (r, 0, sizeof (ROUTE));
+   r->hash = h;
+   strcpy (r->dest, dest);
+   strcpy (r->neighbour, neighbour);
+   r->qual = r->hops = r->tt = -1;
+
+   return (r);
+   }
+
+// Sort routes by destination, then best first
+static int route_compare (const void *a, const void *b)
+   {
+   const ROUTE *ra = *(const ROUTE **) a;
+   const ROUTE *rb = *(const ROUTE **) b;
+   int         n;
+
+   if ((n = strcmp (ra->dest, rb->dest)) != 0) return (n);
+   if (ra->qual != rb->qual) return (ra->qual < rb->qual ? 1 : -1);
+   if (ra->hops != rb->hops) return (ra->hops > rb->hops ? 1 : -1);
+
+   return (strcmp (ra->neighbour, rb->neighbour));
+   }
+
+/**********************************************************************/
+/* Purpose:    Show the route table
+ * Called by:  route_count() when it's due or asked for, and main() on
+ *             exit.
+ * Actions:    Lists the routes by destination, best first, with how
+ *             long ago each was last advertised.
+ * Notes:      The ages are relative to the newest report, rather than
+ *             the clock, so that they make sense for a replayed file.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void route_print (time_t now)
+   {
+   ROUTE    **list;
+   char     stamp [16], qual [12], hops [12], tt [12];
+   int      i, n, dests;
+
+   if ((list = malloc ((RouteCount + 1) * sizeof (ROUTE *))) == NULL)
+      return;
+
+   for (i = n = 0; i < RouteSlots && n < RouteCount; i++)
+      if (RouteTable [i].hash) list [n++] = &RouteTable [i];
+
+   qsort (list, n, sizeof (ROUTE *), route_compare);
+
+   for (i = dests = 0; i < n; i++)
+      if (i == 0 || strcmp (list [i]->dest, list [i-1]->dest)) dests++;
+
+   strftime (stamp, 16, "%H:%M:%S", localtime (&now));
+   uprintf ("%s  %d routes to %d destinations\n", stamp, n, dests);
+
+   uprintf ("Dest      Alias  Neighbour Via       Qual Hops    TT"
+      "      Age\n");
+
+   for (i = 0; i < n; i++)
+      {
+      ROUTE *r = list [i];
+
+      if (r->qual >= 0) sprintf (qual, "%d", r->qual);
+      else strcpy (qual, "-");
+
+      if (r->hops >= 0) sprintf (hops, "%d", r->hops);
+      else strcpy (hops, "-");
+
+      if (r->tt >= 0) sprintf (tt, "%d", r->tt);
+      else strcpy (tt, "-");
+
+      uprintf ("%-9s %-6s %-9s %-9s %4s %4s %5s %8ld\n",
+         i && strcmp (r->dest, list [i-1]->dest) == 0 ? "" : r->dest,
+         r->alias, r->neighbour, r->via, qual, hops, tt,
+         RouteLatest - r->heard);
+      }
+
+   if (RouteLost)
+      uprintf ("%lu routes overwritten, table full\n", RouteLost);
+
+   uprintf ("\n");
+   out_endRecord ();
+
+   RouteLast = now;
+   RouteQuery = 0;
+   free (list);
+   }
+
+/**********************************************************************/
+/* Purpose:    Update the route table from a routing frame
+ * Called by:  process_json(), instead of tracing the frame
+ * Arguments:  Pointer to tokenized JSON object
+ * Actions:    If the frame is a NODES broadcast or INP3 unicast,
+ *             updates the route to each destination in its "nodes"
+ *             array via the neighbour which sent it, then shows the
+ *             table if it's due or has been asked for.
+ * Affects:    RouteTable
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to read numbers without going past the
+ *             field. */
+/**********************************************************************/
+
+static void route_count (const JSONOBJ *json)
+   {
+   const JFIELD   *f, *nodes;
+   const char     *text;
+   char           neighbour [CALL_MAXLEN], dest [CALL_MAXLEN];
+   JSONOBJ        node;
+   ROUTE          *r;
+   time_t         now = time (NULL);
+   long           t;
+   int            type, n;
+
+   n = mnem_field (json, "l3Type", &L3Types);
+
+   if (n >= 0 && L3Types.row [n].code == L3_ROUTEINFO
+   && (n = mnem_field (json, "type", &RoutingTypes)) >= 0
+   && (nodes = json_findArray (json, "nodes")) != NULL
+   && (f = json_findField (json, "srce")) != NULL
+   && call_normalise (json->text + f->valOff, f->valLen, neighbour) > 0)
+      {
+      type = RoutingTypes.row [n].code;
+
+      t = json_getLong (json, "time", now);
+
+      if (t > RouteLatest) RouteLatest = t;
+
+      for (n = 0; json_getElement (json, nodes, n, &node); n++)
+         {
+         text = node.text;
+
+         if ((f = json_findField (&node, "call")) == NULL
+         || call_normalise (text + f->valOff, f->valLen, dest) <= 0)
+            continue;
+
+         r = route_find (dest, neighbour);
+
+         // Reports may be out of order when inputs are merged
+         if (t < r->heard) continue;
+         r->heard = t;
+
+         if ((f = json_findField (&node, "alias")) != NULL
+         && f->valLen < (int) sizeof (r->alias))
+            {
+            memcpy (r->alias, text + f->valOff, f->valLen);
+            r->alias [f->valLen] = 0;
+            }
+
+         if (type == RT_NODES)
+            {
+            r->qual = json_getLong (&node, "qual", r->qual);
+
+            if ((f = json_findField (&node, "via")) == NULL
+            || call_normalise (text + f->valOff, f->valLen, r->via) < 0)
+               *r->via = 0;
+            }
+
+         else if (type == RT_INP3)
+            {
+            r->hops = json_getLong (&node, "hops", r->hops);
+            r->tt = json_getLong (&node, "tt", r->tt);
+            }
+         }
+      }
+
+   if (RouteQuery || (RouteSecs > 0 && now - RouteLast >= RouteSecs))
+      route_print (now);
+   }
+
+//######################################################################
+//                       CIRCUIT TRACKING FUNCTIONS
+//######################################################################
+
+/* With "-V <timeout>" the traces are replaced by a summary line for
+ * each NetRom L4 circuit, when it closes.  The frames of a circuit are
+ * paired up by the circuit number they carry and the node it belongs
+ * to: a CONN REQ carries the originator's circuit ("toCct" at
+ * "l3src"), a CONN ACK adds the answerer's ("fromCct" at "l3src"),
+ * and every other frame carries the circuit of the node it is sent
+ * to ("toCct" at "l3dst").  So each circuit is found from either end
+ * by hashing (node, circuit number).
+ *
+ * For each direction the tracker counts the frames, the INFO frames
+ * and the "paylen" bytes they carry, and the retransmissions, which
+ * are INFO frames whose "txSeq" is behind the next one expected.  One
+ * INFO frame at a time is timed, until a frame from the far end acks
+ * it with its "rxSeq", which gives the ack turnaround.  CHOKE and NAK
+ * flags are counted for both directions together.
+ *
+ * The frames of a circuit can be reported by every node along its
+ * route, and by each twice, received on one port and sent on another.
+ * So a circuit is only followed on the reporter and port which saw
+ * its first frame, and copies reported elsewhere are ignored.
+ *
+ * Circuits are allocated from slabs of CCT_SLAB, which are never
+ * freed but recycled through a free list, up to CCT_MAX circuits.
+ * They are also kept in order of activity, so that the sweeper can
+ * close those idle for longer than <timeout> by looking only at the
+ * oldest.  If the pool is exhausted, the oldest circuit is closed
+ * early to make room.  The timeout is measured from the newest report
+ * time, so it works for replayed files.  Circuits are tracked by a
+ * single thread, so "-m" is ignored.
+ * */
+#define  CCT_SLAB       256      // Circuits allocated at a time
+#define  CCT_MAX        65536    // Max circuits held at once
+#define  CCT_HASH       32768    // Hash chain heads, power of 2
+#define  CCT_TIMEOUT    900      // Default idle timeout, secs
+
+#define  CCT_OPENING    0        // Circuit states
+#define  CCT_OPEN       1
+#define  CCT_CLOSING    2
+
+typedef struct
+   {
+   unsigned    frames;           // Frames sent by this end
+   unsigned    info;             // Of which INFO
+   unsigned    retx;             // INFO frames sent again
+   uint64_t    bytes;            // Total of their "paylen" fields
+   int         nextSeq;          // Next "txSeq" expected, -1 = none
+   int         timedSeq;         // "txSeq" being timed, -1 = none
+   long        timedAt;          // When it was sent
+   } CCTDIR;
+
+typedef struct
+   {
+   char        node [2][CALL_MAXLEN];  // Originating and answering node
+   int         cct [2];          // Their circuit numbers, -1 = unknown
+   unsigned    hash [2];         // Hashes of (node, circuit number)
+   int         next [2];         // Hash chains, link+1, 0 = end
+   int         older, newer;     // Activity list, index+1, 0 = end
+   char        user [CALL_MAXLEN];  // "srcUser" of CONN REQ
+   char        reporter [CALL_MAXLEN];   // Circuit followed on this
+   int         port;             // reporter and port only
+   int         state;            // CCT_xxx
+   long        opened;           // Time of first frame
+   long        connected;        // Time of CONN ACK, 0 = none
+   long        last;             // Time of latest frame
+   CCTDIR      dir [2];          // Frames sent by each end
+   unsigned    choke, nak;       // Frames with these flags
+   unsigned    acks;             // Ack turnarounds measured
+   long        ackTotal, ackMax; // Their total and maximum, secs
+   } CIRCUIT;
+
+// A link names one end of a circuit, as (index << 1 | end) + 1
+#define  CCT(i)            (&CctSlab [(i) / CCT_SLAB][(i) % CCT_SLAB])
+#define  CCT_LINK(i,end)   ((((i) << 1) | (end)) + 1)
+
+static CIRCUIT *CctSlab [CCT_MAX / CCT_SLAB];
+static int     CctSlabs = 0;           // Slabs allocated
+static int     CctHead [CCT_HASH];     // Chain heads, link+1, 0 = empty
+static int     CctFree = 0;            // Free list, index+1, 0 = empty
+static int     CctOldest = 0;          // Activity list, index+1
+static int     CctNewest = 0;
+static int     CctTimeout = -1;        // Idle timeout, -1 = off
+static long    CctLatest = 0;          // Newest report time seen
+static unsigned long CctEvicted = 0;   // Closed early, pool exhausted
+
+/* These get the fields of a record for the circuit and link trackers,
+ * straight from the tokens.
+ * */
+// Copy and normalise a callsign field, returning its length or -1
+static int track_call (const JSONOBJ *json, const char *name, char *out)
+   {
+   const JFIELD   *f;
+
+   if ((f = json_findField (json, name)) == NULL) return (-1);
+   return (call_normalise (json->text + f->valOff, f->valLen, out));
+   }
+
+// Get a numeric field, or -1 if it is missing
+static int track_number (const JSONOBJ *json, const char *name)
+   {
+   return (json_getLong (json, name, -1));
+   }
+
+// Test a boolean flag field
+static int track_flag (const JSONOBJ *json, const char *name)
+   {
+   return (json_getChar (json, name) == 't');
+   }
+
+// Get the report time, which may have a fraction, or else the clock
+static double track_time (const JSONOBJ *json)
+   {
+   char  tmp [32];
+
+   if (json_getValue (json, "time", tmp, sizeof (tmp)) == NULL)
+      return (time (NULL));
+   return (atof (tmp));
+   }
+
+// Hash a node callsign and circuit number
+static unsigned cct_hash (const char *node, int cct)
+   {
+   return (json_hash (node, strlen (node)) ^ (cct * 2654435761u));
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the circuit with a given number at a given node
+ * Called by:  cct_count()
+ * Arguments:  Normalised node callsign, circuit number
+ * Returns:    Link to that end of the circuit, or 0 if not found.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int cct_find (const char *node, int cct)
+   {
+   CIRCUIT  *c;
+   unsigned hash = cct_hash (node, cct);
+   int      link, end;
+
+   for (link = CctHead [hash & (CCT_HASH-1)]; link; link = c->next [end])
+      {
+      c = CCT ((link - 1) >> 1);
+      end = (link - 1) & 1;
+
+      if (c->hash [end] == hash && c->cct [end] == cct
+      && strcmp (c->node [end], node) == 0)
+         return (link);
+      }
+
+   return (0);
+   }
+
+// Add one end of a circuit to its hash chain
+static void cct_link (int i, int end)
+   {
+   CIRCUIT  *c = CCT (i);
+   int      *head;
+
+   c->hash [end] = cct_hash (c->node [end], c->cct [end]);
+   head = &CctHead [c->hash [end] & (CCT_HASH-1)];
+   c->next [end] = *head;
+   *head = CCT_LINK (i, end);
+   }
+
+// Remove one end of a circuit from its hash chain
+static void cct_unlink (int i, int end)
+   {
+   CIRCUIT  *c = CCT (i), *p;
+   int      *lp = &CctHead [c->hash [end] & (CCT_HASH-1)];
+
+   while (*lp && *lp != CCT_LINK (i, end))
+      {
+      p = CCT ((*lp - 1) >> 1);
+      lp = &p->next [(*lp - 1) & 1];
+      }
+
+   if (*lp) *lp = c->next [end];
+   }
+
+// Take a circuit out of the activity list
+static void cct_detach (int i)
+   {
+   CIRCUIT  *c = CCT (i);
+
+   if (c->older) CCT (c->older - 1)->newer = c->newer;
+   else CctOldest = c->newer;
+
+   if (c->newer) CCT (c->newer - 1)->older = c->older;
+   else CctNewest = c->older;
+
+   c->older = c->newer = 0;
+   }
+
+// Put a circuit at the newest end of the activity list
+static void cct_touch (int i)
+   {
+   CIRCUIT  *c = CCT (i);
+
+   if (CctNewest == i + 1) return;
+   if (c->older || c->newer || CctOldest == i + 1) cct_detach (i);
+
+   c->older = CctNewest;
+   if (CctNewest) CCT (CctNewest - 1)->newer = i + 1;
+   else CctOldest = i + 1;
+   CctNewest = i + 1;
+   }
+
+/**********************************************************************/
+/* Purpose:    Show the summary of a circuit, and free it
+ * Called by:  cct_count(), cct_sweep(), cct_alloc() and main() on exit
+ * Arguments:  Circuit index, reason it was closed
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cct_close (int i, const char *reason)
+   {
+   CIRCUIT     *c = CCT (i);
+   char        cct [2][12], ack [40];
+   struct tm   tm;
+   time_t      t = c->last;
+   int         end;
+
+   for (end = 0; end < 2; end++)
+      {
+      if (c->cct [end] >= 0) sprintf (cct [end], "%d", c->cct [end]);
+      else strcpy (cct [end], "?");
+      }
+
+   if (c->acks) sprintf (ack, "%.1f/%lds", (double) c->ackTotal
+      / c->acks, c->ackMax);
+   else strcpy (ack, "-");
+
+   gmtime_r (&t, &tm);
+
+   uprintf ("%02d:%02d:%02d %s:%s>%s:%s %s %lds info=%u/%u bytes=%llu/"
+      "%llu retx=%u/%u choke=%u nak=%u ack=%s %s\n",
+      tm.tm_hour, tm.tm_min, tm.tm_sec, c->node [0], cct [0],
+      c->node [1], cct [1], *c->user ? c->user : "-",
+      c->last - c->opened, c->dir [0].info, c->dir [1].info,
+      (unsigned long long) c->dir [0].bytes,
+      (unsigned long long) c->dir [1].bytes, c->dir [0].retx,
+      c->dir [1].retx, c->choke, c->nak, ack, reason);
+
+   out_endRecord ();
+
+   cct_unlink (i, 0);
+   if (c->cct [1] >= 0) cct_unlink (i, 1);
+   cct_detach (i);
+
+   c->next [0] = CctFree;
+   CctFree = i + 1;
+   }
+
+/**********************************************************************/
+/* Purpose:    Allocate a circuit
+ * Called by:  cct_count()
+ * Actions:    Takes one from the free list, or if that is empty,
+ *             allocates another slab of them.  If the pool is at
+ *             CCT_MAX, the least recently active circuit is closed to
+ *             make room.
+ * Returns:    Index of the circuit, zeroed, or -1 if out of memory.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int cct_alloc (void)
+   {
+   int   i;
+
+   if (CctFree == 0 && CctSlabs < CCT_MAX / CCT_SLAB
+   && (CctSlab [CctSlabs] = malloc (CCT_SLAB * sizeof (CIRCUIT))) != NULL)
+      {
+      for (i = CCT_SLAB - 1; i >= 0; i--)
+         {
+         CctSlab [CctSlabs][i].next [0] = CctFree;
+         CctFree = CctSlabs * CCT_SLAB + i + 1;
+         }
+
+      CctSlabs++;
+      }
+
+   if (CctFree == 0)
+      {
+      if (CctOldest == 0) return (-1);
+      cct_close (CctOldest - 1, "evicted");
+      CctEvicted++;
+      }
+
+   i = CctFree - 1;
+   CctFree = CCT (i)->next [0];
+   memset (CCT (i), 0, sizeof (CIRCUIT));
+
+   return (i);
+   }
+
+// Close the circuits that have been idle for too long
+static void cct_sweep (long now)
+   {
+   while (CctOldest && now - CCT (CctOldest - 1)->last > CctTimeout)
+      cct_close (CctOldest - 1, "timed out");
+   }
+
+/**********************************************************************/
+/* Purpose:    Follow the NetRom L4 circuit a frame belongs to
+ * Called by:  process_json(), instead of tracing the frame
+ * Arguments:  Pointer to tokenized JSON object
+ * Actions:    Finds the circuit, starting one for a CONN REQ, and
+ *             updates its counters.  A CONN NAK, DACK or RSET closes
+ *             it.  Frames for circuits whose start wasn't seen are
+ *             ignored.  Then closes any circuits which have timed out.
+ * Affects:    The circuit pool
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cct_count (const JSONOBJ *json)
+   {
+   char           src [CALL_MAXLEN], dst [CALL_MAXLEN];
+   char           reporter [CALL_MAXLEN];
+   CIRCUIT        *c;
+   CCTDIR         *d, *far;
+   long           t, rtt;
+   int            code, to, port, link, i, end, seq;
+
+   code = mnem_field (json, "l3Type", &L3Types);
+   if (code < 0 || L3Types.row [code].code != L3_NETROM) return;
+
+   code = mnem_field (json, "l4type", &L4Types);
+   code = code >= 0 ? L4Types.row [code].code : 0;
+   if (code < L4_CONNREQ) return;   // Not part of a circuit
+
+   if (track_call (json, "l3src", src) <= 0
+   || track_call (json, "l3dst", dst) <= 0
+   || strcmp (dst, "L3RTT") == 0
+   || (to = track_number (json, "toCct")) < 0
+   || track_call (json, "reportFrom", reporter) <= 0)
+      return;
+
+   port = track_number (json, "port");
+
+   if ((t = track_number (json, "time")) < 0) t = time (NULL);
+   if (t > CctLatest) CctLatest = t;
+
+   if (code == L4_CONNREQ || code == L4_CONNREQX)
+      {
+      // A repeated CONN REQ is the originator trying again
+      if ((link = cct_find (src, to)) == 0)
+         {
+         if ((i = cct_alloc ()) < 0) return;
+
+         c = CCT (i);
+         strcpy (c->node [0], src);
+         strcpy (c->node [1], dst);
+         c->cct [0] = to;
+         c->cct [1] = -1;
+         strcpy (c->reporter, reporter);
+         c->port = port;
+         c->state = CCT_OPENING;
+         c->opened = t;
+         c->dir [0].nextSeq = c->dir [1].nextSeq = -1;
+         c->dir [0].timedSeq = c->dir [1].timedSeq = -1;
+         if (track_call (json, "srcUser", c->user) < 0) *c->user = 0;
+         cct_link (i, 0);
+         link = CCT_LINK (i, 0);
+         }
+      }
+
+   // Every other frame carries the circuit of the node it goes to
+   else link = cct_find (dst, to);
+
+   if (link == 0) return;
+
+   i = (link - 1) >> 1;
+   c = CCT (i);
+
+   if (strcmp (c->reporter, reporter) || c->port != port) return;
+
+   // "end" is the end which sent the frame
+   if (code == L4_CONNREQ || code == L4_CONNREQX) end = 0;
+   else end = ((link - 1) & 1) ^ 1;
+
+   d = &c->dir [end];
+   far = &c->dir [end ^ 1];
+   d->frames++;
+   c->last = t;
+   cct_touch (i);
+
+   if (track_flag (json, "chokeFlag")) c->choke++;
+   if (track_flag (json, "nakFlag")) c->nak++;
+
+   switch (code)
+      {
+      case L4_CONNACK:
+         if (c->state == CCT_OPENING && track_flag (json, "chokeFlag"))
+            {
+            cct_close (i, "refused");  // CONN ACK with CHOKE is a NAK
+            break;
+            }
+
+         if (c->cct [1] < 0 && (c->cct [1] = track_number (json,
+            "fromCct")) >= 0)
+            cct_link (i, 1);
+
+         if (c->state == CCT_OPENING)
+            {
+            c->state = CCT_OPEN;
+            c->connected = t;
+            }
+         break;
+
+      case L4_CONNNAK:
+         cct_close (i, "refused");
+         break;
+
+      case L4_INFO:
+         d->info++;
+         if ((seq = track_number (json, "paylen")) > 0) d->bytes += seq;
+
+         if ((seq = track_number (json, "txSeq")) >= 0)
+            {
+            if (d->nextSeq >= 0 && ((seq - d->nextSeq) & 0xFF) >= 128)
+               {
+               d->retx++;
+               if (seq == d->timedSeq) d->timedSeq = -1;  // Karn
+               }
+
+            else
+               {
+               d->nextSeq = (seq + 1) & 0xFF;
+
+               if (d->timedSeq < 0)
+                  {
+                  d->timedSeq = seq;
+                  d->timedAt = t;
+                  }
+               }
+            }
+         // Fall through, INFO also acks
+
+      case L4_INFOACK:
+         seq = track_number (json, "rxSeq");
+
+         // "rxSeq" is the next one wanted, so acks all before it
+         if (seq >= 0 && far->timedSeq >= 0
+         && ((seq - far->timedSeq - 1) & 0xFF) < 128)
+            {
+            rtt = t - far->timedAt;
+            c->acks++;
+            c->ackTotal += rtt;
+            if (rtt > c->ackMax) c->ackMax = rtt;
+            far->timedSeq = -1;
+            }
+         break;
+
+      case L4_DREQ:
+         c->state = CCT_CLOSING;
+         break;
+
+      case L4_DACK:
+         cct_close (i, "closed");
+         break;
+
+      case L4_RSET:
+         cct_close (i, "reset");
+         break;
+      }
+
+   cct_sweep (CctLatest);
+   }
+
+/**********************************************************************/
+/* Purpose:    Show the circuits still open, on exit
+ * Called by:  main()
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cct_report (void)
+   {
+   while (CctOldest) cct_close (CctOldest - 1, "open");
+
+   if (CctEvicted)
+      uprintf ("%lu circuits closed early, too many open\n", CctEvicted);
+   }
+
+//######################################################################
+//                         LINK TRACKING FUNCTIONS
+//######################################################################
+
+/* With "-L <secs>" the traces are replaced by a table of the health
+ * of each AX25 connection, shown every <secs> seconds, and on exit.
+ * A link is identified by the reporter, the port, and the two
+ * callsigns, whichever way round they are, and its state follows the
+ * SABM/SABME, UA, DISC and DM frames.
+ *
+ * For each direction, the N(S) of the I frames which haven't yet been
+ * acked are kept in a bit mask, so an I frame whose N(S) is already in
+ * it is a retransmission.  The N(R) of frames the other way clears
+ * the acked ones from the mask.  One I frame at a time is timed, from
+ * its report to the report of the frame acking it, which gives the
+ * ack latency.  REJ and SREJ frames are counted too.
+ *
+ * The links are kept in a fixed-size open-addressed table, like the
+ * route table, so memory use is constant and each frame costs a few
+ * probes.  If every slot within reach is in use, the link heard
+ * longest ago is evicted.  The counts are for the period since the
+ * last table, but the state and sequence numbers are kept.  Links are
+ * tracked by a single thread, so "-m" is ignored.
+ * */
+#define  LINK_SLOTS     16384    // Default table size, power of 2
+#define  LINK_PROBES    8        // Max slots examined per lookup
+
+#define  LINK_UNKNOWN   0        // Link states, as shown in the table
+#define  LINK_SETUP     1
+#define  LINK_UP        2
+#define  LINK_DISC      3
+#define  LINK_DOWN      4
+
+static const char *LinkState [] = { "?", "setup", "up", "disc", "down" };
+
+typedef struct
+   {
+   uint64_t    unacked [2];      // Bit mask of N(S) not yet acked
+   int         acked;            // Next N(S) to be acked, -1 unknown
+   int         timedSeq;         // N(S) being timed, -1 = none
+   double      timedAt;          // When it was sent
+   unsigned    frames;           // Frames sent this way
+   unsigned    info;             // Of which I frames
+   unsigned    retx;             // I frames sent again
+   unsigned    rej, srej;        // REJ and SREJ frames sent
+   } LINKDIR;
+
+typedef struct
+   {
+   uint64_t    hash;             // Of the key, 0 = empty
+   char        reporter [CALL_MAXLEN];
+   int         port;
+   char        call [2][CALL_MAXLEN];  // The two ends, in order
+   int         state;            // LINK_xxx
+   int         modulo;           // 8, or 128 after SABME
+   double      heard;            // Time of latest frame
+   unsigned    connects;         // UA answering SABM/SABME
+   unsigned    acks;             // Ack latencies measured
+   double      ackTotal, ackMax; // Their total and maximum, secs
+   LINKDIR     dir [2];          // Frames sent by each end
+   } LINK;
+
+static LINK    *LinkTable = NULL;
+static int     LinkSlots = LINK_SLOTS;
+static int     LinkSecs = -1;          // Table interval, -1 = off
+static int     LinkCount = 0;          // Slots in use
+static time_t  LinkLast;               // When the last table was shown
+static unsigned long LinkLost = 0;     // Links evicted
+
+/**********************************************************************/
+/* Purpose:    Parse the "-L" option
+ * Called by:  main()
+ * Arguments:  Option value, "<seconds>[:<slots>]"
+ * Affects:    LinkSecs and LinkSlots, which is rounded up to a power
+ *             of 2.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void link_option (const char *value)
+   {
+   const char  *cp;
+   int         n;
+
+   LinkSecs = atoi (value);
+
+   if ((cp = strchr (value, ':')) != NULL && (n = atoi (cp+1)) > 0)
+      {
+      for (LinkSlots = 64; LinkSlots < n && LinkSlots < (1 << 24);
+         LinkSlots *= 2);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Find a link, adding it if necessary
+ * Called by:  link_count()
+ * Arguments:  Normalised reporter callsign, port number, normalised
+ *             callsigns of the two ends, in order.
+ * Actions:    Looks for the link in the LINK_PROBES slots from its
+ *             hash position.  If it isn't there, it is added, in the
+ *             first free slot or in place of the link heard longest
+ *             ago.
+ * Returns:    Pointer to the link.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static LINK *link_find (const char *reporter, int port, const char *a,
+   const char *b)
+   {
+   const char  *key [3] = { reporter, a, b }, *cp;
+   LINK        *lp, *oldest = NULL;
+   uint64_t    h = 14695981039346656037ULL;
+   int         i;
+
+   for (i = 0; i < 3; i++)
+      {
+      for (cp = key [i]; *cp; cp++)
+         {
+         h ^= (unsigned char) *cp;
+         h *= 1099511628211ULL;
+         }
+
+      h ^= '>';   // So "AB","C" isn't "A","BC"
+      h *= 1099511628211ULL;
+      }
+
+   h ^= port;
+   h *= 1099511628211ULL;
+   if (h == 0) h = 1;
+
+   for (i = 0; i < LINK_PROBES; i++)
+      {
+      lp = &LinkTable [(h + i) & (LinkSlots - 1)];
+
+      if (lp->hash == 0)
+         {
+         LinkCount++;
+         break;
+         }
+
+      if (lp->hash == h && lp->port == port
+      && strcmp (lp->call [0], a) == 0 && strcmp (lp->call [1], b) == 0
+      && strcmp (lp->reporter, reporter) == 0)
+         return (lp);
+
+      if (oldest == NULL || lp->heard < oldest->heard) oldest = lp;
+      }
+
+   if (i == LINK_PROBES)   // No free slots, so evict
+      {
+      lp = oldest;
+      LinkLost++;
+      }
+
+   memset (lp, 0, sizeof (LINK));
+   lp->hash = h;
+   strcpy (lp->reporter, reporter);
+   lp->port = port;
+   strcpy (lp->call [0], a);
+   strcpy (lp->call [1], b);
+   lp->modulo = 8;
+   lp->dir [0].acked = lp->dir [1].acked = -1;
+   lp->dir [0].timedSeq = lp->dir [1].timedSeq = -1;
+
+   return (lp);
+   }
+
+// Forget the frames outstanding, when a link is (re)connected
+static void link_reset (LINK *lp)
+   {
+   int   d;
+
+   for (d = 0; d < 2; d++)
+      {
+      lp->dir [d].unacked [0] = lp->dir [d].unacked [1] = 0;
+      lp->dir [d].acked = 0;
+      lp->dir [d].timedSeq = -1;
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Process an N(R), acking frames sent the other way
+ * Called by:  link_count()
+ * Arguments:  Pointer to link, direction of the frames acked, N(R),
+ *             time of the report.
+ * Actions:    Clears the N(S) before N(R) from the direction's mask,
+ *             and if the timed frame is among them, takes its latency.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void link_ack (LINK *lp, LINKDIR *d, int nr, double t)
+   {
+   double   lat;
+   int      ns, n;
+
+   if (nr < 0 || nr >= lp->modulo) return;
+
+   // If the first ack has been missed, start from this one
+   if (d->acked < 0) d->acked = nr;
+
+   for (ns = d->acked, n = 0; ns != nr && n < lp->modulo; n++)
+      {
+      d->unacked [ns >> 6] &= ~(1ULL << (ns & 63));
+
+      if (ns == d->timedSeq)
+         {
+         lat = t - d->timedAt;
+         lp->acks++;
+         lp->ackTotal += lat;
+         if (lat > lp->ackMax) lp->ackMax = lat;
+         d->timedSeq = -1;
+         }
+
+      ns = (ns + 1) % lp->modulo;
+      }
+
+   d->acked = nr;
+   }
+
+// Sort links by the number of frames, busiest first
+static int link_compare (const void *a, const void *b)
+   {
+   const LINK  *la = *(const LINK **) a;
+   const LINK  *lb = *(const LINK **) b;
+   unsigned    na = la->dir [0].frames + la->dir [1].frames;
+   unsigned    nb = lb->dir [0].frames + lb->dir [1].frames;
+
+   if (na != nb) return (na < nb ? 1 : -1);
+
+   return (strcmp (la->reporter, lb->reporter));
+   }
+
+/**********************************************************************/
+/* Purpose:    Show the link table, and clear the counters
+ * Called by:  link_count() every LinkSecs seconds, and main() on exit
+ * Actions:    Lists the links heard since the last table, busiest
+ *             first.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void link_print (time_t now)
+   {
+   LINK     **list, *lp;
+   char     stamp [16], pair [40], rate [8], ack [24];
+   unsigned info, retx;
+   int      i, n;
+
+   if ((list = malloc ((LinkCount + 1) * sizeof (LINK *))) == NULL)
+      return;
+
+   for (i = n = 0; i < LinkSlots; i++)
+      {
+      lp = &LinkTable [i];
+      if (lp->hash && lp->dir [0].frames + lp->dir [1].frames)
+         list [n++] = lp;
+      }
+
+   qsort (list, n, sizeof (LINK *), link_compare);
+
+   strftime (stamp, 16, "%H:%M:%S", localtime (&now));
+   uprintf ("%s  %d links in %ld secs\n", stamp, n,
+      (long) (now - LinkLast));
+
+   uprintf ("Reporter  Port Link                  State Conn Frames"
+      "     I  Retx   REJ  SREJ Retx%%  Ack avg/max\n");
+
+   for (i = 0; i < n; i++)
+      {
+      lp = list [i];
+      info = lp->dir [0].info + lp->dir [1].info;
+      retx = lp->dir [0].retx + lp->dir [1].retx;
+
+      snprintf (pair, sizeof (pair), "%s<>%s", lp->call [0],
+         lp->call [1]);
+
+      if (info) sprintf (rate, "%5.1f", 100.0 * retx / info);
+      else strcpy (rate, "    -");
+
+      if (lp->acks) sprintf (ack, "%.1f/%.1fs",
+         lp->ackTotal / lp->acks, lp->ackMax);
+      else strcpy (ack, "-");
+
+      uprintf ("%-9s %4d %-21s %-5s %4u %6u %5u %5u %5u %5u %s  %s\n",
+         lp->reporter, lp->port, pair, LinkState [lp->state],
+         lp->connects, lp->dir [0].frames + lp->dir [1].frames, info,
+         retx, lp->dir [0].rej + lp->dir [1].rej,
+         lp->dir [0].srej + lp->dir [1].srej, rate, ack);
+      }
+
+   if (LinkLost)
+      uprintf ("%lu links evicted, table full\n", LinkLost);
+
+   uprintf ("\n");
+   out_endRecord ();
+
+   // Clear the counters, but keep the state
+   for (i = 0; i < LinkSlots; i++)
+      {
+      lp = &LinkTable [i];
+      lp->connects = lp->acks = 0;
+      lp->ackTotal = lp->ackMax = 0;
+      for (n = 0; n < 2; n++)
+         {
+         lp->dir [n].frames = lp->dir [n].info = lp->dir [n].retx = 0;
+         lp->dir [n].rej = lp->dir [n].srej = 0;
+         }
+      }
+
+   LinkLost = 0;
+   LinkLast = now;
+   free (list);
+   }
+
+/**********************************************************************/
+/* Purpose:    Follow the link a frame belongs to
+ * Called by:  link_count()
+ * Arguments:  Pointer to tokenized JSON object
+ * Actions:    Finds the link, follows its state, counts the frame, and
+ *             checks its N(S) and N(R).  UI, XID and TEST frames are
+ *             not part of a link, so are ignored.
+ * Affects:    LinkTable
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void link_frame (const JSONOBJ *json)
+   {
+   char        reporter [CALL_MAXLEN], src [CALL_MAXLEN];
+   char        dst [CALL_MAXLEN];
+   LINK        *lp;
+   LINKDIR     *d, *far;
+   double      t;
+   int         code, port, ns, nr, end, bit;
+
+   if ((code = mnem_field (json, "l2Type", &L2Types)) < 0
+   || (code = L2Types.row [code].code) == 0
+   || code == L2_UI || code == L2_XID || code == L2_TEST
+   || track_call (json, "reportFrom", reporter) <= 0
+   || track_call (json, "srce", src) <= 0
+   || track_call (json, "dest", dst) <= 0)
+      return;
+
+   port = track_number (json, "port");
+   end = strcmp (src, dst) > 0;
+
+   lp = end ? link_find (reporter, port, dst, src)
+      : link_find (reporter, port, src, dst);
+
+   t = track_time (json);
+   lp->heard = t;
+
+   d = &lp->dir [end];
+   far = &lp->dir [end ^ 1];
+   d->frames++;
+
+   ns = track_number (json, "tseq");
+   nr = track_number (json, "rseq");
+   if (ns > 7 || nr > 7) lp->modulo = 128;
+
+   switch (code)
+      {
+      case L2_SABM:
+      case L2_SABME:
+         lp->state = LINK_SETUP;
+         lp->modulo = code == L2_SABME ? 128 : 8;
+         break;
+
+      case L2_UA:
+         if (lp->state == LINK_SETUP)
+            {
+            lp->state = LINK_UP;
+            lp->connects++;
+            link_reset (lp);
+            }
+         else if (lp->state == LINK_DISC) lp->state = LINK_DOWN;
+         break;
+
+      case L2_DISC:
+         lp->state = LINK_DISC;
+         break;
+
+      case L2_DM:
+         lp->state = LINK_DOWN;
+         break;
+
+      case L2_I:
+         if (lp->state == LINK_UNKNOWN) lp->state = LINK_UP;
+         d->info++;
+
+         if (ns >= 0 && ns < lp->modulo)
+            {
+            bit = ns & 63;
+
+            if (d->unacked [ns >> 6] & (1ULL << bit))
+               {
+               d->retx++;
+               if (ns == d->timedSeq) d->timedSeq = -1;  // Karn
+               }
+
+            else
+               {
+               d->unacked [ns >> 6] |= 1ULL << bit;
+
+               if (d->timedSeq < 0)
+                  {
+                  d->timedSeq = ns;
+                  d->timedAt = t;
+                  }
+               }
+            }
+
+         link_ack (lp, far, nr, t);
+         break;
+
+      case L2_REJ:
+         d->rej++;
+         link_ack (lp, far, nr, t);
+         break;
+
+      case L2_SREJ:   // Asks for one frame, so acks nothing
+         d->srej++;
+         break;
+
+      case L2_RR:
+      case L2_RNR:
+         link_ack (lp, far, nr, t);
+         break;
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Track a frame's link
+ * Called by:  process_json(), instead of tracing the frame
+ * Arguments:  Pointer to tokenized JSON object
+ * Actions:    Follows the frame's link, then shows the table if it's
+ *             due.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void link_count (const JSONOBJ *json)
+   {
+   time_t   now = time (NULL);
+
+   link_frame (json);
+
+   if (LinkSecs > 0 && now - LinkLast >= LinkSecs) link_print (now);
+   }
+
+//######################################################################
+//                       STRUCTURED OUTPUT FUNCTIONS
+//######################################################################
+
+/* With "-O ndjson", "-O csv" or "-O bin", each frame which passes the
+ * filters is written as one record, with the fields of EmitFields in
+ * that order, instead of being traced.  The values are copied straight
+ * from the tokens into the output buffer, without any formatting, so
+ * pnmptrace can be used as a fast filter in front of other tools.
+ *
+ * Callsigns are normalised (upper case without "-0"), numbers which
+ * were sent as strings are unquoted, and flags are true or false.
+ * Fields which are missing are left out of NDJSON and binary records,
+ * and left empty in CSV.  Arrays, such as the "nodes" of a routing
+ * broadcast, and free text payloads are not included.
+ *
+ * A binary record is a 2 byte little-endian length of the rest of the
+ * record, then for each field present, its index in EmitFields, the
+ * length of its value, and the value as text, each in one byte.
+ * */
+#define  OUTF_TEXT      0        // Output formats
+#define  OUTF_NDJSON    1
+#define  OUTF_CSV       2
+#define  OUTF_BINARY    3
+
+#define  EF_STR         0        // Field kinds
+#define  EF_NUM         1
+#define  EF_BOOL        2
+#define  EF_CALL        3
+
+typedef struct
+   {
+   const char  *name;            // JSON field name
+   int         kind;             // EF_xxx
+   } EMITFIELD;
+
+static const EMITFIELD EmitFields [] =
+   {
+   { "time",       EF_NUM },   { "reportFrom", EF_CALL },
+   { "port",       EF_NUM },   { "dirn",       EF_STR },
+   { "isRF",       EF_BOOL },  { "srce",       EF_CALL },
+   { "dest",       EF_CALL },  { "l2Type",     EF_STR },
+   { "cr",         EF_STR },   { "pf",         EF_STR },
+   { "rseq",       EF_NUM },   { "tseq",       EF_NUM },
+   { "ilen",       EF_NUM },   { "pid",        EF_NUM },
+   { "ptcl",       EF_STR },   { "l3Type",     EF_STR },
+   { "l3src",      EF_CALL },  { "l3dst",      EF_CALL },
+   { "ttl",        EF_NUM },   { "l4type",     EF_STR },
+   { "toCct",      EF_NUM },   { "fromCct",    EF_NUM },
+   { "txSeq",      EF_NUM },   { "rxSeq",      EF_NUM },
+   { "window",     EF_NUM },   { "paylen",     EF_NUM },
+   { "srcUser",    EF_CALL },  { "srcNode",    EF_CALL },
+   { "service",    EF_NUM },   { "chokeFlag",  EF_BOOL },
+   { "nakFlag",    EF_BOOL },  { "moreFlag",   EF_BOOL },
+   { "type",       EF_STR },   { "fromAlias",  EF_STR },
+   { "ipFrom",     EF_STR },   { "ipTo",       EF_STR },
+   { "ipLen",      EF_NUM },   { "ipTTL",      EF_NUM },
+   { "ipID",       EF_STR },   { "ipPtcl",     EF_NUM },
+   { "ipProto",    EF_STR },   { "arpOp",      EF_STR },
+   { "arpHwType",  EF_STR },   { "arpPtcl",    EF_STR },
+   { "arpSndAddr", EF_STR },   { "arpTgtAddr", EF_STR },
+   { "arpSndHw",   EF_STR },   { "arpTgtHw",   EF_STR },
+   { NULL }
+   };
+
+static int     OutFormat = OUTF_TEXT;
+
+static const char *OutFormats [] = { "text", "ndjson", "csv", "bin", NULL };
+
+/**********************************************************************/
+/* Purpose:    Parse the "-O" option
+ * Called by:  main()
+ * Arguments:  Format name
+ * Returns:    0 if successful, else -1
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int emit_option (const char *value)
+   {
+   int   i;
+
+   for (i = 0; OutFormats [i]; i++)
+      {
+      if (strcasecmp (value, OutFormats [i]) == 0)
+         {
+         OutFormat = i;
+         return (0);
+         }
+      }
+
+   return (-1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Test whether a value is a JSON number, so it needn't be
+ *             quoted
+ * Called by:  emit_value()
+ * Arguments:  Pointer to value, its length.
+ * Actions:    Matches it against the JSON number grammar, i.e. an
+ *             optional '-', then "0" or digits not starting with 0,
+ *             then an optional fraction and exponent.  So "05", "-" and
+ *             "1.2.3" are kept as strings.
+ * Returns:    1 if it is a number, else 0
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to follow the JSON grammar, not just the
+ *             characters. */
+/**********************************************************************/
+
+static int emit_isNumber (const char *cp, int len)
+   {
+   const char  *end = cp + len;
+
+   if (cp < end && *cp == '-') cp++;
+
+   if (cp == end || !isdigit ((unsigned char) *cp)) return (0);
+
+   if (*cp == '0') cp++;   // No leading zeros
+   else while (cp < end && isdigit ((unsigned char) *cp)) cp++;
+
+   if (cp < end && *cp == '.')
+      {
+      if (++cp == end || !isdigit ((unsigned char) *cp)) return (0);
+      while (cp < end && isdigit ((unsigned char) *cp)) cp++;
+      }
+
+   if (cp < end && (*cp == 'e' || *cp == 'E'))
+      {
+      if (++cp < end && (*cp == '+' || *cp == '-')) cp++;
+      if (cp == end || !isdigit ((unsigned char) *cp)) return (0);
+      while (cp < end && isdigit ((unsigned char) *cp)) cp++;
+      }
+
+   return (cp == end);
+   }
+
+/**********************************************************************/
+/* Purpose:    Get the normalised value of a field
+ * Called by:  emit_record()
+ * Arguments:  Pointer to tokenized JSON object, field descriptor,
+ *             buffer of CALL_MAXLEN chars for callsigns, pointers to
+ *             receive the value and its length.
+ * Returns:    The kind to write it as: EF_NUM for a bare number,
+ *             EF_BOOL for true or false, else EF_STR.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to check for an empty value. */
+/**********************************************************************/
+
+static int emit_value (const JSONOBJ *json, const EMITFIELD *ef,
+   const JFIELD *f, char *call, const char **val, int *len)
+   {
+   *val = json->text + f->valOff;
+   *len = f->valLen;
+
+   switch (ef->kind)
+      {
+      case EF_NUM:
+         if (emit_isNumber (*val, *len)) return (EF_NUM);
+         break;
+
+      case EF_BOOL:
+         *val = (*len && **val == 't') ? "true" : "false";
+         *len = strlen (*val);
+         return (EF_BOOL);
+
+      case EF_CALL:
+         if (f->type == JT_STRING
+         && (*len = call_normalise (*val, *len, call)) >= 0)
+            {
+            *val = call;
+            return (EF_STR);
+            }
+
+         *len = f->valLen;
+         break;
+      }
+
+   return (f->type == JT_STRING ? EF_STR : EF_NUM);
+   }
+
+// Append a value to a CSV line, quoting it if need be
+static void emit_csv (OUTBUF *ob, const char *val, int len)
+   {
+   int      i, start;
+
+   for (i = 0; i < len; i++)
+      if (val [i] == ',' || val [i] == '"' || val [i] == '\n') break;
+
+   if (i == len)
+      {
+      out_append (ob, val, len);
+      return;
+      }
+
+   out_append (ob, "\"", 1);
+
+   for (i = start = 0; i < len; i++)
+      {
+      if (val [i] != '"') continue;
+      out_append (ob, val + start, i + 1 - start);
+      out_append (ob, "\"", 1);   // Double the quote
+      start = i + 1;
+      }
+
+   out_append (ob, val + start, len - start);
+   out_append (ob, "\"", 1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Write the CSV header line
+ * Called by:  main(), before the input is read
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void emit_header (void)
+   {
+   OUTBUF   *ob = *TraceLog.name ? &Out->file : &Out->screen;
+   int      i;
+
+   for (i = 0; EmitFields [i].name; i++)
+      {
+      if (i) out_append (ob, ",", 1);
+      out_append (ob, EmitFields [i].name, strlen (EmitFields [i].name));
+      }
+
+   out_append (ob, "\n", 1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Write a frame as a structured record
+ * Called by:  process_json(), instead of tracing the frame
+ * Arguments:  Pointer to tokenized JSON object
+ * Actions:    Appends the record, in the format chosen by "-O", to the
+ *             capture file buffer if there is one, else the screen
+ *             buffer.  Like the traces, it is also echoed to the screen
+ *             unless in "quiet" mode.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void emit_record (const JSONOBJ *json)
+   {
+   const EMITFIELD   *ef;
+   const JFIELD      *f;
+   const char        *val;
+   char              call [CALL_MAXLEN];
+   unsigned char     tlv [2];
+   OUTBUF            *ob;
+   size_t            start;
+   int               i, len, kind, n = 0;
+
+   ob = *TraceLog.name ? &Out->file : &Out->screen;
+   if (ob == &Out->screen && (Cfg->traceFlags & TRACE_QUIET)) return;
+
+   start = ob->len;
+
+   if (OutFormat == OUTF_NDJSON) out_append (ob, "{", 1);
+   else if (OutFormat == OUTF_BINARY) out_append (ob, "\0\0", 2);
+
+   for (i = 0, ef = EmitFields; ef->name; i++, ef++)
+      {
+      f = json_findField (json, ef->name);
+
+      if (OutFormat == OUTF_CSV)
+         {
+         if (i) out_append (ob, ",", 1);
+         if (f == NULL) continue;
+         emit_value (json, ef, f, call, &val, &len);
+         emit_csv (ob, val, len);
+         continue;
+         }
+
+      if (f == NULL) continue;
+      kind = emit_value (json, ef, f, call, &val, &len);
+
+      if (OutFormat == OUTF_BINARY)
+         {
+         if (len > 255) len = 255;
+         tlv [0] = i;
+         tlv [1] = len;
+         out_append (ob, (const char *) tlv, 2);
+         out_append (ob, val, len);
+         continue;
+         }
+
+      // NDJSON, where string values are still escaped as they came
+      if (n++) out_append (ob, ",", 1);
+      out_append (ob, "\"", 1);
+      out_append (ob, ef->name, strlen (ef->name));
+      out_append (ob, "\":", 2);
+      if (kind == EF_STR) out_append (ob, "\"", 1);
+      out_append (ob, val, len);
+      if (kind == EF_STR) out_append (ob, "\"", 1);
+      }
+
+   if (OutFormat == OUTF_NDJSON) out_append (ob, "}\n", 2);
+   else if (OutFormat == OUTF_CSV) out_append (ob, "\n", 1);
+
+   else  // Fill in the length
+      {
+      len = ob->len - start - 2;
+      ob->buf [start] = len & 0xFF;
+      ob->buf [start + 1] = len >> 8;
+      }
+
+   if (ob == &Out->file && (Cfg->traceFlags & TRACE_QUIET) == 0)
+      out_append (&Out->screen, ob->buf + start, ob->len - start);
+   }
+
+//######################################################################
+//                          INPUT QUEUE FUNCTIONS
+//######################################################################
+
+/* Normally the reader decodes each record, or waits for room in the
+ * decode pipeline, before reading the next.  So if the decoding, or
+ * the terminal, can't keep up, the reader stops reading, the pipe from
+ * mosquitto_sub or the broker's socket fills, and the broker drops the
+ * connection, losing the whole session.
+ *
+ * With "-Q <policy>[:<records>]", the reader only frames the records,
+ * and copies them into a bounded ring, from which the queue thread
+ * takes them to be decoded, directly or through the pipeline (see
+ * queue_thread()).  So the reader keeps reading, and servicing the
+ * MQTT timers, through a stall of up to <records> records.  If the
+ * ring fills, the policy says what to do:
+ *
+ *    block    Wait for room, the same as without "-Q"
+ *    oldest   Drop the oldest record waiting
+ *    low      Drop the oldest UI frame waiting, i.e. a beacon or a
+ *             NODES broadcast, or the oldest record if there are none
+ *
+ * Records are saved by "-B" before they are queued, so the capture is
+ * complete, whatever is dropped.  The number dropped, and how far the
+ * output is behind the records' "time" stamps, are exported with the
+ * metrics, and shown in the trace, at most once a second, while
+ * records are being dropped.
+ *
+ * The queue thread takes a record by swapping its own buffer for the
+ * slot's, so the slot is free at once, and the buffers are reused, as
+ * in the pipeline.
+ * */
+#define  QUEUE_SLOTS    4096     // Default records queued, power of 2
+#define  QUEUE_MAXSLOTS (1 << 20)
+
+#define  QP_BLOCK       0        // Overload policies
+#define  QP_OLDEST      1
+#define  QP_LOW         2
+
+typedef struct
+   {
+   char     *json;               // Copy of the serialised object
+   int      len;                 // Length of object
+   int      size;                // Allocated size of "json"
+   int      null;                // Object was too big to frame
+   int      low;                 // Low priority, i.e. a UI frame
+   } QUEUEREC;
+
+static QUEUEREC      *QueueRec = NULL;
+static int           QueueSlots = 0;    // Records queued, 0 = no queue
+static int           QueuePolicy = QP_BLOCK;
+static unsigned long QueueHead;     // Sequence number of next to fill
+static unsigned long QueueTail;     // Next to be decoded
+static int           QueueLow;      // Low priority records waiting
+static int           QueueEnd;      // No more input
+static unsigned long QueueDropped;  // Records dropped by the policy
+static unsigned long QueueShown;    // Of those, reported in the trace
+static time_t        QueueNoticed;  // When they were last reported
+static long          QueueLag;      // Output behind "time", seconds
+static pthread_mutex_t QueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  QueueWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  QueueFree = PTHREAD_COND_INITIALIZER;
+static pthread_t       QueueThread;
+
+static const char *QueuePolicies [] =
+   { "block", "oldest", "low", NULL };
+
+/**********************************************************************/
+/* Purpose:    Parse the "-Q" option
+ * Called by:  main()
+ * Arguments:  Option value, "<policy>[:<records>]"
+ * Affects:    QueuePolicy and QueueSlots, which is rounded up to a
+ *             power of 2.
+ * Returns:    0 if successful, else -1
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int queue_option (const char *value)
+   {
+   const char  *cp;
+   int         i, n;
+
+   n = (cp = strchr (value, ':')) != NULL ? cp - value : strlen (value);
+
+   for (i = 0; QueuePolicies [i]; i++)
+      {
+      if (strlen (QueuePolicies [i]) == (size_t) n
+      && strncasecmp (value, QueuePolicies [i], n) == 0) break;
+      }
+
+   if (QueuePolicies [i] == NULL)
+      {
+      printf ("Unknown queue policy '%.*s'\n", n, value);
+      return (-1);
+      }
+
+   QueuePolicy = i;
+   QueueSlots = QUEUE_SLOTS;
+
+   if (cp && (n = atoi (cp+1)) > 0)
+      {
+      for (QueueSlots = 64; QueueSlots < n
+         && QueueSlots < QUEUE_MAXSLOTS; QueueSlots *= 2);
+      }
+
+   return (0);
+   }
+
+// Test whether a record is of low priority, i.e. a UI frame
+static int queue_isLow (const char *text, int len)
+   {
+   JSONOBJ  json;
+   JSTR     v;
+
+   json_reset (len);
+   json_index (&json, text, len);
+
+   return (json_getStr (&json, "l2Type", &v, 7)
+      && json_strIs (&v, "UI"));
+   }
+
+/**********************************************************************/
+/* Purpose:    Drop a record from the full queue
+ * Called by:  queue_put(), with QueueLock held
+ * Actions:    With the "low" policy, finds the oldest low priority
+ *             record, and moves the older records up over it, so that
+ *             the ring stays in order, and it is the oldest.  Then
+ *             frees the oldest slot.
+ * Affects:    QueueTail, QueueLow and QueueDropped
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void queue_drop (void)
+   {
+   unsigned long  i = QueueTail;
+   QUEUEREC       rec, *qr = QueueRec;
+   int            mask = QueueSlots - 1;
+
+   if (QueuePolicy == QP_LOW && QueueLow)
+      {
+      while (!qr [i & mask].low) i++;   // There is one
+
+      for (; i != QueueTail; i--)
+         {
+         rec = qr [i & mask];
+         qr [i & mask] = qr [(i-1) & mask];
+         qr [(i-1) & mask] = rec;
+         }
+      }
+
+   if (qr [QueueTail & mask].low) QueueLow--;
+
+   QueueTail++;
+   __atomic_fetch_add (&QueueDropped, 1, __ATOMIC_RELAXED);
+   }
+
+/**********************************************************************/
+/* Purpose:    Queue a framed object to be decoded
+ * Called by:  dispatch_json(), if "-Q" is used
+ * Arguments:  As dispatch_json()
+ * Actions:    Makes room, if the queue is full, by waiting or dropping
+ *             a record, as the policy says, then copies the object into
+ *             the next slot, and wakes the queue thread.
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void queue_put (const char *json, int len)
+   {
+   QUEUEREC *qp;
+   int      low = 0;
+
+   // Classified before the slot is filled, as the lock mustn't be held
+   if (QueuePolicy == QP_LOW && json) low = queue_isLow (json, len);
+
+   pthread_mutex_lock (&QueueLock);
+
+   if (QueuePolicy == QP_BLOCK)
+      {
+      while (QueueHead - QueueTail >= (unsigned long) QueueSlots)
+         pthread_cond_wait (&QueueFree, &QueueLock);
+      }
+
+   else if (QueueHead - QueueTail >= (unsigned long) QueueSlots)
+      queue_drop ();
+
+   pthread_mutex_unlock (&QueueLock);
+
+   // The slot is ours until the head is moved past it
+   qp = &QueueRec [QueueHead & (QueueSlots-1)];
+
+   if (len > qp->size)
+      {
+      if ((qp->json = realloc (qp->json, len)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+      qp->size = len;
+      }
+
+   if (json) memcpy (qp->json, json, len);
+   qp->len = len;
+   qp->null = (json == NULL);
+   qp->low = low;
+
+   pthread_mutex_lock (&QueueLock);
+   QueueHead++;
+   QueueLow += low;
+   pthread_cond_signal (&QueueWork);
+   pthread_mutex_unlock (&QueueLock);
+   }
+
+// Note how far behind the output is, from the record's "time"
+static void queue_lag (const JSONOBJ *json)
+   {
+   long  t = json_getLong (json, "time", 0);
+
+   if (t > 0)
+      __atomic_store_n (&QueueLag, (long) time (NULL) - t,
+         __ATOMIC_RELAXED);
+   }
+
+/**********************************************************************/
+/* Purpose:    Report the records dropped since the last report
+ * Called by:  process_json(), before each trace, if "-Q" is used
+ * Actions:    If more records have been dropped, and there hasn't been
+ *             a report this second, shows how many, and the lag.
+ * Affects:    QueueShown and QueueNoticed
+ * Notes:      With the pipeline, the workers race to make the report,
+ *             but only one wins each second, and the exchange of
+ *             QueueShown gives each report its own share of the drops.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void queue_notice (void)
+   {
+   unsigned long  dropped, shown;
+   time_t         now, last;
+
+   dropped = __atomic_load_n (&QueueDropped, __ATOMIC_RELAXED);
+   if (dropped == __atomic_load_n (&QueueShown, __ATOMIC_RELAXED))
+      return;
+
+   now = time (NULL);
+   last = __atomic_load_n (&QueueNoticed, __ATOMIC_RELAXED);
+
+   if (now == last || !__atomic_compare_exchange_n (&QueueNoticed,
+      &last, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return;
+
+   shown = __atomic_exchange_n (&QueueShown, dropped, __ATOMIC_RELAXED);
+
+   if (dropped > shown)
+      uprintf ("[%lu records dropped by the input queue, output %lds "
+         "behind]\n", dropped - shown,
+         __atomic_load_n (&QueueLag, __ATOMIC_RELAXED));
+   }
+
+// Report the number of records dropped by the queue, on exit
+static void queue_report (void)
+   {
+   if (QueueSlots)
+      fprintf (stderr, "Records dropped by the input queue: %lu\n",
+         QueueDropped);
+   }
+
+//######################################################################
+//                         TRACE HEADER FUNCTIONS
+//######################################################################
+
+/* The start of each trace, i.e. the colour and the "reporter(port)D"
+ * or "reporter port n (RF) dirn:" header, depends only on the reporter,
+ * port, direction and RF flag, which repeat all the time.  So each
+ * decode thread keeps the headers it has rendered in a small direct
+ * mapped cache, keyed by those fields as shown, and a header is then
+ * output with a single copy, rather than formatted afresh for every
+ * trace.  A header rendered for a different CONFIG snapshot, i.e.
+ * before the display options were reloaded, is rendered again.
+ *
+ * The timestamps are similar, as the report times cluster: the last
+ * "HH:MM:SS " rendered is kept, with the time it was rendered for.
+ *
+ * Fields that were decoded can be longer than their 15, 15 and 4 chars
+ * in the record.  A key that doesn't fit isn't cached, and its header
+ * is rendered into a spare entry each time.
+ * */
+#define  HDR_SLOTS      256      // Cached headers per thread, power of 2
+#define  HDR_KEYLEN     40       // Reporter, port, dirn and isRF
+#define  HDR_MAXLEN     (34 * JSON_EXPAND + 24)   // Decoded fields
+
+typedef struct
+   {
+   int         keyLen;           // Length of key, 0 = unused
+   unsigned    cfg;              // CONFIG generation it was made for
+   char        key [HDR_KEYLEN];
+   const char  *colour;          // ANSI colour escape for the trace
+   int         len;              // Length of header
+   char        header [HDR_MAXLEN];
+   } HDRENTRY;
+
+static __thread HDRENTRY HdrCache [HDR_SLOTS];
+static __thread HDRENTRY HdrSpare;         // For keys too long to cache
+static __thread time_t   StampTime = -1;   // Time of Stamp
+static __thread char     Stamp [12];       // "HH:MM:SS "
+
+/**********************************************************************/
+/* Purpose:    Choose the colour of a trace
+ * Called by:  hdr_find()
+ * Arguments:  First chars of "isRF" and "dirn", 0 if not present.
+ * Returns:    Pointer to the ANSI colour escape.
+ * Created:    14/10/2026, moved out of process_json()
+ * Modified:   */
+/**********************************************************************/
+
+static const char *hdr_colour (int rf, int dir)
+   {
+   if (rf == 't') // True
+      {
+      switch (dir)
+         {
+         case 's':   return ("\x1b[91m");  // red
+         case 'r':   return ("\x1b[92m");  // green
+         default:    return ("\x1b[93m");  // yellow
+         }
+      }
+
+   else if (rf == 'f')  // False
+      {
+      switch (dir)
+         {
+         case 's':   return ("\x1b[38;2;255;150;150m");
+         case 'r':   return ("\x1b[38;2;50;255;150m");   // Cyan
+         default:    return ("\x1b[94m");  // Blue
+         }
+      }
+
+   return ("\x1b[0m");  // Unknown RF/Inet status, white
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the cached header for a trace
+ * Called by:  process_json()
+ * Arguments:  Views of "reportFrom", "port" and "dirn", and the first
+ *             char of "isRF", 0 if not present.
+ * Actions:    Builds the key from the fields and looks it up.  If it
+ *             isn't there, or was rendered for an older snapshot, the
+ *             header is rendered into the slot, replacing whatever was
+ *             there.  If the key is too long, it is rendered into the
+ *             spare entry.
+ * Affects:    The thread's HdrCache.
+ * Returns:    Pointer to the cache entry.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static const HDRENTRY *hdr_find (const JSTR *reporter,
+   const JSTR *port, const JSTR *dirn, int rf)
+   {
+   HDRENTRY *hp;
+   char     key [HDR_KEYLEN];
+   int      n, dir = dirn->len ? *dirn->ptr : 0;
+
+   n = snprintf (key, sizeof (key), "%.*s\t%.*s\t%.*s\t%c",
+      reporter->len, reporter->ptr, port->len, port->ptr, dirn->len,
+      dirn->ptr, rf ? rf : '-');
+
+   if (n >= (int) sizeof (key))
+      {
+      hp = &HdrSpare;
+      hp->keyLen = 0;
+      }
+
+   else
+      {
+      hp = &HdrCache [json_hash (key, n) & (HDR_SLOTS - 1)];
+
+      if (hp->keyLen == n && hp->cfg == Cfg->gen
+      && memcmp (hp->key, key, n) == 0)
+         return (hp);
+
+      memcpy (hp->key, key, n);
+      hp->keyLen = n;
+      }
+
+   hp->cfg = Cfg->gen;
+   hp->colour = hdr_colour (rf, dir);
+
+   if (Cfg->traceFlags & TRACE_HDRLIN)
+      {
+      // Metadata and trace on separate lines for clarity
+      hp->len = snprintf (hp->header, HDR_MAXLEN, "%.*s port %.*s%s",
+         reporter->len, reporter->ptr, port->len, port->ptr,
+         rf ? (rf == 't' ? " (RF)" : " (Non-RF)") : "");
+
+      if (dir) hp->len += snprintf (hp->header + hp->len,
+         HDR_MAXLEN - hp->len, " %.*s", dirn->len, dirn->ptr);
+
+      hp->len += snprintf (hp->header + hp->len, HDR_MAXLEN - hp->len,
+         ":\n  ");
+      }
+
+   else // Metadata and trace on one messy line
+      hp->len = snprintf (hp->header, HDR_MAXLEN, "%.*s(%.*s)%c ",
+         reporter->len, reporter->ptr, port->len, port->ptr,
+         dir ? toupper (dir) : ' ');
+
+   return (hp);
+   }
+
+// Get the "HH:MM:SS " timestamp for a time, rendering it if it's new
+static const char *hdr_stamp (time_t t)
+   {
+   struct tm   tm;
+
+   if (t != StampTime)
+      {
+      gmtime_r (&t, &tm);
+      snprintf (Stamp, sizeof (Stamp), "%02d:%02d:%02d ",
+         tm.tm_hour, tm.tm_min, tm.tm_sec);
+      StampTime = t;
+      }
+
+   return (Stamp);
+   }
+
+/**********************************************************************/
+/* Purpose:    Process a serialised JSON object.
+ * Called by:  dispatch_json() or pipe_worker().
+ * Arguments:  Pointer to string containing serialised JSON object,
+ *             or NULL if the object was too big to be framed, length
+ *             of the serialised object.
+ * Actions:    Tokenizes the JSON string, applies the filter plan,
+ *             extracts values from it, sets trace colours, traces AX25
+ *             layer2 frame and optionally into the layers above.
+ * Affects:    stdout only.
+ * Returns:    None
+ * Created:    24/10/2025 by Paula Dowie G8PZT.
+ * Modified:   14/10/2026 to tokenize the object once, to dispatch
+ *             from the Protocols table, to drop duplicates, to archive
+ *             the JSON, to count statistics, to count parse errors
+ *             for the metrics, to update the route table, to track
+ *             circuits and links, for structured output, to pick up
+ *             reloaded filters, and to time the stages for "-b" and
+ *             the profile, and to format from views of the fields, and
+ *             to empty the span arena first, and to decode the strings
+ *             shown, and to output the trace header from a per-thread
+ *             cache, and to note the lag and drops for "-Q", and to
+ *             skip records outside the time range. */
+/**********************************************************************/
+
+static void process_json (const char *text, int len)
+   {
+   JSTR     v, reporter, portnum, src, dst, l2type;
+   JSTR     dirn = { "", 0 }, isRF = { "", 0 }, ptcl = { "", 0 };
+   JSONOBJ  object, *json = &object;
+   TRACEREC rec;
+   const HDRENTRY *hp;
+   uint64_t start = 0;
+   int      n, rf;
+
+   Cfg = config_get ();    // Used for the whole record
+
+   if (text == NULL)
+      {
+      METRIC_INC (errors [M_ERR_OVERSIZE]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         {
+         out_screen ("[oversize object discarded]\n");
+         out_endRecord ();
+         }
+      return;
+      }
+
+   PROF_MARK (P_EXTRACT);
+   if (Timing) start = metric_now ();
+   json_reset (len);
+   json_index (json, text, len);
+   if (Timing) start = metric_stage (&Metric->extractNs, start);
+
+   if (!json_getStr (json, "@type", &v, 80))
+      {
+      METRIC_INC (errors [M_ERR_TYPE]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         {
+         out_screen ("[missing '@type']\n");
+         out_endRecord ();
+         }
+      return;
+      }
+
+   PROF_KEY (0, &v);
+
+   /// TODO: Test for and process other report types here if desired
+   if (!json_strIs (&v, "L2Trace")) return;
+
+   if (QueueSlots) queue_lag (json);
+
+   if (Ranged && !range_wanted (json)) return;
+
+   // Throw away unwanted frames before extracting anything else
+   PROF_MARK (P_FILTER);
+   memset (&rec, 0, sizeof (rec));
+   n = filter_apply (json, &rec);
+   if (Timing) metric_stage (&Metric->filterNs, start);
+   if (n == 0) return;
+
+   PROF_MARK (P_FORMAT);
+
+   // Drop copies of frames already reported by other nodes
+   if (DedupWindow)
+      {
+      uint64_t hash = dedup_hash (json);
+      long     t;
+
+      if (json_getStr (json, "time", &v, 20)) t = json_strLong (&v);
+      else t = time (NULL);
+      rec_call (json, &rec, RC_REPORTER);
+
+      // Pipeline workers leave the check to the writer (see above)
+      if (Out != &MainOut)
+         {
+         Out->dupHash = hash;
+         Out->dupTime = t;
+         Out->dupReporter = rec.id [RC_REPORTER];
+         }
+
+      else if (dedup_check (hash, t, rec.id [RC_REPORTER])) return;
+      }
+
+   // In statistics and tracking modes, frames are only counted
+   if (StatSecs >= 0 || RouteSecs >= 0 || CctTimeout >= 0
+   || LinkSecs >= 0)
+      {
+      if (StatSecs >= 0) stat_count (json, &rec);
+      if (RouteSecs >= 0) route_count (json);
+      if (CctTimeout >= 0) cct_count (json);
+      if (LinkSecs >= 0) link_count (json);
+      return;
+      }
+
+   // Extract some mandatory fields
+   if (!json_getText (json, "reportFrom", &reporter, 15)
+   || !json_getText (json, "port", &portnum, 15)
+   || !json_getText (json, "srce", &src, 15)
+   || !json_getText (json, "dest", &dst, 15)
+   || !json_getText (json, "l2Type", &l2type, 7))
+      {
+      METRIC_INC (errors [M_ERR_MANDATORY]);
+      if (Cfg->traceFlags & TRACE_WARNINGS)
+         {
+         out_screen ("[Mandatory field missing]\n");
+         out_endRecord ();
+         }
+      return;
+      }
+
+   // Extract some of the optional values.
+   json_getText (json, "dirn", &dirn, 4);
+   json_getText (json, "isRF", &isRF, 4);
+   json_getText (json, "ptcl", &ptcl, 7);
+   rf = isRF.len ? *isRF.ptr : 0;
+   PROF_KEY (1, &ptcl);
+
+   // Archive it, one object per line, if wanted
+   if (*JsonLog.name)
+      {
+      out_append (&Out->json, "{", 1);
+      out_append (&Out->json, text, len);
+      out_append (&Out->json, "}\n", 2);
+      }
+
+   // Structured output replaces the trace formatting altogether
+   if (OutFormat != OUTF_TEXT)
+      {
+      emit_record (json);
+      out_endRecord ();
+      return;
+      }
+
+   hp = hdr_find (&reporter, &portnum, &dirn, rf);
+
+   if (Cfg->traceFlags & TRACE_COLOR)
+      {
+      /* Sending colour information to capture file allows it to be
+       * played back in colour but makes it difficult to read with a
+       * text editor. Therefore it is turned off by default.
+       * */
+      if (Cfg->traceFlags & TRACE_COLOR2FILE)
+         uwrite (hp->colour, strlen (hp->colour));
+      else out_screen (hp->colour);
+      }
+
+   // If raw JSON wanted, print it before the trace (defaults off)
+   if (Cfg->traceFlags & TRACE_JSON) uprintf ("%.*s\n", len, text);
+
+   // Print a blank line between traces (dedaults on)
+   if (Cfg->traceFlags & TRACE_LBRK) uprintf ("\n");
+
+   if (QueueSlots) queue_notice ();
+
+   // If timestamp is wanted (defaults on)
+   if (Cfg->traceFlags & TRACE_STAMP)
+      {
+      time_t      t;
+
+      if (json_getStr (json, "time", &v, 20)) t = json_strLong (&v);
+      else t = time (NULL);
+
+      uwrite (hdr_stamp (t), 9);
+      }
+
+   uwrite (hp->header, hp->len);
+
+// Display L2 source, destination and type
+   uprintf ("%.*s>%.*s <%.*s", src.len, src.ptr, dst.len, dst.ptr,
+      l2type.len, l2type.ptr);
+
+   // The format of these varies with frame type...
+   if (json_getText (json, "cr", &v, 2))
+      uprintf (" %.*s", v.len, v.ptr);
+
+   if (json_getText (json, "pf", &v, 2))
+      uprintf (" %.*s", v.len, v.ptr);
+
+   if (json_getText (json, "rseq", &v, 3))
+      uprintf (" R%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "tseq", &v, 3))
+      uprintf (" S%.*s", v.len, v.ptr);
+
+   uprintf (">");
+
+   // Display info field length and pid if present
+   if (json_getText (json, "ilen", &v, 10))
+      uprintf (" ilen=%.*s", v.len, v.ptr);
+
+   if (json_getText (json, "pid", &v, 10))
+      uprintf (" pid=%.*s", v.len, v.ptr);
+
+   if (ptcl.len) uprintf (" %.*s", ptcl.len, ptcl.ptr);
+
+   // Decode some payloads, according to the Protocols table
+   if (ptcl.len && (n = mnem_find (&Protocols, ptcl.ptr, ptcl.len)) >= 0
+   && Protocols.row [n].trace)
+      Protocols.row [n].trace (json);
+
+   uprintf ("\n");
+
+   out_endRecord ();
+   }
+
+//######################################################################
+//                         BINARY CAPTURE FUNCTIONS
+//######################################################################
+
+/* With "-B <file>" every record received is also saved in a compact
+ * binary capture file, which can be replayed later with "-I <file>"
+ * using different filters and display options.  Replaying it gives
+ * exactly the same traces as decoding the original input.
+ *
+ * The file is a header followed by a series of blocks, each holding up
+ * to CAP_BLOCKSIZE bytes of records, and ends with an index of the
+ * blocks.  Each block header records the time range of its records,
+ * and Bloom filters of the reporters and L2 callsigns, and a mask of
+ * the L2 frame types it contains.  When replaying, a block which can't
+ * contain anything wanted by the "-r", "-f", "-t", "-a" or "-T" filters
+ * is skipped without looking at its records at all.
+ *
+ * Each record is stored as a series of tokens, from which its original
+ * text is rebuilt exactly.  Short strings, i.e. the field names,
+ * callsigns and mnemonics, are held in a dictionary for the block, so
+ * each is stored only the first time it appears in the block, and
+ * numbers are stored as varints rather than text.
+ *
+ * All numbers are little-endian.
+ *
+ *    File header:   "PNMPCAP\1"
+ *
+ *    Block header:  "BLK\1", record count (4), payload bytes (4),
+ *                   reserved (4), min time (8), max time (8), base
+ *                   time (8), reporter Bloom filter (32), callsign
+ *                   Bloom filter (32), frame type mask (8)
+ *
+ *    Record:        zigzag varint time - base time, then the tokens
+ *                   of the object without its outer braces, then 0
+ *
+ *    Token:         varint (n << 2 | kind), where kind is
+ *                   0:  n bytes of text follow
+ *                   1:  the quoted string numbered n in the dictionary
+ *                   2:  a quoted string of n bytes follows, which is
+ *                       added to the dictionary, if there's room
+ *                   3:  the decimal number n
+ *
+ *    Index:         for each block, its offset (8) and a copy of its
+ *                   header (112)
+ *
+ *    Trailer:       "PNMPIDX\1", offset of index (8), number of
+ *                   blocks (4), reserved (4)
+ *
+ * If the program is killed before it can write the index, the blocks
+ * already written can still be replayed, by following the headers.
+ * */
+#define  CAP_BLOCKSIZE  65536    // Records per block, in bytes
+#define  CAP_BLOCKSECS  10       // Or when the block is this old
+#define  CAP_HDRSIZE    112      // Size of block header
+#define  CAP_IDXSIZE    (8 + CAP_HDRSIZE)  // Size of index entry
+#define  CAP_TRLSIZE    24       // Size of trailer
+#define  CAP_MAGIC      "PNMPCAP\1"
+#define  CAP_BLKMAGIC   "BLK\1"
+#define  CAP_IDXMAGIC   "PNMPIDX\1"
+#define  CAP_STRMAX     32       // Longest string put in dictionary
+#define  CAP_DICTMAX    4096     // Max dictionary strings per block
+#define  CAP_DICTSLOTS  8192     // Power of 2, at least 2x CAP_DICTMAX
+
+#define  CAP_LITERAL    0        // Token kinds
+#define  CAP_STRREF     1
+#define  CAP_STRNEW     2
+#define  CAP_NUMBER     3
+
+typedef struct
+   {
+   unsigned    count;            // Number of records in block
+   unsigned    bytes;            // Length of records in block
+   long long   tmin;             // Earliest record time
+   long long   tmax;             // Latest record time
+   long long   tbase;            // Record times are relative to this
+   uint64_t    reporters [4];    // Bloom filter of "reportFrom"
+   uint64_t    calls [4];        // Bloom filter of "srce" and "dest"
+   uint64_t    types;            // Bit "code" set for each L2Types
+   } CAPBLOCK;
+
+typedef struct
+   {
+   unsigned    block;            // Block number it is in, plus 1
+   unsigned    id;               // Its number in the dictionary
+   int         off;              // Offset of string in CapData
+   int         len;              // Length of string
+   } CAPSTRING;
+
+typedef struct
+   {
+   const char  *str;             // String, in the mapped file
+   int         len;              // Length of string
+   } CAPREF;
+
+static char          BinaryFile [256];   // Binary capture file name
+static FILE          *FpBinary = NULL;   // Binary capture file
+static CAPBLOCK      CapBlock;           // The block being filled
+static OUTBUF        CapData;            // Its records
+static time_t        CapStarted;         // When it was started
+static long long     CapOffset = 0;      // Where it will be written
+static OUTBUF        CapIndex;           // The index, so far
+static unsigned      CapBlocks = 0;      // Blocks written
+static unsigned long CapRead = 0;        // Blocks replayed
+static unsigned long CapSkipped = 0;     // Blocks skipped by filters
+static CAPSTRING     CapDict [CAP_DICTSLOTS];  // Writer's dictionary
+static unsigned      CapStrings = 0;     // Strings in it, this block
+static CAPREF        CapRef [CAP_DICTMAX];     // Reader's dictionary
+static unsigned      CapRefs = 0;        // Strings in it, this block
+static OUTBUF        CapText;            // Record being replayed
+
+// Store little-endian numbers
+static void cap_put32 (unsigned char *cp, uint32_t n)
+   {
+   int   i;
+
+   for (i = 0; i < 4; i++, n >>= 8) cp [i] = n & 0xff;
+   }
+
+static void cap_put64 (unsigned char *cp, uint64_t n)
+   {
+   int   i;
+
+   for (i = 0; i < 8; i++, n >>= 8) cp [i] = n & 0xff;
+   }
+
+// Append a varint, and return its length
+static int cap_putVarint (unsigned char *cp, uint64_t n)
+   {
+   int   i = 0;
+
+   for (; n >= 0x80; n >>= 7) cp [i++] = (n & 0x7f) | 0x80;
+   cp [i++] = n;
+   return (i);
+   }
+
+// Append a token to the current block
+static void cap_token (int kind, uint64_t n)
+   {
+   unsigned char  tmp [10];
+
+   int            len = cap_putVarint (tmp, n << 2 | kind);
+
+   out_append (&CapData, (char *) tmp, len);
+   }
+
+// Append any text between the last token and this one
+static void cap_literal (const char *from, const char *to)
+   {
+   if (to == from) return;
+
+   cap_token (CAP_LITERAL, to - from);
+   out_append (&CapData, from, to - from);
+   }
+
+// Set the two bits of a 256 bit Bloom filter for a callsign
+static void cap_bloomSet (uint64_t *bloom, const char *call, int len)
+   {
+   char     norm [CALL_MAXLEN];
+   unsigned h;
+
+   if ((len = call_normalise (call, len, norm)) < 0) return;
+
+   h = json_hash (norm, len);
+   bloom [(h >> 6) & 3] |= (uint64_t) 1 << (h & 63);
+   bloom [(h >> 14) & 3] |= (uint64_t) 1 << ((h >> 8) & 63);
+   }
+
+/**********************************************************************/
+/* Purpose:    Encode a block header
+ * Called by:  cap_flushBlock()
+ * Arguments:  Pointer to block, buffer of CAP_HDRSIZE bytes.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cap_putHeader (const CAPBLOCK *bp, unsigned char *cp)
+   {
+   int   i;
+
+   memcpy (cp, CAP_BLKMAGIC, 4);
+   cap_put32 (cp + 4, bp->count);
+   cap_put32 (cp + 8, bp->bytes);
+   cap_put32 (cp + 12, 0);
+   cap_put64 (cp + 16, bp->tmin);
+   cap_put64 (cp + 24, bp->tmax);
+   cap_put64 (cp + 32, bp->tbase);
+
+   for (i = 0; i < 4; i++)
+      {
+      cap_put64 (cp + 40 + 8 * i, bp->reporters [i]);
+      cap_put64 (cp + 72 + 8 * i, bp->calls [i]);
+      }
+
+   cap_put64 (cp + 104, bp->types);
+   }
+
+/**********************************************************************/
+/* Purpose:    Write the current block to the binary capture file
+ * Called by:  cap_record() when the block is full or old, and
+ *             cap_close().
+ * Actions:    Writes the header and records, adds the block to the
+ *             index, and starts a new block.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cap_flushBlock (void)
+   {
+   unsigned char  entry [CAP_IDXSIZE];
+
+   if (CapBlock.count == 0) return;
+
+   CapBlock.bytes = CapData.len;
+
+   cap_put64 (entry, CapOffset);
+   cap_putHeader (&CapBlock, entry + 8);
+   out_append (&CapIndex, (char *) entry, CAP_IDXSIZE);
+
+   fwrite (entry + 8, 1, CAP_HDRSIZE, FpBinary);
+   fwrite (CapData.buf, 1, CapData.len, FpBinary);
+   fflush (FpBinary);
+
+   CapOffset += CAP_HDRSIZE + CapData.len;
+   CapBlocks++;      // Which also empties the dictionary
+
+   memset (&CapBlock, 0, sizeof (CapBlock));
+   CapData.len = 0;
+   CapStrings = 0;
+   }
+
+/**********************************************************************/
+/* Purpose:    Open the binary capture file
+ * Called by:  main() if the "-B" option is used
+ * Arguments:  File name
+ * Returns:    0 if successful, else -1
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int cap_open (const char *path)
+   {
+   if ((FpBinary = fopen (path, "wb")) == NULL) return (-1);
+
+   fwrite (CAP_MAGIC, 1, 8, FpBinary);
+   CapOffset = 8;
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Append a quoted string to the current block
+ * Called by:  cap_encode()
+ * Arguments:  Pointer to string (without its quotes), its length.
+ * Actions:    If the string is already in the block's dictionary, adds
+ *             a reference to it, otherwise adds the string, and puts it
+ *             in the dictionary if there's room.
+ * Affects:    CapDict, CapStrings
+ * Notes:      The dictionary holds offsets rather than pointers, as
+ *             CapData may be moved when it grows.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cap_string (const char *str, int len)
+   {
+   CAPSTRING   *sp;
+   unsigned    i;
+
+   for (i = json_hash (str, len) & (CAP_DICTSLOTS-1);
+      (sp = &CapDict [i])->block == CapBlocks + 1;
+      i = (i+1) & (CAP_DICTSLOTS-1))
+      {
+      if (sp->len == len
+      && memcmp (CapData.buf + sp->off, str, len) == 0)
+         {
+         cap_token (CAP_STRREF, sp->id);
+         return;
+         }
+      }
+
+   cap_token (CAP_STRNEW, len);
+
+   if (CapStrings < CAP_DICTMAX)
+      {
+      sp->block = CapBlocks + 1;
+      sp->id = CapStrings++;
+      sp->off = CapData.len;
+      sp->len = len;
+      }
+
+   out_append (&CapData, str, len);
+   }
+
+/**********************************************************************/
+/* Purpose:    Append the tokens of a record to the current block
+ * Called by:  cap_record()
+ * Arguments:  Pointer to serialised object, its length.
+ * Actions:    Splits the record into short strings, which go through
+ *             the dictionary, decimal numbers, and the text between
+ *             them, then adds the end marker.
+ * Notes:      Only numbers which will be rebuilt exactly are stored as
+ *             numbers, i.e. no leading zeroes and at most 18 digits.
+ *             Long strings, and those with escapes, are left as text.
+ *             Whatever the input, its text is rebuilt exactly.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cap_encode (const char *text, int len)
+   {
+   const char  *cp = text, *lit = text, *end = text + len, *sp;
+   uint64_t    n;
+
+   while (cp < end)
+      {
+      if (*cp == '"')
+         {
+         for (sp = cp + 1; sp < end && sp - cp <= CAP_STRMAX
+            && *sp != '"' && *sp != '\\'; sp++);
+
+         if (sp < end && *sp == '"')
+            {
+            cap_literal (lit, cp);
+            cap_string (cp + 1, sp - cp - 1);
+            cp = lit = sp + 1;
+            }
+
+         else if ((cp = json_skipString (cp + 1, end)) < end) cp++;
+         }
+
+      else if (isdigit ((unsigned char) *cp))
+         {
+         for (sp = cp, n = 0; sp < end && sp - cp < 18
+            && isdigit ((unsigned char) *sp); sp++)
+            n = n * 10 + *sp - '0';
+
+         if ((sp == end || !isdigit ((unsigned char) *sp))
+         && (sp - cp == 1 || *cp != '0'))
+            {
+            cap_literal (lit, cp);
+            cap_token (CAP_NUMBER, n);
+            lit = sp;
+            }
+
+         while (sp < end && isdigit ((unsigned char) *sp)) sp++;
+         cp = sp;
+         }
+
+      else cp++;
+      }
+
+   cap_literal (lit, end);
+   cap_token (CAP_LITERAL, 0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Save a record in the binary capture file
+ * Called by:  dispatch_json(), for every record received, in order.
+ * Arguments:  Pointer to serialised object (without its outer braces),
+ *             its length.
+ * Actions:    Tokenizes the record to find the fields for the block
+ *             header, then appends its tokens to the current block,
+ *             writing the block out if it is full, or has been open
+ *             for more than CAP_BLOCKSECS seconds.
+ * Affects:    CapBlock and CapData
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to read numbers without going past the
+ *             field, and to empty the span arena first. */
+/**********************************************************************/
+
+static void cap_record (const char *text, int len)
+   {
+   unsigned char  hdr [10];
+   const JFIELD   *f;
+   JSONOBJ        json;
+   long long      t;
+   int            n;
+
+   json_reset (len);
+   json_index (&json, text, len);
+
+   if ((t = json_getLong (&json, "time", -1)) < 0) t = time (NULL);
+
+   if (CapBlock.count++ == 0)
+      {
+      CapBlock.tmin = CapBlock.tmax = CapBlock.tbase = t;
+      CapStarted = time (NULL);
+      }
+
+   if (t < CapBlock.tmin) CapBlock.tmin = t;
+   if (t > CapBlock.tmax) CapBlock.tmax = t;
+
+   if ((f = json_findField (&json, "reportFrom")) != NULL)
+      cap_bloomSet (CapBlock.reporters, text + f->valOff, f->valLen);
+
+   if ((f = json_findField (&json, "srce")) != NULL)
+      cap_bloomSet (CapBlock.calls, text + f->valOff, f->valLen);
+
+   if ((f = json_findField (&json, "dest")) != NULL)
+      cap_bloomSet (CapBlock.calls, text + f->valOff, f->valLen);
+
+   // Bit 0 is for other types, and for anything which isn't a trace
+   if ((n = mnem_field (&json, "l2Type", &L2Types)) >= 0)
+      CapBlock.types |= (uint64_t) 1 << L2Types.row [n].code;
+   else CapBlock.types |= 1;
+
+   if (json_findField (&json, "@type") == NULL) CapBlock.types |= 1;
+
+   // Zigzag encoding of the time, as it may be before the base time
+   t -= CapBlock.tbase;
+   n = cap_putVarint (hdr, ((uint64_t) t << 1) ^ (uint64_t) (t >> 63));
+   out_append (&CapData, (char *) hdr, n);
+
+   cap_encode (text, len);
+
+   if (CapData.len >= CAP_BLOCKSIZE
+   || time (NULL) - CapStarted >= CAP_BLOCKSECS)
+      cap_flushBlock ();
+   }
+
+/**********************************************************************/
+/* Purpose:    Finish and close the binary capture file
+ * Called by:  main() on exit
+ * Actions:    Writes the last block, the index and the trailer.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cap_close (void)
+   {
+   unsigned char  trailer [CAP_TRLSIZE];
+
+   if (FpBinary == NULL) return;
+
+   cap_flushBlock ();
+
+   fwrite (CapIndex.buf, 1, CapIndex.len, FpBinary);
+
+   memcpy (trailer, CAP_IDXMAGIC, 8);
+   cap_put64 (trailer + 8, CapOffset);
+   cap_put32 (trailer + 16, CapBlocks);
+   cap_put32 (trailer + 20, 0);
+   fwrite (trailer, 1, CAP_TRLSIZE, FpBinary);
+
+   fclose (FpBinary);
+   FpBinary = NULL;
+   }
+
+// Fetch little-endian numbers
+static uint32_t cap_get32 (const unsigned char *cp)
+   {
+   return (cp [0] | (cp [1] << 8) | (cp [2] << 16)
+      | ((uint32_t) cp [3] << 24));
+   }
+
+static uint64_t cap_get64 (const unsigned char *cp)
+   {
+   return (cap_get32 (cp) | ((uint64_t) cap_get32 (cp + 4) << 32));
+   }
+
+// Fetch a varint, returning its length, or 0 if it's corrupt
+static int cap_getVarint (const unsigned char *cp,
+   const unsigned char *end, uint64_t *n)
+   {
+   int   i;
+
+   for (*n = 0, i = 0; cp + i < end && i < 10; i++)
+      {
+      *n |= (uint64_t) (cp [i] & 0x7f) << (7 * i);
+      if ((cp [i] & 0x80) == 0) return (i + 1);
+      }
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Decode a block header
+ * Called by:  cap_replay()
+ * Arguments:  Pointer to header, pointer to block to receive it.
+ * Returns:    0 if successful, else -1 if it isn't a block header.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int cap_getHeader (const unsigned char *cp, CAPBLOCK *bp)
+   {
+   int   i;
+
+   if (memcmp (cp, CAP_BLKMAGIC, 4) != 0) return (-1);
+
+   bp->count = cap_get32 (cp + 4);
+   bp->bytes = cap_get32 (cp + 8);
+   bp->tmin = cap_get64 (cp + 16);
+   bp->tmax = cap_get64 (cp + 24);
+   bp->tbase = cap_get64 (cp + 32);
+
+   for (i = 0; i < 4; i++)
+      {
+      bp->reporters [i] = cap_get64 (cp + 40 + 8 * i);
+      bp->calls [i] = cap_get64 (cp + 72 + 8 * i);
+      }
+
+   bp->types = cap_get64 (cp + 104);
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Rebuild the text of a record from its tokens
+ * Called by:  cap_replay()
+ * Arguments:  Pointer to first token, pointer to end of block.
+ * Actions:    Decodes the tokens into CapText, up to the end marker.
+ * Affects:    CapText, CapRef and CapRefs
+ * Returns:    Pointer to the next record, or NULL if the block is
+ *             corrupt.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static const unsigned char *cap_decode (const unsigned char *cp,
+   const unsigned char *end)
+   {
+   char     num [24];
+   uint64_t v;
+   int      n;
+
+   out_reserve (&CapText, 1);    // So an empty record isn't NULL
+   CapText.len = 0;
+
+   for (;;)
+      {
+      if ((n = cap_getVarint (cp, end, &v)) == 0) return (NULL);
+      cp += n;
+
+      switch (v & 3)
+         {
+         case CAP_STRREF:
+            if ((v >>= 2) >= CapRefs) return (NULL);
+            out_append (&CapText, "\"", 1);
+            out_append (&CapText, CapRef [v].str, CapRef [v].len);
+            out_append (&CapText, "\"", 1);
+            break;
+
+         case CAP_NUMBER:
+            n = sprintf (num, "%llu", (unsigned long long) (v >> 2));
+            out_append (&CapText, num, n);
+            break;
+
+         case CAP_STRNEW:
+            if ((v >> 2) > (uint64_t) (end - cp)) return (NULL);
+            if (CapRefs < CAP_DICTMAX)
+               {
+               CapRef [CapRefs].str = (const char *) cp;
+               CapRef [CapRefs++].len = v >> 2;
+               }
+            out_append (&CapText, "\"", 1);
+            out_append (&CapText, (const char *) cp, v >> 2);
+            out_append (&CapText, "\"", 1);
+            cp += v >> 2;
+            break;
+
+         default:
+            if (v == 0) return (cp);        // End of record
+            if ((v >> 2) > (uint64_t) (end - cp)) return (NULL);
+            out_append (&CapText, (const char *) cp, v >> 2);
+            cp += v >> 2;
+            break;
+         }
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    See whether a Bloom filter may hold any of a set
+ * Called by:  cap_wanted()
+ * Arguments:  Pointer to callsign set, pointer to Bloom filter
+ * Returns:    1 if any callsign in the set may be in the filter, or if
+ *             the set has wildcards, else 0.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int cap_bloomAny (const CALLSET *set, const uint64_t *bloom)
+   {
+   unsigned h;
+   int      i;
+
+   if (set->trie) return (1);
+
+   for (i = 0; i < set->size; i++)
+      {
+      if (set->slot [i][0] == 0) continue;
+
+      h = json_hash (set->slot [i], strlen (set->slot [i]));
+
+      if ((bloom [(h >> 6) & 3] & ((uint64_t) 1 << (h & 63)))
+      && (bloom [(h >> 14) & 3] & ((uint64_t) 1 << ((h >> 8) & 63))))
+         return (1);
+      }
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Report how many capture blocks were skipped
+ * Called by:  main() on exit
+ * Actions:    Prints the counts to stderr, if a capture was replayed
+ *             and any blocks were skipped.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void cap_report (void)
+   {
+   if (CapSkipped == 0) return;
+
+   fprintf (stderr, "Capture blocks read: %lu, skipped: %lu\n",
+      CapRead, CapSkipped);
+   }
+
+/**********************************************************************/
+/* Purpose:    Decide whether a block may hold any wanted frames
+ * Called by:  cap_replay()
+ * Arguments:  Pointer to decoded block header
+ * Returns:    1 if it may, 0 if the filters would reject every record
+ *             in it.
+ * Notes:      A Bloom filter match may be false, in which case the
+ *             records are rejected by the filters as usual.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to skip blocks outside the time range, and
+ *             to keep the other types if "-T" names any. */
+/**********************************************************************/
+
+static int cap_wanted (const CAPBLOCK *bp)
+   {
+   uint64_t need = 0;
+   long     from, to;
+   int      n;
+
+   if (Ranged)
+      {
+      range_get (bp->tmin, &from, &to);
+      if (bp->tmax < from || bp->tmin >= to) return (0);
+      }
+
+   // Keep anything which might give a warning
+   if ((Cfg->traceFlags & TRACE_WARNINGS) && (bp->types & 1))
+      return (1);
+
+   if (Cfg->reportFilter.count
+   && !cap_bloomAny (&Cfg->reportFilter, bp->reporters)) return (0);
+
+   if (Cfg->srcFilter.count
+   && !cap_bloomAny (&Cfg->srcFilter, bp->calls)) return (0);
+
+   if (Cfg->dstFilter.count
+   && !cap_bloomAny (&Cfg->dstFilter, bp->calls)) return (0);
+
+   if (Cfg->allFilter.count
+   && !cap_bloomAny (&Cfg->allFilter, bp->calls)) return (0);
+
+   if (Cfg->typeFilter.count)
+      {
+      for (n = 0; n < L2Types.count; n++)
+         {
+         if ((Cfg->typeMask >> n) & 1)
+            need |= (uint64_t) 1 << L2Types.row [n].code;
+         }
+
+      if (Cfg->typeOther) need |= 1;   // Not in the table
+      if ((bp->types & need) == 0) return (0);
+      }
+
+   if ((Cfg->traceFlags & TRACE_UI) == 0
+   && bp->types == (uint64_t) 1 << L2_UI) return (0);
+
+   return (1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Process a record, timing it for the metrics
+ * Called by:  dispatch_json() and pipe_worker()
+ * Arguments:  As process_json()
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to time it for "-b" too, and for the
+ *             profile. */
+/**********************************************************************/
+
+static void metric_process (const char *text, int len)
+   {
+   uint64_t start = 0;
+
+   PROF_BEGIN ();
+   if (Timing) start = metric_now ();
+
+   process_json (text, len);
+
+   if (Timing) metric_observe (&Metric->decode, start);
+   PROF_END ();
+   }
+
+//######################################################################
+//                       DECODE PIPELINE FUNCTIONS
+//######################################################################
+
+/* With "-m <n>", n > 1, decoding is spread over a pipeline:
+ *
+ *    reader (main thread) -> n decode workers -> writer thread
+ *
+ * The reader frames objects as before, but copies each one into the
+ * next free slot of a ring, tagged with its sequence number.  Workers
+ * take slots in turn and run process_json() with their output directed
+ * into the slot's own buffers.  The writer emits the slots strictly in
+ * sequence order, so the output is identical to the single-threaded
+ * case, whichever worker finishes first.  The slot buffers are reused,
+ * so there is no per-record heap churn once they have grown.
+ *
+ * With "-Q", the input queue thread stands between the reader and the
+ * decoding, single-threaded or not (see INPUT QUEUE FUNCTIONS).
+ * */
+#define  PIPE_SLOTS     256      // Records in flight, power of 2
+#define  MAX_THREADS    64       // Maximum decode workers
+
+#define  SLOT_FREE      0        // Available to the reader
+#define  SLOT_READY     1        // Holds a record awaiting a worker
+#define  SLOT_BUSY      2        // Being decoded
+#define  SLOT_DONE      3        // Decoded, awaiting the writer
+
+typedef struct
+   {
+   char     *json;               // Copy of the serialised object
+   int      len;                 // Length of object
+   int      size;                // Allocated size of "json"
+   int      null;                // Object was too big to frame
+   int      state;               // SLOT_xxx
+   OUTPUT   out;                 // Decoded trace
+   } PIPESLOT;
+
+static int              Threads = 1;   // Number of decode workers
+static PIPESLOT         PipeSlot [PIPE_SLOTS];
+static unsigned long    PipeHead;   // Sequence number of next to fill
+static unsigned long    PipeNext;   // Next to be taken by a worker
+static unsigned long    PipeTail;   // Next to be written
+static int              PipeEnd;    // No more input
+static pthread_mutex_t  PipeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   PipeWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   PipeDone = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   PipeFree = PTHREAD_COND_INITIALIZER;
+static pthread_t        PipeWorker [MAX_THREADS];
+static pthread_t        PipeWriterThread;
+
+/**********************************************************************/
+/* Purpose:    Decode pipeline worker thread
+ * Called by:  Started by pipe_start()
+ * Arguments:  Unused.
+ * Actions:    Loops, taking the next record from the ring, decoding it
+ *             into the slot's output buffers, then passing the slot to
+ *             the writer.  Exits when the input has ended and there
+ *             is nothing left to take.
+ * Returns:    NULL
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to count into its own METRICS block, and
+ *             to free its span arena. */
+/**********************************************************************/
+
+static void *pipe_worker (void *arg)
+   {
+   PIPESLOT *sp;
+
+   Metric = &MetricSlot [1 + (intptr_t) arg];
+
+   pthread_mutex_lock (&PipeLock);
+
+   while (1)
+      {
+      while (PipeNext == PipeHead && !PipeEnd)
+         pthread_cond_wait (&PipeWork, &PipeLock);
+
+      if (PipeNext == PipeHead) break;  // Input ended
+
+      sp = &PipeSlot [PipeNext++ & (PIPE_SLOTS-1)];
+      sp->state = SLOT_BUSY;
+
+      pthread_mutex_unlock (&PipeLock);
+
+      Out = &sp->out;
+      metric_process (sp->null ? NULL : sp->json, sp->len);
+
+      pthread_mutex_lock (&PipeLock);
+
+      sp->state = SLOT_DONE;
+      pthread_cond_signal (&PipeDone);
+      }
+
+   pthread_mutex_unlock (&PipeLock);
+
+   json_free ();
+
+   return (NULL);
+   }
+
+/**********************************************************************/
+/* Purpose:    Decode pipeline writer thread
+ * Called by:  Started by pipe_start()
+ * Arguments:  Unused.
+ * Actions:    Waits for the oldest record in the ring to be decoded,
+ *             then, unless it is a duplicate, appends its output to the
+ *             main output buffers and applies the flush policy, before
+ *             freeing the slot.
+ *             Exits when the input has ended and every record has
+ *             been written.
+ * Returns:    NULL
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to pass on the JSON archive output, to
+ *             count into its own METRICS block, and to mark where each
+ *             trace ends. */
+/**********************************************************************/
+
+static void *pipe_writer (void *arg)
+   {
+   PIPESLOT *sp;
+
+   Metric = &MetricSlot [M_SLOTS - 1];
+
+   pthread_mutex_lock (&PipeLock);
+
+   while (1)
+      {
+      sp = &PipeSlot [PipeTail & (PIPE_SLOTS-1)];
+
+      while (!(PipeTail != PipeHead && sp->state == SLOT_DONE))
+         {
+         if (PipeEnd && PipeTail == PipeHead) break;
+         pthread_cond_wait (&PipeDone, &PipeLock);
+         }
+
+      if (PipeTail == PipeHead) break; // Input ended, all written
+
+      pthread_mutex_unlock (&PipeLock);
+
+      // Duplicates are detected here, in input order
+      if (sp->out.dupHash && dedup_check (sp->out.dupHash,
+         sp->out.dupTime, sp->out.dupReporter))
+         {
+         sp->out.records = 0;
+         }
+
+      else
+         {
+         out_append (&MainOut.screen, sp->out.screen.buf,
+            sp->out.screen.len);
+         out_append (&MainOut.file, sp->out.file.buf,
+            sp->out.file.len);
+         out_append (&MainOut.json, sp->out.json.buf,
+            sp->out.json.len);
+         MainOut.records += sp->out.records;
+         }
+
+      if (sp->out.records)
+         {
+         out_mark ();
+         out_policy ();
+         }
+
+      sp->out.screen.len = sp->out.file.len = sp->out.json.len = 0;
+      sp->out.records = 0;
+      sp->out.dupHash = 0;
+
+      pthread_mutex_lock (&PipeLock);
+
+      sp->state = SLOT_FREE;
+      PipeTail++;
+      pthread_cond_signal (&PipeFree);
+      }
+
+   pthread_mutex_unlock (&PipeLock);
+
+   return (NULL);
+   }
+
+/**********************************************************************/
+/* Purpose:    Start the decode pipeline threads
+ * Called by:  main() if more than one thread was requested
+ * Returns:    0 if successful, else -1
+ * Notes:      The threads are started with SIGINT and SIGTERM blocked,
+ *             so that those signals interrupt the reader instead.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to give each worker its number. */
+/**********************************************************************/
+
+static int pipe_start (void)
+   {
+   sigset_t set, old;
+   int      i, rc = 0;
+
+   sigemptyset (&set);
+   sigaddset (&set, SIGINT);
+   sigaddset (&set, SIGTERM);
+   pthread_sigmask (SIG_BLOCK, &set, &old);
+
+   for (i = 0; i < Threads && rc == 0; i++)
+      rc = pthread_create (&PipeWorker [i], NULL, pipe_worker,
+         (void *) (intptr_t) i);
+
+   if (rc == 0)
+      rc = pthread_create (&PipeWriterThread, NULL, pipe_writer, NULL);
+
+   pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+   return (rc ? -1 : 0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Drain and stop the decode pipeline
+ * Called by:  main() at end of input
+ * Actions:    Tells the threads there is no more input, then waits for
+ *             them to decode and write everything still in the ring.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void pipe_stop (void)
+   {
+   int   i;
+
+   pthread_mutex_lock (&PipeLock);
+   PipeEnd = 1;
+   pthread_cond_broadcast (&PipeWork);
+   pthread_cond_broadcast (&PipeDone);
+   pthread_mutex_unlock (&PipeLock);
+
+   for (i = 0; i < Threads; i++) pthread_join (PipeWorker [i], NULL);
+
+   pthread_join (PipeWriterThread, NULL);
+   }
+
+/**********************************************************************/
+/* Purpose:    Hand a framed object to the decoder
+ * Called by:  dispatch_json() and queue_thread()
+ * Arguments:  As dispatch_json()
+ * Actions:    If single-threaded, calls process_json() directly.
+ *             Otherwise waits for a free slot in the pipeline ring,
+ *             copies the object into it and wakes a worker.
+ * Returns:    None
+ * Created:    14/10/2026, from dispatch_json()
+ * Modified:   */
+/**********************************************************************/
+
+static void decode_json (const char *json, int len)
+   {
+   PIPESLOT *sp;
+
+   if (Threads <= 1)
+      {
+      metric_process (json, len);
+      return;
+      }
+
+   pthread_mutex_lock (&PipeLock);
+
+   while (PipeHead - PipeTail >= PIPE_SLOTS)
+      pthread_cond_wait (&PipeFree, &PipeLock);
+
+   pthread_mutex_unlock (&PipeLock);
+
+   // The slot is ours until it is marked ready
+   sp = &PipeSlot [PipeHead & (PIPE_SLOTS-1)];
+
+   if (len > sp->size)
+      {
+      if ((sp->json = realloc (sp->json, len)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+      sp->size = len;
+      }
+
+   if (json) memcpy (sp->json, json, len);
+   sp->len = len;
+   sp->null = (json == NULL);
+
+   pthread_mutex_lock (&PipeLock);
+   sp->state = SLOT_READY;
+   PipeHead++;
+   pthread_cond_signal (&PipeWork);
+   pthread_mutex_unlock (&PipeLock);
+   }
+
+/**********************************************************************/
+/* Purpose:    Input queue thread
+ * Called by:  Started by queue_start()
+ * Arguments:  Unused.
+ * Actions:    Loops, taking the oldest record from the input queue, and
+ *             handing it to decode_json(), which decodes it, or passes
+ *             it on to the pipeline.  Exits when the input has ended
+ *             and the queue is empty.
+ * Returns:    NULL
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void *queue_thread (void *arg)
+   {
+   QUEUEREC *qp;
+   char     *buf = NULL, *cp;
+   int      size = 0, len, null, n;
+
+   Metric = &MetricSlot [M_SLOTS - 2];
+
+   pthread_mutex_lock (&QueueLock);
+
+   while (1)
+      {
+      while (QueueTail == QueueHead && !QueueEnd)
+         pthread_cond_wait (&QueueWork, &QueueLock);
+
+      if (QueueTail == QueueHead) break;  // Input ended
+
+      // Take the record, leaving our old buffer in the slot
+      qp = &QueueRec [QueueTail++ & (QueueSlots-1)];
+      cp = qp->json, qp->json = buf, buf = cp;
+      n = qp->size, qp->size = size, size = n;
+      len = qp->len;
+      null = qp->null;
+      QueueLow -= qp->low;
+      pthread_cond_signal (&QueueFree);
+
+      pthread_mutex_unlock (&QueueLock);
+
+      decode_json (null ? NULL : buf, len);
+
+      pthread_mutex_lock (&QueueLock);
+      }
+
+   pthread_mutex_unlock (&QueueLock);
+
+   free (buf);
+   json_free ();
+
+   return (NULL);
+   }
+
+/**********************************************************************/
+/* Purpose:    Start the input queue thread
+ * Called by:  main() if "-Q" is used
+ * Returns:    0 if successful, else -1
+ * Notes:      As in pipe_start(), SIGINT and SIGTERM are blocked, so
+ *             that they interrupt the reader instead.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int queue_start (void)
+   {
+   sigset_t set, old;
+   int      rc;
+
+   if ((QueueRec = calloc (QueueSlots, sizeof (QUEUEREC))) == NULL)
+      return (-1);
+
+   sigemptyset (&set);
+   sigaddset (&set, SIGINT);
+   sigaddset (&set, SIGTERM);
+   pthread_sigmask (SIG_BLOCK, &set, &old);
+
+   rc = pthread_create (&QueueThread, NULL, queue_thread, NULL);
+
+   pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+   if (rc)
+      {
+      free (QueueRec);
+      return (-1);
+      }
+
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Drain and stop the input queue
+ * Called by:  main() at end of input, before pipe_stop()
+ * Actions:    Tells the queue thread there is no more input, waits for
+ *             it to hand on everything still queued, then frees the
+ *             queue.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void queue_stop (void)
+   {
+   int   i;
+
+   pthread_mutex_lock (&QueueLock);
+   QueueEnd = 1;
+   pthread_cond_signal (&QueueWork);
+   pthread_mutex_unlock (&QueueLock);
+
+   pthread_join (QueueThread, NULL);
+
+   for (i = 0; i < QueueSlots; i++) free (QueueRec [i].json);
+   free (QueueRec);
+   }
+
+/**********************************************************************/
+/* Purpose:    Hand a framed object on to be decoded
+ * Called by:  frame_stream() and frame_mapped()
+ * Arguments:  Pointer to serialised JSON object, length of object.
+ *             The pointer is NULL if the object was too big.
+ * Actions:    Saves the record with "-B", and counts it, then queues
+ *             it if "-Q" is used, else hands it to decode_json().
+ * Returns:    None
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to save the record with "-B" first, and
+ *             to count it and its bytes for the metrics, and to queue
+ *             it with "-Q". */
+/**********************************************************************/
+
+static void dispatch_json (const char *json, int len)
+   {
+   METRIC_INC (records);
+   METRIC_ADD (bytes, len);
+
+   if (FpBinary && json) cap_record (json, len);
+
+   if (QueueSlots) queue_put (json, len);
+   else decode_json (json, len);
+   }
+
+//######################################################################
+//                        INPUT MERGING FUNCTIONS
+//######################################################################
+
+/* When there is more than one input (see input_run()), the records
+ * from all of them are merged into roughly chronological order by
+ * their "time" fields.  Each record is copied into a bounded min-heap,
+ * keyed by time and then by arrival order, and is held for up to the
+ * "reorder window" set by "-R", to give records from slower sources a
+ * chance to overtake it.  If the heap fills up, the oldest record is
+ * released early.  With a single input the heap is bypassed entirely,
+ * and records are dispatched in place as before.
+ *
+ * Heap entries keep their buffers when released, so once the heap has
+ * filled there is no further allocation.
+ * */
+#define  MERGE_MAX      4096     // Max records held for reordering
+
+typedef struct
+   {
+   long           time;          // Record's "time" field
+   unsigned long  seq;           // Arrival order, to keep it stable
+   long long      due;           // When it must be released, in ms
+   char           *json;         // Copy of the record, or NULL
+   int            len;           // Length of record
+   int            size;          // Allocated size of "json"
+   int            null;          // Oversize object placeholder
+   } MERGEREC;
+
+static MERGEREC      MergeHeap [MERGE_MAX];
+static int           MergeCount = 0;   // Records held
+static unsigned long MergeSeq = 0;     // Arrival counter
+static int           MergeWindow = 2000;  // Reorder window, ms
+static int           Merging = 0;      // More than one input
+
+// Monotonic clock in milliseconds, for the reorder window
+static long long merge_now (void)
+   {
+   struct timespec   ts;
+
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return ((long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the value of the "time" field of a record
+ * Called by:  merge_push()
+ * Arguments:  Pointer to serialised record, its length.
+ * Actions:    A quick scan for "time": followed by digits, so that
+ *             the record needn't be tokenized twice.
+ * Returns:    The time, or the current time if the field is missing.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static long merge_time (const char *text, int len)
+   {
+   const char  *cp = text, *end = text + len;
+
+   while ((cp = memchr (cp, '"', end - cp)) != NULL)
+      {
+      if (end - ++cp < 6 || strncasecmp (cp, "time\"", 5) != 0)
+         continue;
+
+      for (cp += 5; cp < end && (*cp == ' ' || *cp == '\t'); cp++);
+
+      if (cp >= end || *cp++ != ':') continue;
+
+      for (; cp < end && (*cp == ' ' || *cp == '\t'); cp++);
+
+      if (cp < end && isdigit ((unsigned char) *cp))
+         return (strtol (cp, NULL, 10));
+      }
+
+   return ((long) time (NULL));
+   }
+
+// Returns 1 if heap entry "a" should come out before "b"
+static int merge_before (const MERGEREC *a, const MERGEREC *b)
+   {
+   if (a->time != b->time) return (a->time < b->time);
+   return (a->seq < b->seq);
+   }
+
+static void merge_swap (int a, int b)
+   {
+   MERGEREC tmp = MergeHeap [a];
+
+   MergeHeap [a] = MergeHeap [b];
+   MergeHeap [b] = tmp;
+   }
+
+/**********************************************************************/
+/* Purpose:    Release the earliest record from the heap
+ * Called by:  merge_push() and merge_release()
+ * Actions:    Dispatches the record at the top of the heap, then swaps
+ *             it with the last entry, which keeps its buffer for
+ *             re-use, and sifts the new top down into place.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void merge_pop (void)
+   {
+   MERGEREC *top = &MergeHeap [0];
+   int      i = 0, c;
+
+   dispatch_json (top->null ? NULL : top->json, top->len);
+
+   merge_swap (0, --MergeCount);
+
+   while ((c = 2 * i + 1) < MergeCount)
+      {
+      if (c + 1 < MergeCount
+      && merge_before (&MergeHeap [c+1], &MergeHeap [c]))
+         c++;
+
+      if (!merge_before (&MergeHeap [c], &MergeHeap [i])) break;
+
+      merge_swap (i, c);
+      i = c;
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Add a record to the reordering heap
+ * Called by:  input_record()
+ * Arguments:  Pointer to serialised record, or NULL for an oversize
+ *             object, length of the record.
+ * Actions:    Releases the earliest record if the heap is full, then
+ *             copies this one into the buffer of the first free entry
+ *             and sifts it up into place.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void merge_push (const char *json, int len)
+   {
+   MERGEREC *mp;
+   int      i;
+
+   if (MergeCount == MERGE_MAX) merge_pop ();
+
+   mp = &MergeHeap [i = MergeCount++];
+
+   if (len > mp->size)
+      {
+      if ((mp->json = realloc (mp->json, len)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
+      mp->size = len;
+      }
+
+   if (json) memcpy (mp->json, json, len);
+   mp->len = len;
+   mp->null = (json == NULL);
+   mp->time = json ? merge_time (json, len) : (long) time (NULL);
+   mp->seq = MergeSeq++;
+   mp->due = merge_now () + MergeWindow;
+
+   for (; i > 0 && merge_before (&MergeHeap [i],
+      &MergeHeap [(i-1) / 2]); i = (i-1) / 2)
+      {
+      merge_swap (i, (i-1) / 2);
+      }
+   }
+
+/**********************************************************************/
+/* Purpose:    Release the records whose time is up
+ * Called by:  input_run()
+ * Arguments:  1 to release everything, e.g. at the end of the input,
+ *             else 0 to release only those held for the reorder window.
+ * Returns:    Milliseconds until the next record is due, or -1 if the
+ *             heap is empty, for use as a poll() timeout.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int merge_release (int all)
+   {
+   long long   now = merge_now ();
+
+   while (MergeCount && (all || MergeHeap [0].due <= now))
+      merge_pop ();
+
+   return (MergeCount ? (int) (MergeHeap [0].due - now) : -1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Accept a record from one of the inputs
+ * Called by:  The input readers.
+ * Arguments:  Pointer to serialised record, or NULL if the object was
+ *             too big, length of the record.
+ * Actions:    Puts the record in the reordering heap if there is more
+ *             than one input, else dispatches it in place.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void input_record (const char *json, int len)
+   {
+   if (Merging) merge_push (json, len);
+   else dispatch_json (json, len);
+   }
+
+//######################################################################
+//                        INPUT FRAMING FUNCTIONS
+//######################################################################
+
+/* The input is a stream of un-named JSON objects, possibly separated by
+ * newlines or other junk.  Rather than pass every byte through the
+ * framing state machine, the input is read in large blocks, which are
+ * scanned for the only four characters that can change the state:
+ * '{', '}', '"' and '\'.  Whole objects are then handed to
+ * input_record() in place, without being copied.
+ *
+ * Each file source has a read buffer of INPUT_BLKSIZE bytes to begin
+ * with.  If an object doesn't fit, the buffer is doubled, up to
+ * INPUT_MAXSIZE, so there's no limit on the size of an object other
+ * than that.  Every INPUT_TRIM reads, a buffer which is more than
+ * four times the size of the largest object since the last check is
+ * halved, so its size follows the recent records rather than the
+ * largest ever seen, without a reallocation per record.
+ * */
+#define  INPUT_BLKSIZE  65536    // Initial size of a read buffer
+#define  INPUT_MAXSIZE  (16 * 1024 * 1024)  // Larger objects discarded
+#define  INPUT_TRIM     1024     // Reads between checks of the size
+
+typedef struct
+   {
+   int      braceLevel;          // Nesting depth, 0 = between objects
+   int      inString;            // Within a string
+   int      escaped;             // Last char of block was '\'
+   int      discard;             // Object too big, don't process it
+   size_t   start;               // Offset of char after opening brace
+   } FRAMER;
+
+/* Each input is described by a SOURCE.  A file (or stdin) is read in
+ * blocks into its own buffer and framed; an MQTT broker connection
+ * keeps its packet receive buffer and connection state.
+ * */
+#define  MAX_SOURCES    16       // Max inputs, "-I" and "-M" together
+
+#define  SRC_FILE       1        // File, pipe or stdin ("-")
+#define  SRC_MQTT       2        // MQTT broker
+
+#define  MQ_IDLE        0        // Waiting to (re)connect
+#define  MQ_CONNECTING  1        // Non-blocking connect in progress
+#define  MQ_UP          2        // Connected
+
+typedef struct
+   {
+   int      type;                // SRC_xxx
+   char     name [256];          // File name, or host:port/topic
+   int      fd;                  // File or socket, -1 if closed
+   int      eof;                 // File: no more input
+   FRAMER   fr;                  // File: framing state
+   char     *buf;                // Receive buffer
+   size_t   size;                // Allocated size of buffer
+   size_t   have;                // Bytes in buffer
+   size_t   pos;                 // File: framing resumes here
+   size_t   peak;                // File: largest object since trim
+   unsigned reads;               // File: reads since trim
+
+   // The rest is for MQTT only
+   int      state;               // MQ_xxx
+   char     host [256];          // Broker host name
+   char     port [8];            // Broker port, as a string
+   char     topic [256];         // Topic to subscribe to
+   time_t   lastSent;            // Time of last packet sent
+   time_t   lastHeard;           // Time of last packet received
+   time_t   retryAt;             // When to reconnect
+   int      backoff;             // Seconds to wait before next retry
+   } SOURCE;
+
+static SOURCE  Sources [MAX_SOURCES];
+static int     NumSources = 0;
+
+/**********************************************************************/
+/* Purpose:    Add an input source
+ * Called by:  main() for "-I", and mqtt_option() for "-M"
+ * Arguments:  SRC_xxx type, name of file (or "-" for stdin).
+ * Returns:    Pointer to the new source, or NULL if there are too many
+ *             (message already printed).
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static SOURCE *source_add (int type, const char *name)
+   {
+   SOURCE   *src;
+
+   if (NumSources >= MAX_SOURCES)
+      {
+      printf ("Too many inputs, the maximum is %d\n", MAX_SOURCES);
+      return (NULL);
+      }
+
+   src = &Sources [NumSources++];
+   memset (src, 0, sizeof (SOURCE));
+   src->type = type;
+   src->fd = -1;
+   snprintf (src->name, sizeof (src->name), "%s", name);
+
+   return (src);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the next character which affects object framing
+ * Called by:  frame_next()
+ * Arguments:  Pointer to buffer, offset to start from, length of data
+ *             in buffer.
+ * Actions:    Scans for '{', '}', '"' or '\', 32 or 16 bytes at a time
+ *             with AVX2 or SSE2 if the compiler is targetting them,
+ *             else 8 bytes at a time using 64 bit arithmetic.  The
+ *             last few bytes are checked one at a time.
+ * Returns:    Offset of the first such character, or "len" if there
+ *             are none.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static size_t frame_findSpecial (const char *buf, size_t pos,
+   size_t len)
+   {
+#if defined(__AVX2__)
+   const __m256i  lb = _mm256_set1_epi8 ('{');
+   const __m256i  rb = _mm256_set1_epi8 ('}');
+   const __m256i  qt = _mm256_set1_epi8 ('"');
+   const __m256i  bs = _mm256_set1_epi8 ('\\');
+
+   while (pos + 32 <= len)
+      {
+      __m256i  v = _mm256_loadu_si256 ((const __m256i *) (buf + pos));
+      unsigned mask = _mm256_movemask_epi8 (_mm256_or_si256 (
+         _mm256_or_si256 (_mm256_cmpeq_epi8 (v, lb),
+            _mm256_cmpeq_epi8 (v, rb)),
+         _mm256_or_si256 (_mm256_cmpeq_epi8 (v, qt),
+            _mm256_cmpeq_epi8 (v, bs))));
+
+      if (mask) return (pos + __builtin_ctz (mask));
+      pos += 32;
+      }
+#endif
+
+#if defined(__SSE2__)
+   const __m128i  lb16 = _mm_set1_epi8 ('{');
+   const __m128i  rb16 = _mm_set1_epi8 ('}');
+   const __m128i  qt16 = _mm_set1_epi8 ('"');
+   const __m128i  bs16 = _mm_set1_epi8 ('\\');
+
+   while (pos + 16 <= len)
+      {
+      __m128i  v = _mm_loadu_si128 ((const __m128i *) (buf + pos));
+      unsigned mask = _mm_movemask_epi8 (_mm_or_si128 (
+         _mm_or_si128 (_mm_cmpeq_epi8 (v, lb16),
+            _mm_cmpeq_epi8 (v, rb16)),
+         _mm_or_si128 (_mm_cmpeq_epi8 (v, qt16),
+            _mm_cmpeq_epi8 (v, bs16))));
+
+      if (mask) return (pos + __builtin_ctz (mask));
+      pos += 16;
+      }
+
+#elif defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   // Portable fallback. A byte of (x - ONES) & ~x & HIGHS is set only
+   // where x had a zero byte, and the lowest set one is exact.
+   #define SWAR_ONES    0x0101010101010101ULL
+   #define SWAR_HIGHS   0x8080808080808080ULL
+   #define SWAR_ZERO(x) (((x) - SWAR_ONES) & ~(x) & SWAR_HIGHS)
+
+   while (pos + 8 <= len)
+      {
+      uint64_t w, mask;
+
+      memcpy (&w, buf + pos, 8);
+
+      mask = SWAR_ZERO (w ^ (SWAR_ONES * '{'))
+         | SWAR_ZERO (w ^ (SWAR_ONES * '}'))
+         | SWAR_ZERO (w ^ (SWAR_ONES * '"'))
+         | SWAR_ZERO (w ^ (SWAR_ONES * '\\'));
+
+      if (mask) return (pos + (__builtin_ctzll (mask) >> 3));
+      pos += 8;
+      }
+#endif
+
+   for (; pos < len; pos++)
+      {
+      switch (buf [pos])
+         {
+         case '{':   case '}':   case '"':   case '\\':
+            return (pos);
+         }
+      }
+
+   return (len);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the next complete JSON object in a buffer
+ * Called by:  frame_stream()
+ * Arguments:  Pointer to framing state, pointer to buffer, length of
+ *             data in buffer, pointer to the offset to resume from,
+ *             pointer to receive the offset of the closing brace.
+ * Actions:    Runs the framing state machine over the buffer, visiting
+ *             only the characters found by frame_findSpecial(). Braces
+ *             within strings, and escaped characters, are ignored.
+ *             Anything outside the outermost braces is ignored.
+ * Affects:    The framing state and "*pos".  If an object is completed,
+ *             "*end" is set to the offset of its closing brace and
+ *             fr->start is the offset of the char after its opening
+ *             brace.
+ * Returns:    1 if an object was completed, else 0 when the buffer is
+ *             exhausted.
+ * Notes:      The state is retained between calls, so objects may
+ *             span more than one block of input.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int frame_next (FRAMER *fr, const char *buf, size_t len,
+   size_t *pos, size_t *end)
+   {
+   size_t   i = *pos;
+
+   // Previous block ended with an escape, so skip the escaped char
+   if (fr->escaped && i < len)
+      {
+      fr->escaped = 0;
+      i++;
+      }
+
+   while ((i = frame_findSpecial (buf, i, len)) < len)
+      {
+      char  ch = buf [i++];
+
+      if (fr->braceLevel == 0)   // Waiting for opening brace
+         {
+         if (ch == '{')    // Found the opening brace
+            {
+            fr->braceLevel = 1;
+            fr->start = i;
+            }
+         continue;
+         }
+
+      // If we get here, braceLevel is > 0
+
+      switch (ch)
+         {
+         case '\\':  // The next character is escaped, so skip it
+            if (i < len) i++;
+            else fr->escaped = 1;
+            break;
+
+         case '"':   // Start or end of string
+            fr->inString = !fr->inString;
+            break;
+
+         case '{':   // Possible start of object within object
+            if (!fr->inString) fr->braceLevel++;
+            break;
+
+         case '}':   // Possible end of object
+            if (!fr->inString && --fr->braceLevel == 0)
+               {
+               *end = i - 1;
+               *pos = i;
+               return (1);
+               }
+            break;
+         }
+      }
+
+   *pos = len;
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the next complete JSON object, timing it for "-b"
+ *             and the profile
+ * Called by:  stream_read() and frame_mapped()
+ * Arguments:  As frame_next()
+ * Returns:    As frame_next()
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int metric_frame (FRAMER *fr, const char *buf, size_t len,
+   size_t *pos, size_t *end)
+   {
+   uint64_t start = 0;
+   int      rc;
+
+   PROF_MARK (P_FRAME);
+   if (Timing) start = metric_now ();
+
+   rc = frame_next (fr, buf, len, pos, end);
+
+   if (Timing) metric_stage (&Metric->frameNs, start);
+   PROF_MARK (P_OTHER);
+
+   return (rc);
+   }
+
+/**********************************************************************/
+/* Purpose:    Resize the read buffer of a file source
+ * Called by:  stream_read(), frame_stream() and input_run()
+ * Arguments:  Pointer to source, new size of its buffer.
+ * Affects:    The "buf" and "size" members of the source.
+ * Returns:    None.  Exits if out of memory.
+ * Notes:      The size must not be less than the data in the buffer.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void src_resize (SOURCE *src, size_t size)
+   {
+   if ((src->buf = realloc (src->buf, size)) == NULL)
+      {
+      fprintf (stderr, "Out of memory\n");
+      exit (-1);
+      }
+
+   src->size = size;
+   }
+
+/**********************************************************************/
+/* Purpose:    Read a block from a file source and process its objects
+ * Called by:  frame_stream() and input_run()
+ * Arguments:  Pointer to source.
+ * Actions:    Reads as much as will fit in the buffer, and hands each
+ *             complete object to input_record() straight from the
+ *             buffer.  Any incomplete object at the end of the buffer
+ *             is moved to the start, ready for the next read, and the
+ *             buffer is doubled if the object fills it.  When nothing
+ *             is left over, the buffer may be trimmed.
+ * Returns:    1 if data was read, 0 at end of file or on error, or -1
+ *             if interrupted or there was nothing to read yet.
+ * Notes:      An object which would not fit in INPUT_MAXSIZE bytes is
+ *             discarded, rather than allowed to use unbounded memory.
+ * Created:    14/10/2026, from frame_stream()
+ * Modified:   14/10/2026 to time the framing for "-b", and to grow
+ *             and trim the buffer to suit the objects. */
+/**********************************************************************/
+
+static int stream_read (SOURCE *src)
+   {
+   FRAMER   *fr = &src->fr;
+   size_t   end;
+   ssize_t  n;
+
+   n = read (src->fd, src->buf + src->have, src->size - src->have);
+
+   if (n < 0)
+      {
+      if (errno == EINTR || errno == EAGAIN) return (-1);
+      n = 0;
+      }
+
+   if (n == 0) return (0);   // End of file
+
+   src->have += n;
+
+   while (metric_frame (fr, src->buf, src->have, &src->pos, &end))
+      {
+      if (fr->discard)   // Tail of an object that didn't fit
+         {
+         fr->discard = 0;
+         input_record (NULL, 0);   // Just for the warning
+         }
+
+      else
+         {
+         if (end - fr->start > src->peak) src->peak = end - fr->start;
+         input_record (src->buf + fr->start, end - fr->start);
+         }
+      }
+
+   if (fr->braceLevel == 0)   // Nothing worth keeping
+      {
+      src->have = src->pos = 0;
+
+      // Halve the buffer if the recent objects would fit in half
+      if (++src->reads >= INPUT_TRIM)
+         {
+         if (src->size > INPUT_BLKSIZE && src->peak * 2 < src->size / 2)
+            src_resize (src, src->size / 2);
+         src->reads = 0;
+         src->peak = 0;
+         }
+      return (1);
+      }
+
+   if (fr->start == 0 && src->have == src->size && !fr->discard)
+      {
+      if (src->size < INPUT_MAXSIZE)   // Make room for the rest of it
+         {
+         src_resize (src, src->size * 2);
+         return (1);
+         }
+
+      fr->discard = 1;   // Object is too big, even for INPUT_MAXSIZE
+      }
+
+   if (fr->discard)
+      {
+      src->have = src->pos = fr->start = 0;
+      return (1);
+      }
+
+   // Move the incomplete object to the start of the buffer
+   memmove (src->buf, src->buf + fr->start, src->have - fr->start);
+   src->have -= fr->start;
+   src->pos -= fr->start;
+   fr->start = 0;
+
+   return (1);
+   }
+
+/**********************************************************************/
+/* Purpose:    Read JSON objects from a file descriptor and process them
+ * Called by:  main() and frame_mapped()
+ * Arguments:  File descriptor to read from, normally stdin.
+ * Actions:    Reads the input in large blocks with stream_read(),
+ *             until end of file.  Shows the route table if SIGUSR1
+ *             interrupts a read, or reloads the filters if SIGHUP does.
+ * Returns:    None, when end of file is reached.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to use stream_read(), to show the route
+ *             table on SIGUSR1, and to reload the filters on SIGHUP. */
+/**********************************************************************/
+
+static void frame_stream (int fd)
+   {
+   SOURCE      src;
+
+   memset (&src, 0, sizeof (src));
+   src.fd = fd;
+   src_resize (&src, INPUT_BLKSIZE);
+
+   while (!Quit && stream_read (&src))
+      {
+      if (RouteQuery) route_print (time (NULL));
+      if (Reload) config_build ();
+      PROF_POLL ();
+      }
+
+   free (src.buf);
+   }
+
+/**********************************************************************/
+/* Purpose:    Replay a binary capture file
+ * Called by:  frame_mapped(), if the file starts with CAP_MAGIC
+ * Arguments:  Pointer to mapped file, its size.
+ * Actions:    Finds the blocks from the index, or by following the
+ *             block headers if there's no index, and rebuilds and
+ *             dispatches the records of each block which may hold
+ *             wanted frames.
+ * Affects:    CapRead and CapSkipped
+ * Returns:    None.  If the file is corrupt, a message is printed, and
+ *             the rest of it is ignored.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to act on the signals between blocks. */
+/**********************************************************************/
+
+static void cap_replay (const unsigned char *map, size_t size)
+   {
+   const unsigned char  *cp, *end, *next, *idx = NULL;
+   unsigned             i, nblocks = 0;
+   uint64_t             off = 8, t;
+   CAPBLOCK             block;
+   int                  n;
+
+   // Use the index if it's intact
+   if (size >= 8 + CAP_TRLSIZE
+   && memcmp (map + size - CAP_TRLSIZE, CAP_IDXMAGIC, 8) == 0)
+      {
+      off = cap_get64 (map + size - CAP_TRLSIZE + 8);
+      nblocks = cap_get32 (map + size - CAP_TRLSIZE + 16);
+
+      if (off + (uint64_t) nblocks * CAP_IDXSIZE + CAP_TRLSIZE == size)
+         idx = map + off;
+      else nblocks = 0;
+      }
+
+   for (i = 0, off = 8; !Quit; i++)
+      {
+      if (RouteQuery) route_print (time (NULL));
+      if (Reload) config_build ();
+      PROF_POLL ();
+
+      if (idx)
+         {
+         if (i >= nblocks) break;
+         off = cap_get64 (idx + i * CAP_IDXSIZE);
+         cp = idx + i * CAP_IDXSIZE + 8;
+         }
+      else if (off + CAP_HDRSIZE <= size) cp = map + off;
+      else break;
+
+      if (off + CAP_HDRSIZE > size || cap_getHeader (cp, &block) < 0
+      || off + CAP_HDRSIZE + block.bytes > size)
+         {
+         // Without an index, this is just where writing stopped
+         if (idx == NULL) break;
+
+         fprintf (stderr, "Capture file is corrupt at %llu\n",
+            (unsigned long long) off);
+         return;
+         }
+
+      cp = map + off + CAP_HDRSIZE;
+      end = cp + block.bytes;
+      off += CAP_HDRSIZE + block.bytes;
+
+      if (!cap_wanted (&block))
+         {
+         CapSkipped++;
+         continue;
+         }
+
+      CapRead++;
+      CapRefs = 0;
+
+      while (cp < end && !Quit)
+         {
+         if ((n = cap_getVarint (cp, end, &t)) == 0
+         || (next = cap_decode (cp + n, end)) == NULL)
+            {
+            fprintf (stderr, "Capture file is corrupt at %llu\n",
+               (unsigned long long) (off - (end - cp)));
+            return;
+            }
+
+         dispatch_json (CapText.buf, CapText.len);
+         cp = next;
+         }
+      }
+
+   }
+
+/* For "--from" and "--to", a text file which can be mapped has a time
+ * index: for each TIX_STEP bytes of the file, the offset of the first
+ * record which starts there, and the earliest and latest times of the
+ * records which start there.  It is built by framing the whole file,
+ * and reading the "time" of each record, which is much quicker than
+ * decoding them, and is saved beside the file as "<file>.tix", so that
+ * replaying the same file again needn't build it again.  It is rebuilt
+ * if the file's size or modification time has changed.
+ *
+ * The records aren't quite in time order, as the reporters' clocks
+ * differ, so the index keeps a range for each step, rather than one
+ * time.  The running maximum of the latest times from the start, and
+ * the running minimum of the earliest times from the end, are both in
+ * order, so the start of the replay is found by a binary search for
+ * the first step whose maximum isn't before the range, and the end by a
+ * binary search for the first step from which every record is after
+ * it.  So nothing within the range is missed, whatever the order.
+ *
+ *    Header:  "PNMPTIX\1", file size (8), modification time (8),
+ *             step (4), number of entries (4)
+ *
+ *    Entry:   offset (8), earliest time (8), latest time (8)
+ * */
+#define  TIX_STEP       262144   // Bytes of file per index entry
+#define  TIX_HDRSIZE    32       // Size of header
+#define  TIX_ENTSIZE    24       // Size of entry
+#define  TIX_MAGIC      "PNMPTIX\1"
+
+typedef struct
+   {
+   size_t   off;                 // Offset of the first record
+   long     tmin;                // Earliest time in the step
+   long     tmax;                // Latest time in the step
+   } TIXENTRY;
+
+/**********************************************************************/
+/* Purpose:    Build the time index of a mapped file
+ * Called by:  tix_seek()
+ * Arguments:  Pointer to mapped file, its size, pointer to receive the
+ *             allocated index.
+ * Actions:    Frames every record, starting an entry with each one
+ *             which starts in a new step, and adds its time to the
+ *             entry.
+ * Returns:    Number of entries, or -1 if interrupted by Quit.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int tix_build (const char *map, size_t size, TIXENTRY **ep)
+   {
+   TIXENTRY *e = NULL;
+   FRAMER   fr;
+   JSONOBJ  json;
+   size_t   pos = 0, end, next = 0;
+   long     t;
+   int      n = 0, room = 0;
+
+   memset (&fr, 0, sizeof (fr));
+
+   while (!Quit && frame_next (&fr, map, size, &pos, &end))
+      {
+      if (n == 0 || fr.start - 1 >= next)
+         {
+         if (n == room)
+            {
+            room = room ? room * 2 : 1024;
+            if ((e = realloc (e, room * sizeof (TIXENTRY))) == NULL)
+               {
+               fprintf (stderr, "Out of memory\n");
+               exit (-1);
+               }
+            }
+
+         e [n].off = fr.start - 1;    // The opening brace
+         e [n].tmin = LONG_MAX;
+         e [n].tmax = LONG_MIN;
+         next = (e [n++].off / TIX_STEP + 1) * TIX_STEP;
+         }
+
+      json_reset (end - fr.start);
+      json_index (&json, map + fr.start, end - fr.start);
+
+      if ((t = json_getLong (&json, "time", -1)) < 0) continue;
+
+      if (t < e [n-1].tmin) e [n-1].tmin = t;
+      if (t > e [n-1].tmax) e [n-1].tmax = t;
+      }
+
+   *ep = e;
+
+   if (Quit)
+      {
+      free (e);
+      return (-1);
+      }
+
+   return (n);
+   }
+
+/**********************************************************************/
+/* Purpose:    Read a saved time index
+ * Called by:  tix_seek()
+ * Arguments:  Name of index file, status of the file it indexes,
+ *             pointer to receive the allocated index.
+ * Returns:    Number of entries, or -1 if it can't be read, or is for
+ *             another version of the file.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int tix_load (const char *name, const struct stat *st,
+   TIXENTRY **ep)
+   {
+   unsigned char  hdr [TIX_HDRSIZE], *buf = NULL, *cp;
+   TIXENTRY       *e = NULL;
+   FILE           *fp;
+   unsigned       i, n = 0;
+   int            rc = -1;
+
+   if ((fp = fopen (name, "rb")) == NULL) return (-1);
+
+   if (fread (hdr, 1, TIX_HDRSIZE, fp) == TIX_HDRSIZE
+   && memcmp (hdr, TIX_MAGIC, 8) == 0
+   && cap_get64 (hdr + 8) == (uint64_t) st->st_size
+   && cap_get64 (hdr + 16) == (uint64_t) st->st_mtime
+   && cap_get32 (hdr + 24) == TIX_STEP
+   && (n = cap_get32 (hdr + 28)) <= st->st_size / TIX_STEP + 1
+   && (buf = malloc ((size_t) n * TIX_ENTSIZE + 1)) != NULL
+   && (e = malloc ((size_t) n * sizeof (TIXENTRY) + 1)) != NULL
+   && fread (buf, TIX_ENTSIZE, n, fp) == n)
+      {
+      for (i = 0, cp = buf; i < n; i++, cp += TIX_ENTSIZE)
+         {
+         e [i].off = cap_get64 (cp);
+         e [i].tmin = (long) cap_get64 (cp + 8);
+         e [i].tmax = (long) cap_get64 (cp + 16);
+
+         if (e [i].off >= (size_t) st->st_size) break;   // Corrupt
+         }
+
+      if (i == n) rc = n;
+      }
+
+   fclose (fp);
+   free (buf);
+
+   if (rc < 0) free (e);
+   else *ep = e;
+
+   return (rc);
+   }
+
+/**********************************************************************/
+/* Purpose:    Save a time index beside the file
+ * Called by:  tix_seek()
+ * Arguments:  Name of index file, status of the file it indexes,
+ *             the index and its number of entries.
+ * Returns:    0 if successful, else -1
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int tix_save (const char *name, const struct stat *st,
+   const TIXENTRY *e, int n)
+   {
+   unsigned char  *buf, *cp;
+   size_t         size = TIX_HDRSIZE + (size_t) n * TIX_ENTSIZE;
+   FILE           *fp;
+   int            i, rc = -1;
+
+   if ((buf = malloc (size)) == NULL) return (-1);
+
+   memcpy (buf, TIX_MAGIC, 8);
+   cap_put64 (buf + 8, st->st_size);
+   cap_put64 (buf + 16, st->st_mtime);
+   cap_put32 (buf + 24, TIX_STEP);
+   cap_put32 (buf + 28, n);
+
+   for (i = 0, cp = buf + TIX_HDRSIZE; i < n; i++, cp += TIX_ENTSIZE)
+      {
+      cap_put64 (cp, e [i].off);
+      cap_put64 (cp + 8, e [i].tmin);
+      cap_put64 (cp + 16, e [i].tmax);
+      }
+
+   if ((fp = fopen (name, "wb")) != NULL)
+      {
+      if (fwrite (buf, 1, size, fp) == size) rc = 0;
+      if (fclose (fp) != 0) rc = -1;
+      if (rc < 0) remove (name);
+      }
+
+   free (buf);
+   return (rc);
+   }
+
+/**********************************************************************/
+/* Purpose:    Find the part of a mapped file holding the time range
+ * Called by:  frame_mapped(), if "--from" or "--to" is used
+ * Arguments:  Path of the file, its status, pointer to the mapped file,
+ *             pointers to the offset to start framing from, and the
+ *             offset to stop at, which is the size of the file.
+ * Actions:    Reads the file's time index, or builds and saves it if
+ *             there isn't a good one, then finds the first step which
+ *             may hold a record within the range, and the first step
+ *             after it which can't, by binary searches of the index
+ *             (see above).
+ * Affects:    The offsets.
+ * Returns:    None.  If the index can't be had, the offsets are left,
+ *             and the whole file is framed.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void tix_seek (const char *path, const struct stat *st,
+   const char *map, size_t *pos, size_t *len)
+   {
+   TIXENTRY *e = NULL;
+   char     name [270];
+   long     from, to;
+   int      n, i, lo, hi, mid;
+
+   snprintf (name, sizeof (name), "%s.tix", path);
+
+   // Each entry must be at the start of a record, after the last
+   if ((n = tix_load (name, st, &e)) >= 0)
+      {
+      for (i = 0; i < n && map [e [i].off] == '{'
+         && (i == 0 || e [i].off > e [i-1].off); i++);
+
+      if (i < n)
+         {
+         free (e);
+         n = -1;
+         }
+      }
+
+   if (n < 0)
+      {
+      if ((n = tix_build (map, st->st_size, &e)) < 0) return;
+
+      if (tix_save (name, st, e, n) < 0)
+         fprintf (stderr, "Can't save the time index '%s'\n", name);
+      }
+
+   // The day of a time of day is that of the first record
+   for (i = 0; i < n && e [i].tmin > e [i].tmax; i++);
+
+   if (i == n)    // No times, so nothing wanted
+      {
+      *pos = *len;
+      free (e);
+      return;
+      }
+
+   range_get (e [i].tmin, &from, &to);
+
+   for (i = 1; i < n; i++)
+      if (e [i].tmax < e [i-1].tmax) e [i].tmax = e [i-1].tmax;
+
+   for (i = n - 1; i-- > 0; )
+      if (e [i].tmin > e [i+1].tmin) e [i].tmin = e [i+1].tmin;
+
+   // First step with a record at or after the start
+   for (lo = 0, hi = n; lo < hi; )
+      {
+      mid = (lo + hi) / 2;
+      if (e [mid].tmax >= from) hi = mid;
+      else lo = mid + 1;
+      }
+
+   *pos = lo < n ? e [lo].off : *len;
+
+   // First step from which every record is at or after the end
+   for (hi = n; lo < hi; )
+      {
+      mid = (lo + hi) / 2;
+      if (e [mid].tmin >= to) hi = mid;
+      else lo = mid + 1;
+      }
+
+   if (lo < n) *len = e [lo].off;
+
+   free (e);
+   }
+
+/**********************************************************************/
+/* Purpose:    Read JSON objects from a memory-mapped file
+ * Called by:  main() if the "-I" option is used.
+ * Arguments:  Path of the file to replay.
+ * Actions:    Maps the whole file into memory and frames the objects
+ *             directly in the mapped region, handing each one to
+ *             dispatch_json() as a pointer and length.  Nothing is
+ *             copied.  If the file can't be mapped, e.g. because it is
+ *             a pipe, it is read by frame_stream() instead.  Binary
+ *             capture files are replayed by cap_replay().
+ * Returns:    0 if successful, else -1 if the file can't be opened.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 for binary capture files, to time the framing
+ *             for "-b", to seek to the time range, and to act on the
+ *             signals between records, as the other input loops do. */
+/**********************************************************************/
+
+static int frame_mapped (const char *path)
+   {
+   struct stat st;
+   FRAMER      fr;
+   size_t      pos = 0, end, len;
+   char        *map = NULL;
+   int         fd;
+
+   if ((fd = open (path, O_RDONLY)) < 0) return (-1);
+
+#ifndef WIN32
+   if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0)
+      {
+      map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) map = NULL;
+      }
+#endif
+
+   if (map == NULL)  // Not mappable, so read it the hard way
+      {
+      frame_stream (fd);
+      close (fd);
+      return (0);
+      }
+
+#ifndef WIN32
+   madvise (map, st.st_size, MADV_SEQUENTIAL);
+
+   if (st.st_size >= 8 && memcmp (map, CAP_MAGIC, 8) == 0)
+      {
+      cap_replay ((unsigned char *) map, st.st_size);
+      munmap (map, st.st_size);
+      close (fd);
+      return (0);
+      }
+
+   memset (&fr, 0, sizeof (fr));
+   len = st.st_size;
+
+   // Only the part which may hold the time range
+   if (Ranged) tix_seek (path, &st, map, &pos, &len);
+
+   while (!Quit && metric_frame (&fr, map, len, &pos, &end))
+      {
+      dispatch_json (map + fr.start, end - fr.start);
+
+      if (RouteQuery) route_print (time (NULL));
+      if (Reload) config_build ();
+      PROF_POLL ();
+      }
+
+   munmap (map, st.st_size);
+#endif
+
+   close (fd);
+   return (0);
+   }
 
-   else if (strcmp (type, "INP3") == 0) trace_inp3 (json);
+//######################################################################
+//                         MQTT CLIENT FUNCTIONS
+//######################################################################
+
+/* With "-M host[:port][/topic]" the program subscribes to the broker
+ * itself, instead of reading the output of "mosquitto_sub" from stdin.
+ * This is a minimal MQTT 3.1.1 subscriber, sufficient to receive QoS 0
+ * and 1 messages from the PNMP server and nothing more.  The sockets
+ * are non-blocking and are polled by input_run(), along with any other
+ * inputs, which also calls mqtt_timer() to send the keep-alive pings.
+ * If a connection fails or is lost, it is re-tried with an exponential
+ * backoff, up to a minute between attempts.
+ *
+ * The broker delimits the messages, so each PUBLISH payload is handed
+ * straight to input_record() from the receive buffer, without passing
+ * it through the framing state machine.
+ * */
+#ifndef WIN32
+
+#define  MQTT_PORT      1883     // Default broker port
+#define  MQTT_TOPIC     "in/udp" // Default topic
+#define  MQTT_KEEPALIVE 60       // Keep-alive interval, seconds
+#define  MQTT_TIMEOUT   10       // Seconds allowed for connecting
+#define  MQTT_MAXBACKOFF 60      // Max seconds between reconnects
+#define  MQTT_MAXPACKET (1024 * 1024)  // Larger packets are an error
+
+#define  MQTT_CONNECT   0x10     // Packet types, in the top 4 bits
+#define  MQTT_CONNACK   0x20
+#define  MQTT_PUBLISH   0x30
+#define  MQTT_PUBACK    0x40
+#define  MQTT_SUBSCRIBE 0x82     // Includes the mandatory flags
+#define  MQTT_SUBACK    0x90
+#define  MQTT_PINGREQ   0xC0
+#define  MQTT_PINGRESP  0xD0
+#define  MQTT_DISCONNECT 0xE0
+
+/**********************************************************************/
+/* Purpose:    Parse a "-M" option
+ * Called by:  main()
+ * Arguments:  Option value, "host[:port][/topic]"
+ * Actions:    Adds an MQTT source for it.
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to add a source, for multiple brokers. */
+/**********************************************************************/
+
+static int mqtt_option (const char *value)
+   {
+   const char  *slash = strchr (value, '/');
+   const char  *colon = strchr (value, ':');
+   SOURCE      *src;
+   int         len;
+
+   len = slash ? slash - value : strlen (value);
+   if (colon && (slash == NULL || colon < slash)) len = colon - value;
+
+   if (len == 0 || len >= sizeof (src->host))
+      {
+      printf ("Bad MQTT broker '%s'\n", value);
+      return (-1);
+      }
+
+   if ((src = source_add (SRC_MQTT, value)) == NULL) return (-1);
+
+   sprintf (src->host, "%.*s", len, value);
 
-   else if (TraceFlags & TRACE_WARNINGS)
-      uprintf (" [unknown 'type' '%s'", type);
+   if (colon && (slash == NULL || colon < slash))
+      snprintf (src->port, sizeof (src->port), "%d", atoi (colon + 1));
+   else sprintf (src->port, "%d", MQTT_PORT);
 
-   // Future types go here
+   snprintf (src->topic, sizeof (src->topic), "%s",
+      (slash && slash [1]) ? slash + 1 : MQTT_TOPIC);
+
+   src->backoff = 1;
+   return (0);
    }
 
 /**********************************************************************/
-/* Purpose:    Trace a netrom routing poll
- * Called by:  x
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    x
- * Affects:    x
- * Returns:    x
- * Notes:      x
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Send a packet to the broker
+ * Called by:  mqtt_hello(), mqtt_packet() and mqtt_timer()
+ * Arguments:  Socket, pointer to packet, length of packet.
+ * Actions:    The packets we send are small, so there will nearly
+ *             always be room for them in the socket buffer, but if not,
+ *             waits for room, for up to the keep-alive interval.
+ * Returns:    0 if successful, else -1 if the connection has failed.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static void trace_netromRoutingPoll (const char *json)
+static int mqtt_send (int fd, const unsigned char *pkt, int len)
    {
-   /// TODO: Populate me
+   struct pollfd  pfd;
+   ssize_t        n;
+
+   while (len > 0)
+      {
+      if ((n = send (fd, pkt, len, MSG_NOSIGNAL)) > 0)
+         {
+         pkt += n;
+         len -= n;
+         continue;
+         }
+
+      if (n < 0 && errno == EINTR && !Quit) continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+         {
+         pfd.fd = fd;
+         pfd.events = POLLOUT;
+         if (poll (&pfd, 1, MQTT_KEEPALIVE * 1000) > 0) continue;
+         }
+
+      return (-1);
+      }
+
+   return (0);
+   }
+
+// Append an MQTT "remaining length" to a packet, returns bytes used
+static int mqtt_putLength (unsigned char *cp, int len)
+   {
+   int   n = 0;
+
+   do {
+      cp [n] = len & 0x7f;
+      len >>= 7;
+      if (len) cp [n] |= 0x80;
+      n++;
+      } while (len);
+
+   return (n);
    }
 
 /**********************************************************************/
-/* Purpose:    Decode and display NetRom layer 4 segments
- * Called by:  trace_netromL3() only
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    For l4Type "PROT_EXT" this currently displays only the
- *             protocol type (if known), else the protocol family and
- *             protocol number (if protocol not known).
- *             If l4Type is not "PROT_EXT", the frame is either a L4
- *             transport frame, or a "Netrom Record Route" frame. Both
- *             types are traced. For L4 transport, only the headers are
- *             traced, the payloads are considered sensitive.
- * Affects:    stdout only.
- * Returns:    None
- * Notes:      Tracing of NCMP, NDP, GNET etc could be added if required
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Drop a broker connection, and schedule a retry
+ * Called by:  The other MQTT functions, when something goes wrong
+ * Arguments:  Pointer to source, reason for the report.
+ * Actions:    Closes the socket, and sets the time of the next attempt
+ *             to connect, doubling the wait each time.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static void trace_netromL4 (const char *json)
+static void mqtt_fail (SOURCE *src, const char *why)
    {
-   char  tmp [2048], l4type [16];
+   if (src->fd >= 0) close (src->fd);
+   src->fd = -1;
+   src->state = MQ_IDLE;
+   src->retryAt = time (NULL) + src->backoff;
 
-   if ((TraceFlags & TRACE_L4) == 0) return;
+   fprintf (stderr, "MQTT: %s: %s, retrying in %d seconds\n",
+      src->name, why, src->backoff);
 
-   //   NetRom L4 Frame Type
-   if (json_getValue (json, "l4type", l4type, 15) == 0)
+   if ((src->backoff *= 2) > MQTT_MAXBACKOFF)
+      src->backoff = MQTT_MAXBACKOFF;
+   }
+
+/**********************************************************************/
+/* Purpose:    Start connecting to the broker
+ * Called by:  mqtt_timer(), when a connection attempt is due.
+ * Arguments:  Pointer to source.
+ * Actions:    Resolves the broker's address, and starts a non-blocking
+ *             connection.  Its completion is detected by input_run().
+ * Affects:    The source's state, socket and timers.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void mqtt_start (SOURCE *src)
+   {
+   struct addrinfo   hints, *res, *ai;
+   int               fd = -1, err;
+
+   memset (&hints, 0, sizeof (hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+
+   if ((err = getaddrinfo (src->host, src->port, &hints, &res)) != 0)
       {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [missing l4type]\n");
+      mqtt_fail (src, gai_strerror (err));
       return;
       }
 
-   if (strcmp (l4type, "unknown") == 0)
+   for (ai = res; ai; ai = ai->ai_next)
       {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [unknown l4type]\n");
-      return;
+      if ((fd = socket (ai->ai_family, ai->ai_socktype, 0)) < 0)
+         continue;
+
+      fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+      if (connect (fd, ai->ai_addr, ai->ai_addrlen) == 0
+      || errno == EINPROGRESS)
+         break;
+
+      close (fd);
+      fd = -1;
       }
 
-   if (strcmp (l4type, "PROT EXT") == 0)
+   freeaddrinfo (res);
+
+   src->fd = fd;
+   src->lastSent = time (NULL);   // For the connection timeout
+
+   if (fd < 0) mqtt_fail (src, "can't connect");
+   else src->state = MQ_CONNECTING;
+   }
+
+/**********************************************************************/
+/* Purpose:    Log in to the broker and subscribe to the topic
+ * Called by:  input_run(), when the socket connection completes.
+ * Arguments:  Pointer to source.
+ * Actions:    Checks that the connection succeeded, then sends the
+ *             CONNECT and SUBSCRIBE packets.  The replies are handled
+ *             by mqtt_packet().
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void mqtt_hello (SOURCE *src)
+   {
+   unsigned char  pkt [512], *cp;
+   char           clientId [32];
+   int            err, len;
+   socklen_t      errlen = sizeof (err);
+
+   if (getsockopt (src->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0
+   || err != 0)
       {
-      uprintf (" <%s>", l4type);
-      if (json_getValue (json, "l4Family", tmp, 80))
-         uprintf (" pf=%s", tmp);
-      if (json_getValue (json, "l4Proto", tmp, 80))
-         uprintf (" prot=%s", tmp);
+      mqtt_fail (src, "can't connect");
       return;
       }
 
-   if (strcmp (l4type, "IP") == 0
-   || strcmp (l4type, "NCMP") == 0
-   || strcmp (l4type, "NDP") == 0
-   || strcmp (l4type, "GNET") == 0)
+   // CONNECT, with clean session and no will, username or password
+   snprintf (clientId, sizeof (clientId), "pnmptrace-%d-%d",
+      (int) getpid (), (int) (src - Sources));
+
+   len = 10 + 2 + strlen (clientId);
+   cp = pkt;
+   *cp++ = MQTT_CONNECT;
+   cp += mqtt_putLength (cp, len);
+   memcpy (cp, "\0\4MQTT\4\2", 8);     // Protocol name, level, flags
+   cp += 8;
+   *cp++ = MQTT_KEEPALIVE >> 8;
+   *cp++ = MQTT_KEEPALIVE & 0xff;
+   *cp++ = strlen (clientId) >> 8;
+   *cp++ = strlen (clientId) & 0xff;
+   memcpy (cp, clientId, strlen (clientId));
+   cp += strlen (clientId);
+
+   // SUBSCRIBE, packet ID 1, requesting QoS 0
+   len = 2 + 2 + strlen (src->topic) + 1;
+   *cp++ = MQTT_SUBSCRIBE;
+   cp += mqtt_putLength (cp, len);
+   *cp++ = 0;
+   *cp++ = 1;
+   *cp++ = strlen (src->topic) >> 8;
+   *cp++ = strlen (src->topic) & 0xff;
+   memcpy (cp, src->topic, strlen (src->topic));
+   cp += strlen (src->topic);
+   *cp++ = 0;
+
+   if (mqtt_send (src->fd, pkt, cp - pkt) < 0)
       {
-      /// TODO: Decode these properly one day
-      uprintf (" <%s>", l4type);
+      mqtt_fail (src, "connection lost");
       return;
       }
 
-   if (strcmp (l4type, "NRR Request") == 0  // Netrom Record Route Request
-   || strcmp (l4type, "NRR Reply") == 0)  // Netrom Record Route Reply
-      {
-      uprintf (" <%s>", l4type);
-
-      if (json_getValue (json, "nrrId", tmp, 80))
-         uprintf (" id=%s", tmp);
+   src->state = MQ_UP;
+   src->have = 0;
+   src->lastSent = src->lastHeard = time (NULL);
+   }
 
-      if (json_getValue (json, "nrrRoute", tmp, 2047))
-         uprintf ("%sRoute: %s", Margin, tmp);
-      return;
-      }
+/**********************************************************************/
+/* Purpose:    Handle one packet received from the broker
+ * Called by:  mqtt_input()
+ * Arguments:  Pointer to source, packet type byte, pointer to the rest
+ *             of the packet (after the remaining length), its length.
+ * Actions:    Hands the payload of a PUBLISH to input_record(), less
+ *             the outer braces, as if it had been framed from stdin,
+ *             and acknowledges it if it was sent with QoS 1.  Checks
+ *             the CONNACK and SUBACK return codes.
+ * Returns:    0 if OK, else -1 if the connection should be dropped.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
 
-   if (json_getValue (json, "toCct", tmp, 8))
-      uprintf (" cct=%s", tmp);
+static int mqtt_packet (SOURCE *src, int type, const unsigned char *pkt,
+   int len)
+   {
+   unsigned char  ack [4];
+   const char     *payload, *first, *last;
+   int            n, qos;
 
-   if (strcmp (l4type, "CONN REQ") == 0
-   || strcmp (l4type, "CONN_REQX") == 0)
+   switch (type & 0xf0)
       {
-      uprintf (" <%s>", l4type);
-
-      if (json_getValue (json, "window", tmp, 8))
-         uprintf (" w=%s", tmp);
+      case MQTT_CONNACK:
+         if (len < 2 || pkt [1] != 0)
+            {
+            fprintf (stderr, "MQTT: %s: connection refused, code %d\n",
+               src->name, len < 2 ? -1 : pkt [1]);
+            return (-1);
+            }
+         fprintf (stderr, "MQTT: connected to %s\n", src->name);
+         src->backoff = 1;
+         break;
 
-      if (json_getValue (json, "srcUser", tmp, 9))
-         uprintf ("\n          %s", tmp);
-      else return;
+      case MQTT_SUBACK:
+         if (len < 3 || pkt [2] == 0x80)
+            {
+            fprintf (stderr, "MQTT: %s: subscription refused\n",
+               src->name);
+            return (-1);
+            }
+         break;
 
-      if (json_getValue (json, "srcNode", tmp, 9))
-         uprintf (" at %s", tmp);
+      case MQTT_PUBLISH:
+         qos = (type >> 1) & 3;
 
-      if (json_getValue (json, "service", tmp, 8))
-         uprintf (" svc=%s", tmp);
+         if (len < 2) return (-1);
+         n = 2 + ((pkt [0] << 8) | pkt [1]);    // Skip the topic
+         if (qos) n += 2;                       // and packet ID
+         if (n > len) return (-1);
 
-      if (json_getValue (json, "l4t1", tmp, 8))
-         uprintf (" t/o=%s", tmp);
+         if (qos == 1)
+            {
+            ack [0] = MQTT_PUBACK;
+            ack [1] = 2;
+            ack [2] = pkt [n-2];
+            ack [3] = pkt [n-1];
+            if (mqtt_send (src->fd, ack, 4) < 0) return (-1);
+            }
 
-      if (json_getValue (json, "bpqSpy", tmp, 8))
-         uprintf (" bpqSpy=%s", tmp);
+         payload = (const char *) pkt + n;
+         first = memchr (payload, '{', len - n);
+         last = payload + len - n;
+         while (last > payload && last [-1] != '}') last--;
 
-      return;
+         if (first && last - 1 > first)
+            input_record (first + 1, last - first - 2);
+         break;
       }
 
-   if (strcmp (l4type, "CONN ACK") == 0)
+   return (0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Receive from the broker, and process complete packets
+ * Called by:  input_run(), when the socket is readable.
+ * Arguments:  Pointer to source.
+ * Actions:    Reads whatever is available into the receive buffer,
+ *             which grows as needed, then takes whole packets from it
+ *             as they complete.  Any incomplete packet is moved to the
+ *             start of the buffer.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void mqtt_input (SOURCE *src)
+   {
+   unsigned char  *cp;
+   size_t         pos;
+   int            n, plen, hlen;
+
+   if (src->have + 65536 > src->size)
       {
-      uprintf (" <%s>", l4type);
-      if (json_getValue (json, "window", tmp, 8))
-         uprintf (" w=%s", tmp);
-      if (json_getValue (json, "fromCct", tmp, 8))
-         uprintf (" myCct=%s", tmp);
-      return; // ??
+      src->size = src->size ? src->size * 2 : 65536 * 2;
+      if ((src->buf = realloc (src->buf, src->size)) == NULL)
+         {
+         fprintf (stderr, "Out of memory\n");
+         exit (-1);
+         }
       }
 
-   if (strcmp (l4type, "CONN NAK") == 0)
+   if ((n = recv (src->fd, src->buf + src->have,
+      src->size - src->have, 0)) < 0)
       {
-      uprintf (" <%s>", l4type);
-      return; // ??
+      if (errno == EINTR || errno == EAGAIN) return;
+      n = 0;
       }
 
-   if (strcmp (l4type, "DREQ") == 0
-   || strcmp (l4type, "DACK") == 0)
+   if (n == 0)
       {
-      uprintf (" <%s>", l4type);
+      mqtt_fail (src, "connection lost");
       return;
       }
 
-   if (strcmp (l4type, "RSET") == 0)
+   src->have += n;
+   src->lastHeard = time (NULL);
+
+   for (pos = 0; src->have - pos >= 2; pos += hlen + plen)
       {
-      uprintf (" <%s>", l4type);
-      if (json_getValue (json, "fromCct", tmp, 8))
-         uprintf (" myCct=%s", tmp);
-      return;
+      cp = (unsigned char *) src->buf + pos;
+
+      for (plen = 0, hlen = 1; hlen < 5; hlen++)
+         {
+         if (pos + hlen >= src->have) break;
+         plen |= (cp [hlen] & 0x7f) << (7 * (hlen - 1));
+         if ((cp [hlen] & 0x80) == 0) break;
+         }
+
+      if (hlen == 5 || plen > MQTT_MAXPACKET)
+         {
+         mqtt_fail (src, "bad or oversize packet");
+         return;
+         }
+
+      // Incomplete length, or incomplete packet
+      if (pos + hlen >= src->have || src->have - pos - ++hlen < plen)
+         break;
+
+      if (mqtt_packet (src, cp [0], cp + hlen, plen) < 0)
+         {
+         mqtt_fail (src, "protocol error");
+         return;
+         }
+      }
+
+   memmove (src->buf, src->buf + pos, src->have - pos);
+   src->have -= pos;
+   }
+
+/**********************************************************************/
+/* Purpose:    Timed actions for a broker connection
+ * Called by:  input_run(), at least once a second.
+ * Arguments:  Pointer to source, current time.
+ * Actions:    Starts a connection when a retry is due, and abandons one
+ *             that is taking too long.  Once connected, sends a PINGREQ
+ *             if nothing has been sent for half the keep-alive
+ *             interval, and assumes the connection is dead if nothing
+ *             has been received for one and a half times the interval.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void mqtt_timer (SOURCE *src, time_t now)
+   {
+   static const unsigned char ping [2] = { MQTT_PINGREQ, 0 };
+
+   switch (src->state)
+      {
+      case MQ_IDLE:
+         if (now >= src->retryAt) mqtt_start (src);
+         break;
+
+      case MQ_CONNECTING:
+         if (now - src->lastSent > MQTT_TIMEOUT)
+            mqtt_fail (src, "connection timed out");
+         break;
+
+      case MQ_UP:
+         if (now - src->lastHeard > MQTT_KEEPALIVE * 3 / 2)
+            mqtt_fail (src, "broker not responding");
+
+         else if (now - src->lastSent >= MQTT_KEEPALIVE / 2)
+            {
+            if (mqtt_send (src->fd, ping, 2) < 0)
+               mqtt_fail (src, "connection lost");
+            src->lastSent = now;
+            }
+         break;
       }
+   }
+
+// Disconnect politely from the broker, on exit
+static void mqtt_close (SOURCE *src)
+   {
+   static const unsigned char bye [2] = { MQTT_DISCONNECT, 0 };
 
-   if (strcmp (l4type, "INFO") == 0)
+   if (src->state == MQ_UP) mqtt_send (src->fd, bye, 2);
+   if (src->fd >= 0) close (src->fd);
+   src->fd = -1;
+   src->state = MQ_IDLE;
+   }
+
+//######################################################################
+//                          INPUT SOURCE LOOP
+//######################################################################
+
+/**********************************************************************/
+/* Purpose:    Read from all the inputs at once
+ * Called by:  main(), if there is more than one input, or an MQTT one.
+ * Actions:    Opens the files, then polls all the inputs together,
+ *             reading from whichever are ready, and servicing the MQTT
+ *             timers.  With more than one input, the records pass
+ *             through the reordering heap, and the poll() timeout is
+ *             set so that they are released in time.  Ends when all the
+ *             files are finished, if there are no MQTT inputs, or when
+ *             Quit is set by SIGINT or SIGTERM.
+ * Returns:    0 if successful, else -1 if a file can't be opened.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 to show the route table on SIGUSR1, and to
+ *             reload the filters on SIGHUP. */
+/**********************************************************************/
+
+static int input_run (void)
+   {
+   struct pollfd  pfd [MAX_SOURCES];
+   SOURCE         *src;
+   int            i, active, timeout;
+
+   for (i = 0; i < NumSources; i++)
       {
-      uprintf (" <%s", l4type);
+      src = &Sources [i];
 
-      if (json_getValue (json, "txSeq", tmp, 8))
-         uprintf (" S%s", tmp);
+      if (src->type != SRC_FILE) continue;
 
-      if (json_getValue (json, "rxSeq", tmp, 8))
-         uprintf (" R%s", tmp);
+      if (strcmp (src->name, "-") == 0) src->fd = STDIN_FILENO;
+
+      else if ((src->fd = open (src->name, O_RDONLY)) < 0)
+         {
+         printf ("Can't open input file '%s'\n", src->name);
+         return (-1);
+         }
 
-      uprintf (">");
+      else
+         {
+         char  magic [8];
 
-      if (json_getValue (json, "paylen", tmp, 8))
-         uprintf (" ilen=%s", tmp);
+         // These aren't framed as text, so must be replayed alone
+         if (pread (src->fd, magic, 8, 0) == 8
+         && memcmp (magic, CAP_MAGIC, 8) == 0)
+            {
+            printf ("Binary capture '%s' can't be merged\n", src->name);
+            return (-1);
+            }
+         }
 
-      if (json_getValue (json, "payload", tmp, 2047))
-         uprintf (":%s%s", Margin, tmp);
+      src_resize (src, INPUT_BLKSIZE);
       }
 
-   else if (strcmp (l4type, "INFO ACK") == 0)
+   while (!Quit)
       {
-      uprintf (" <%s", l4type);
+      if (RouteQuery) route_print (time (NULL));  // SIGUSR1
+      if (Reload) config_build ();                 // SIGHUP
+      PROF_POLL ();                                // SIGUSR2
+
+      if ((timeout = merge_release (0)) < 0 || timeout > 1000)
+         timeout = 1000;
+
+      for (i = active = 0; i < NumSources; i++)
+         {
+         src = &Sources [i];
+         pfd [i].fd = -1;     // Ignored by poll()
+         pfd [i].events = pfd [i].revents = 0;
+
+         if (src->type == SRC_FILE)
+            {
+            if (src->eof) continue;
+            pfd [i].events = POLLIN;
+            }
+
+         else
+            {
+            mqtt_timer (src, time (NULL));
+            if (src->state == MQ_CONNECTING) pfd [i].events = POLLOUT;
+            if (src->state == MQ_UP) pfd [i].events = POLLIN;
+            }
+
+         pfd [i].fd = src->fd;
+         active++;
+         }
+
+      if (active == 0) break;    // All the files are finished
+
+      if (poll (pfd, NumSources, timeout) <= 0) continue;
+
+      for (i = 0; i < NumSources; i++)
+         {
+         src = &Sources [i];
+
+         if (pfd [i].revents == 0 || src->fd != pfd [i].fd) continue;
+
+         if (src->type == SRC_FILE)
+            {
+            if (stream_read (src) == 0)
+               {
+               src->eof = 1;
+               if (src->fd != STDIN_FILENO) close (src->fd);
+               }
+            }
 
-      if (json_getValue (json, "rxSeq", tmp, 8))
-         uprintf (" R%s", tmp);
+         else if (src->state == MQ_CONNECTING) mqtt_hello (src);
 
-      uprintf (">");
+         else mqtt_input (src);
+         }
       }
 
-   if (json_getValue (json, "chokeFlag", tmp, 8))
-         uprintf (" <CHOKE>");
+   merge_release (1);   // Whatever is left
 
-   if (json_getValue (json, "nakFlag", tmp, 8))
-         uprintf (" <NAK>");
+   for (i = 0; i < NumSources; i++)
+      {
+      if (Sources [i].type == SRC_MQTT) mqtt_close (&Sources [i]);
+      free (Sources [i].buf);
+      }
 
-   if (json_getValue (json, "moreFlag", tmp, 8))
-         uprintf (" <MORE>");
+   return (0);
+   }
+
+//######################################################################
+//                        METRICS EXPORT FUNCTIONS
+//######################################################################
+
+/* With "-E [<host>:]<port>", a small HTTP listener thread answers
+ * "GET /metrics" with the counters in the Prometheus text format, so
+ * that a long running trace can be watched from a dashboard.  Each
+ * request is handled in turn and the connection closed, which is all a
+ * scraper needs.
+ * */
+static char       MetricAddr [64];     // "[host:]port" to listen on
+static int        MetricFd = -1;       // Listening socket
+static pthread_t  MetricThread;
+
+// Append formatted text to a buffer
+static void metric_printf (OUTBUF *ob, const char *fmt, ...)
+   {
+   va_list  ap;
+   int      len;
+
+   va_start (ap, fmt);
+   len = vsnprintf (NULL, 0, fmt, ap);
+   va_end (ap);
+
+   out_reserve (ob, len);
 
+   va_start (ap, fmt);
+   vsnprintf (ob->buf + ob->len, len + 1, fmt, ap);
+   va_end (ap);
+
+   ob->len += len;
+   }
+
+// Append the HELP and TYPE lines of a metric
+static void metric_header (OUTBUF *ob, const char *name,
+   const char *type, const char *help)
+   {
+   metric_printf (ob, "# HELP pnmptrace_%s %s\n", name, help);
+   metric_printf (ob, "# TYPE pnmptrace_%s %s\n", name, type);
    }
 
 /**********************************************************************/
-/* Purpose:    Trace L3RTT frames
- * Called by:  trace_netromL3() if l3Dest is "L3RTT"
- * Arguments:  Pointer to serialised JSON object.
- * Notes:      L3RTT is a "retrofit" to NetRom. It includes an L4 header
- *             which makes it look like an L4 INFO frame with circuit
- *             number, send and receive sequence numbers all zero. But
- *             it most definitely belongs in layer 3.
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Append a latency histogram
+ * Called by:  metric_scrape()
+ * Arguments:  Output buffer, metric name, help text, histogram
+ * Notes:      The buckets are kept separately, and Prometheus wants
+ *             them cumulative, with the bounds in seconds.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static void trace_l3rtt (const char *json)
+static void metric_histogram (OUTBUF *ob, const char *name,
+   const char *help, const MHIST *h)
    {
-   char  tmp [512];
+   uint64_t total = 0;
+   int      i;
 
-   /* "l4type" should be "INFO", "toCct", "txSeq" and "rxSeq" should all
-    * be 0, if you want to bother to check them
-    * */
+   metric_header (ob, name, "histogram", help);
 
-   if (json_getValue (json, "paylen", tmp, 8))
-         uprintf (" ilen=%s", tmp);
+   for (i = 0; i < M_BUCKETS; i++)
+      {
+      total += h->count [i];
+
+      if (i < M_BUCKETS - 1)
+         metric_printf (ob, "pnmptrace_%s_bucket{le=\"%g\"} %llu\n",
+            name, MetricBound [i] / 1e9, (unsigned long long) total);
+      else
+         metric_printf (ob, "pnmptrace_%s_bucket{le=\"+Inf\"} %llu\n",
+            name, (unsigned long long) total);
+      }
 
-   if ((TraceFlags & TRACE_L3RTT) == 0) return;
+   metric_printf (ob, "pnmptrace_%s_sum %.9f\n", name, h->ns / 1e9);
+   metric_printf (ob, "pnmptrace_%s_count %llu\n", name,
+      (unsigned long long) total);
+   }
 
-   // Payload chan be up to 236 chara, so it will wrap untidily
-   /// TODO: parse the payload & present the fields in a neater form
+/**********************************************************************/
+/* Purpose:    Build the response to a scrape
+ * Called by:  metric_thread()
+ * Arguments:  Buffer to receive the metrics, in the text format
+ * Notes:      The single counters, owned by the main thread, are read
+ *             without a lock.  They may be a record out of date, which
+ *             doesn't matter here.
+ * Created:    14/10/2026
+ * Modified:   14/10/2026 for reloaded filters, and to count bytes,
+ *             and to export the input queue's counters. */
+/**********************************************************************/
 
-   if (json_getValue (json, "payload", tmp, 511))
-      uprintf (":%s%s", Margin, tmp);
-   }
+static void metric_scrape (OUTBUF *ob)
+   {
+   static const char *reason [M_ERRORS] =
+      { "oversize", "missing_type", "missing_mandatory", "bad_field" };
+   METRICS  m;
+   size_t   logged = 0;
+   const char *cp;
+   int      i, j;
+
+   Cfg = config_get ();
+   metric_sum (&m);
+
+   metric_header (ob, "records_read_total", "counter",
+      "Records read from the inputs");
+   metric_printf (ob, "pnmptrace_records_read_total %llu\n",
+      (unsigned long long) m.records);
+
+   metric_header (ob, "bytes_read_total", "counter",
+      "Bytes in the records read");
+   metric_printf (ob, "pnmptrace_bytes_read_total %llu\n",
+      (unsigned long long) m.bytes);
+
+   metric_header (ob, "frames_examined_total", "counter",
+      "Frames offered to the filters");
+   metric_printf (ob, "pnmptrace_frames_examined_total %llu\n",
+      (unsigned long long) m.examined);
+
+   metric_header (ob, "frames_shown_total", "counter",
+      "Frames passing the filters");
+   metric_printf (ob, "pnmptrace_frames_shown_total %llu\n",
+      (unsigned long long) m.shown);
+
+   if (Cfg->numFilters)
+      {
+      metric_header (ob, "filter_rejected_total", "counter",
+         "Frames rejected, by filter");
+
+      for (i = 0; i < Cfg->numFilters; i++)
+         {
+         metric_printf (ob, "pnmptrace_filter_rejected_total{filter=\"");
+
+         // Label values need quotes and backslashes escaped
+         for (cp = Cfg->plan [i].option; *cp; cp++)
+            {
+            if (*cp == '"' || *cp == '\\') out_append (ob, "\\", 1);
+            out_append (ob, cp, 1);
+            }
+
+         metric_printf (ob, "\"} %llu\n",
+            (unsigned long long) m.rejects [i]);
+         }
+      }
 
+   metric_header (ob, "parse_errors_total", "counter",
+      "Records that could not be decoded, by reason");
+
+   for (j = 0; j < M_ERRORS; j++)
+      metric_printf (ob, "pnmptrace_parse_errors_total{reason=\"%s\"} "
+         "%llu\n", reason [j], (unsigned long long) m.errors [j]);
+
+   metric_header (ob, "duplicates_dropped_total", "counter",
+      "Duplicate reports dropped by \"-d\"");
+   metric_printf (ob, "pnmptrace_duplicates_dropped_total %lu\n",
+      DedupDropped);
+
+   metric_header (ob, "callsigns", "gauge",
+      "Callsigns held in the intern table");
+   metric_printf (ob, "pnmptrace_callsigns %d\n", InternCount);
+
+   metric_header (ob, "callsign_evictions_total", "counter",
+      "Callsigns evicted from the intern table");
+   metric_printf (ob, "pnmptrace_callsign_evictions_total %lu\n",
+      InternEvictions);
+
+   metric_histogram (ob, "decode_seconds",
+      "Time taken to decode and format a record", &m.decode);
+   metric_histogram (ob, "output_seconds",
+      "Time taken to write out the output", &m.output);
+
+   metric_header (ob, "input_backlog_records", "gauge",
+      "Records waiting in the input queues");
+   metric_printf (ob, "pnmptrace_input_backlog_records{queue=\"pipeline\"}"
+      " %lu\n", PipeHead - PipeTail);
+   metric_printf (ob, "pnmptrace_input_backlog_records{queue=\"merge\"}"
+      " %d\n", MergeCount);
+   metric_printf (ob, "pnmptrace_input_backlog_records{queue=\"input\"}"
+      " %lu\n", QueueHead - QueueTail);
+
+   metric_header (ob, "input_dropped_total", "counter",
+      "Records dropped by the \"-Q\" overload policy");
+   metric_printf (ob, "pnmptrace_input_dropped_total %lu\n",
+      __atomic_load_n (&QueueDropped, __ATOMIC_RELAXED));
+
+   metric_header (ob, "output_lag_seconds", "gauge",
+      "How far the output is behind the records' time stamps");
+   metric_printf (ob, "pnmptrace_output_lag_seconds %ld\n",
+      __atomic_load_n (&QueueLag, __ATOMIC_RELAXED));
+
+   pthread_mutex_lock (&LogLock);
+   for (i = 0; i < 2; i++)
+      logged += TraceLog.queue [i].out.len + JsonLog.queue [i].out.len;
+   pthread_mutex_unlock (&LogLock);
+
+   metric_header (ob, "log_queue_bytes", "gauge",
+      "Bytes waiting to be written to the capture files");
+   metric_printf (ob, "pnmptrace_log_queue_bytes %zu\n", logged);
+   }
 
 /**********************************************************************/
-/* Purpose:    Display the L3 routing header, then trace layer 4
- * Called by:  trace_netrom() if l3Type is "netrom".
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Displays the L3 source and dest calls, and TTL, then
- *             traces layer 4.
- * Affects:    stdout only
- * Returns:    None
- * Created:    24/10/2025 by Paula Dowie G8PZT.
+/* Purpose:    Answer metrics requests
+ * Called by:  Thread started by metric_start()
+ * Actions:    Accepts a connection, reads the request, and sends the
+ *             metrics if it is for "/metrics", or 404 if not, then
+ *             closes the connection.
+ * Notes:      A client that doesn't send its request within two
+ *             seconds is dropped, so it can't stall the scrapes.
+ * Created:    14/10/2026
  * Modified:   */
 /**********************************************************************/
 
-static void trace_netromL3 (const char *json)
+static void *metric_thread (void *arg)
    {
-   char tmp [16];
-   bool  isL3RTT;
+   struct timeval tv = { 2, 0 };
+   OUTBUF   body = { 0 }, reply = { 0 };
+   char     req [1024];
+   ssize_t  n;
+   size_t   len;
+   int      fd;
 
-   if (json_getValue (json, "l3src", tmp, 10))
-      uprintf ("%sNTRM: %s", Margin, tmp); // Layer 3 source
+   (void) arg;
 
-   if (json_getValue (json, "l3dst", tmp, 10))
-      uprintf (" to %s", tmp);       // layer 3 dest
+   while ((fd = accept (MetricFd, NULL, NULL)) >= 0 || errno == EINTR)
+      {
+      if (fd < 0) continue;
 
-   isL3RTT = (strcmp (tmp, "L3RTT") == 0);
+      setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
 
-   if (json_getValue (json, "ttl", tmp, 8))
-      uprintf (" ttl=%s", tmp);      // Layer 3 time to live
+      // Read until the end of the request headers
+      for (len = 0, *req = 0; len < sizeof (req) - 1; )
+         {
+         if ((n = recv (fd, req + len, sizeof (req) - 1 - len, 0)) <= 0)
+            break;
+         req [len += n] = 0;
+         if (strstr (req, "\r\n\r\n") || strstr (req, "\n\n")) break;
+         }
 
-   if (isL3RTT) trace_l3rtt (json);
-   else trace_netromL4 (json);
+      body.len = reply.len = 0;
+
+      if (strncmp (req, "GET /metrics ", 13) == 0
+         || strncmp (req, "GET /metrics?", 13) == 0)
+         {
+         metric_scrape (&body);
+         metric_printf (&reply, "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n\r\n", body.len);
+         out_append (&reply, body.buf, body.len);
+         }
+      else
+         metric_printf (&reply, "HTTP/1.0 404 Not Found\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 10\r\n\r\nNot found\n");
+
+      for (len = 0; len < reply.len; len += n)
+         if ((n = send (fd, reply.buf + len, reply.len - len,
+            MSG_NOSIGNAL)) <= 0) break;
+
+      close (fd);
+      }
+
+   free (body.buf);
+   free (reply.buf);
+
+   return (NULL);
    }
 
 /**********************************************************************/
-/* Purpose:    Trace NetRom (PID 0xCF) frames
- * Called by:  process_json() only.
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Calls the appropriate decoder based on l3Type
- * Affects:    stdout only
- * Returns:    None
- * Created:    24/10/2025 by Paula Dowie G8PZT.*/
+/* Purpose:    Start the metrics listener
+ * Called by:  main(), if "-E" was given
+ * Actions:    Parses MetricAddr, which is "[host:]port", opens a
+ *             listening socket on it, on all interfaces if there is
+ *             no host, and starts the thread that serves it.
+ * Returns:    0 if successful, else -1
+ * Notes:      The thread is started with SIGINT and SIGTERM blocked,
+ *             so that they still end the input loop.
+ * Created:    14/10/2026
+ * Modified:   */
 /**********************************************************************/
 
-static void trace_netrom (const char *json)
+static int metric_start (void)
    {
-   char  tmp [80];
+   struct addrinfo hints, *res, *ai;
+   char     host [64], *port;
+   sigset_t set, old;
+   int      err, on = 1, rc;
+
+   strcpy (host, MetricAddr);
+
+   if ((port = strrchr (host, ':')) != NULL) *port++ = 0;
+   else port = host;
 
-   if ((TraceFlags & TRACE_NETROM) == 0) return;
+   memset (&hints, 0, sizeof (hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = AI_PASSIVE;
 
-   if (json_getValue (json, "l3Type", tmp, 79) == 0)
+   if ((err = getaddrinfo (port == host ? NULL : host, port, &hints,
+      &res)) != 0)
       {
-      if (TraceFlags & TRACE_WARNINGS)
-         uprintf (" [missing 'l3Type']");
-      return;
+      fprintf (stderr, "Metrics address %s: %s\n", MetricAddr,
+         gai_strerror (err));
+      return (-1);
       }
 
-   if (strcmp (tmp, "NetRom") == 0) trace_netromL3 (json);
-
-   else if (strcmp (tmp, "Routing info") == 0)
-      trace_netromRoutingInfo (json);
+   for (ai = res; ai; ai = ai->ai_next)
+      {
+      if ((MetricFd = socket (ai->ai_family, ai->ai_socktype,
+         ai->ai_protocol)) < 0) continue;
 
-   else if (strcmp (tmp, "Routing poll") == 0)
-      trace_netromRoutingPoll (json);
+      setsockopt (MetricFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
 
-   else if (TraceFlags & TRACE_WARNINGS)
-      uprintf (" [unknown 'l3type': '%s'", tmp);
-   }
+      if (bind (MetricFd, ai->ai_addr, ai->ai_addrlen) == 0
+         && listen (MetricFd, 8) == 0) break;
 
-/**********************************************************************/
-/* Purpose:    Process a serialised JSON object.
- * Called by:  main() only.
- * Arguments:  Pointer to string containing serialised JSON object.
- * Actions:    Extracts values from the JSON string, applies filters,
- *             sets trace colours, traces AX25 layer2 frame and
- *             optionally into the layers above.
- * Affects:    stdout only.
- * Returns:    None
- * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
-/**********************************************************************/
+      close (MetricFd);
+      MetricFd = -1;
+      }
 
-static void process_json (const char *json)
-   {
-   char  tmp [1024], reporter [16], portnum [16], src [16], dst [16];
-   char  l2type [8], dirn [8], isRF [8], ptcl [8];
+   freeaddrinfo (res);
 
-   if (json_getValue (json, "@type", tmp, 80) == 0)
+   if (MetricFd < 0)
       {
-      if (TraceFlags & TRACE_WARNINGS)
-         printf ("[missing '@type']\n");
-      return;
+      fprintf (stderr, "Can't listen for metrics on %s: %s\n",
+         MetricAddr, strerror (errno));
+      return (-1);
       }
 
-   /// TODO: Test for and process other report types here if desired
-   if (strcmp (tmp, "L2Trace") != 0) return;
+   fcntl (MetricFd, F_SETFD, FD_CLOEXEC);
 
-   // Extract some mandatory fields
-   if (json_getValue (json, "reportFrom", reporter, 15) == NULL
-   || json_getValue (json, "port", portnum, 15) == NULL
-   || json_getValue (json, "srce", src, 15) == NULL
-   || json_getValue (json, "dest", dst, 15) == NULL
-   || json_getValue (json, "l2Type", l2type, 7) == NULL)
-      {
-      if (TraceFlags & TRACE_WARNINGS)
-         printf ("[Mandatory field missing]\n");
-      return;
-      }
+   sigemptyset (&set);
+   sigaddset (&set, SIGINT);
+   sigaddset (&set, SIGTERM);
+   pthread_sigmask (SIG_BLOCK, &set, &old);
 
-   // Extract some of the optional values.
-   if (json_getValue (json, "dirn", dirn, 4) == NULL) *dirn = 0;
-   if (json_getValue (json, "isRF", isRF, 4) == NULL) *isRF = 0;
-   if (json_getValue (json, "ptcl", ptcl, 7) == NULL) *ptcl = 0;
+   rc = pthread_create (&MetricThread, NULL, metric_thread, NULL);
 
-   if (strcmp (l2type, "UI") == 0
-   && (TraceFlags & TRACE_UI) == 0)
-      return;   // UI Not wanted
+   pthread_sigmask (SIG_SETMASK, &old, NULL);
 
-   // Filter by reporting node
-   if (*ReportFilter // If report filter is enabled
-   && strcasecmp (reporter, ReportFilter) != 0) // and no match
-      return;  // Ignore this packet
+   return (rc ? -1 : 0);
+   }
 
-   // Filter by node's port number
-   if (PortFilter && atoi (portnum) != PortFilter) return;
+#endif   // WIN32
 
-   // Filter by packet type
-   if (*TypeFilter
-   && strcasecmp (l2type, TypeFilter) != 0)
-      return;
+//######################################################################
+//                         BENCHMARK FUNCTIONS
+//######################################################################
 
-   // Filter by AX25 source call
-   if (*SrcFilter
-   && strcasecmp (src, SrcFilter) != 0)
-      return;
+/* "-G <count>[:<mix>]" writes a synthetic corpus of PNMP JSON records
+ * to stdout, so that performance can be measured without a feed, and
+ * measured the same way each time.  The mix gives the relative weight
+ * of each kind of record, plus the size of those which vary, e.g.
+ * "-G 1000000:ui=30,nodes=10,entries=40,l4=20,payload=236".  The same
+ * seed always gives the same corpus.
+ *
+ * "-b" times each stage of the decoding, and writes a report to stderr
+ * on exit, as a single JSON object, so that the results of different
+ * versions can be compared by a script.  The stage times are added up
+ * over all the threads, whereas the rates are from the elapsed time.
+ * */
+#define  GEN_UI         0        // UI frame with text
+#define  GEN_I          1        // I frame with text
+#define  GEN_RR         2        // Supervisory frame
+#define  GEN_NODES      3        // NetRom NODES broadcast
+#define  GEN_INP3       4        // INP3 routing unicast
+#define  GEN_L4         5        // NetRom L4 INFO with payload
+#define  GEN_IP         6        // IP datagram
+#define  GEN_ARP        7        // ARP packet
+#define  GEN_KINDS      8
+
+static const char *GenKind [GEN_KINDS] =
+   { "ui", "i", "rr", "nodes", "inp3", "l4", "ip", "arp" };
+
+static int        GenWeight [GEN_KINDS] =   // Default mix
+   { 30, 15, 15, 5, 5, 20, 5, 5 };
+static long       GenCount = 0;     // Records to write, 0 = don't
+static int        GenEntries = 20;  // Entries per NODES or INP3
+static int        GenPayload = 200; // Bytes of L4 INFO payload
+static uint64_t   GenSeed = 1;      // Random number seed
+
+static int        Bench = 0;        // Set by "-b"
+static uint64_t   BenchStart;       // When the input started, ns
+
+static const char *GenCall [] =
+   { "G8PZT", "G8PZT-1", "GB7BDH", "M1BFP-1", "KIDDER", "GB7RDG-7",
+     "G4XYZ-15", "MB7NPW", "GB7SWN", "G0ABC-2", "M0XYZ", "GB7WEM-4" };
+
+static const char *GenAlias [] =
+   { "PZTDB", "BDH", "KIDD", "RDG", "SWINDN", "WEM", "NPW", "ABC" };
+
+#define  GEN_NCALLS     (sizeof (GenCall) / sizeof (GenCall [0]))
+#define  GEN_NALIASES   (sizeof (GenAlias) / sizeof (GenAlias [0]))
 
-   // Filter by AX25 source and destination calls
-   if (*DstFilter
-   && strcasecmp (dst, DstFilter) != 0)
-      return;
+/**********************************************************************/
+/* Purpose:    Parse the "-G" option
+ * Called by:  main()
+ * Arguments:  Option value, "<count>[:<name>=<value>,...]", where the
+ *             names are the kinds of record, "entries", "payload" or
+ *             "seed".
+ * Affects:    GenCount, GenWeight, GenEntries, GenPayload and GenSeed
+ * Returns:    0 if successful, else -1 (message already printed)
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
 
-   // Filter by either AX25 source or destination call
-   if (*AllFilter
-   && strcasecmp (dst, AllFilter) != 0
-   && strcasecmp (src, AllFilter) != 0)
-      return;
+static int gen_option (const char *value)
+   {
+   const char  *cp, *eq;
+   int         i, len, n;
 
-   // Filter by protocol ID
-   if (*ProtoFilter
-   && (*ptcl == 0 || strcasecmp (ptcl, ProtoFilter)) != 0)
-      return;
+   if ((GenCount = atol (value)) <= 0)
+      {
+      printf ("Bad record count '%s'\n", value);
+      return (-1);
+      }
 
+   if ((cp = strchr (value, ':')) == NULL) return (0);
 
-   if (TraceFlags & TRACE_COLOR)
+   while (*++cp)
       {
-      const char *colorstr;
+      len = strcspn (cp, ",");
 
-      if (*isRF == 't') // True
+      if ((eq = memchr (cp, '=', len)) == NULL)
          {
-         switch (*dirn)
-            {
-            case 's':   colorstr = "\x1b[91m";   break; // red
-            case 'r':   colorstr = "\x1b[92m";   break; // green
-            default:    colorstr = "\x1b[93m";   break; // yellow
-            }
+         printf ("Expected <name>=<value> in '%.*s'\n", len, cp);
+         return (-1);
          }
 
-      else if (*isRF == 'f')  // False
+      n = atoi (eq + 1);
+
+      for (i = 0; i < GEN_KINDS; i++)
          {
-         switch (*dirn)
-            {
-            case 's':   colorstr = "\x1b[38;2;255;150;150m";  break;
-            case 'r':   colorstr = "\x1b[38;2;50;255;150m";   break; // Cyan
-            default:    colorstr = "\x1b[94m";   break; // Blue
-            }
+         if (strlen (GenKind [i]) == eq - cp
+         && strncmp (GenKind [i], cp, eq - cp) == 0) break;
          }
 
-      else  // Unknown RF/Inet status
-         colorstr = "\x1b[0m";  // white
+      if (i < GEN_KINDS) GenWeight [i] = (n < 0) ? 0 : n;
+      else if (strncmp (cp, "entries=", 8) == 0) GenEntries = n;
+      else if (strncmp (cp, "payload=", 8) == 0) GenPayload = n;
+      else if (strncmp (cp, "seed=", 5) == 0) GenSeed = n;
 
-      /* Sending colour information to capture file allows it to be
-       * played back in colour but makes it difficult to read with a
-       * text editor. Therefore it is turned off by default.
-       * */
-      if (TraceFlags & TRACE_COLOR2FILE) uprintf ("%s", colorstr);
-      else printf ("%s", colorstr);
-      }
+      else
+         {
+         printf ("Unknown record kind '%.*s'\n", (int) (eq - cp), cp);
+         return (-1);
+         }
 
-   // If raw JSON wanted, print it before the trace (defaults off)
-   if (TraceFlags & TRACE_JSON) uprintf ("%s\n", json);
+      cp += len;
+      if (*cp == 0) break;
+      }
 
-   // Print a blank line between traces (dedaults on)
-   if (TraceFlags & TRACE_LBRK) uprintf ("\n");
+   if (GenEntries < 0) GenEntries = 0;
+   if (GenPayload < 1) GenPayload = 1;
+   return (0);
+   }
 
-   // If timestamp is wanted (defaults on)
-   if (TraceFlags & TRACE_STAMP)
+// Fill an array with pseudo-random numbers (xorshift64*)
+static void gen_random (unsigned *r, int n)
+   {
+   while (n-- > 0)
       {
-      struct tm   *tp;
-      time_t      t;
+      GenSeed ^= GenSeed >> 12;
+      GenSeed ^= GenSeed << 25;
+      GenSeed ^= GenSeed >> 27;
+      *r++ = (unsigned) ((GenSeed * 0x2545F4914F6CDD1DULL) >> 32);
+      }
+   }
 
-      if (json_getValue (json, "time", tmp, 20)) t = atoi (tmp);
-      else t = time (NULL);
+/* The numbers for each record are drawn before it is formatted, as the
+ * order in which function arguments are evaluated is unspecified, and
+ * the corpus must be the same whatever the compiler.
+ * */
+#define  GEN_RANDOMS    16       // Random numbers per record
+#define  GEN_CALL(x)    GenCall [(x) % GEN_NCALLS]
+#define  GEN_ALIAS(x)   GenAlias [(x) % GEN_NALIASES]
+#define  GEN_BOOL(x)    (((x) & 1) ? "true" : "false")
+
+/**********************************************************************/
+/* Purpose:    Write the fields common to all the synthetic records
+ * Called by:  gen_run()
+ * Arguments:  Time of the record, AX25 frame type, the record's random
+ *             numbers, of which it uses the first 8.
+ * Actions:    Writes the opening brace and the L2 fields, leaving the
+ *             object open for the caller to add its own.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
 
-      tp = gmtime (&t);
+static void gen_l2 (long t, const char *l2type, const unsigned *r)
+   {
+   printf ("{\"@type\":\"L2Trace\",\"reportFrom\":\"%s\",\"time\":%ld,"
+      "\"port\":\"%u\",\"srce\":\"%s\",\"dest\":\"%s\",\"ctrl\":%u,"
+      "\"l2Type\":\"%s\",\"cr\":\"%s\",\"dirn\":\"%s\",\"isRF\":%s",
+      GenCall [r [0] % 5 * 2], t, r [1] % 9 + 1, GEN_CALL (r [2]),
+      GEN_CALL (r [3]), r [4] & 0xFF, l2type, (r [5] & 1) ? "C" : "R",
+      (r [6] & 1) ? "sent" : "rcvd", GEN_BOOL (r [7]));
+   }
 
-      uprintf ("%02d:%02d:%02d ",
-         tp->tm_hour, tp->tm_min, tp->tm_sec);
-      }
+/**********************************************************************/
+/* Purpose:    Write a synthetic corpus
+ * Called by:  main() if the "-G" option is used
+ * Actions:    Writes GenCount records to stdout, one per line, each of
+ *             a kind chosen at random in proportion to GenWeight.  The
+ *             time advances by a second every tenth record.
+ * Returns:    0 if successful, else -1
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static int gen_run (void)
+   {
+   static const char *stype [4] = { "RR", "RNR", "REJ", "SREJ" };
+   static const char text [] = "Hello {world} [test] 73 de G8PZT ";
+   unsigned r [GEN_RANDOMS], e [GEN_RANDOMS];
+   char     *payload;
+   long     n, t = 1761300000;
+   int      i, kind, total = 0;
+
+   for (i = 0; i < GEN_KINDS; i++) total += GenWeight [i];
 
-   if (TraceFlags & TRACE_HDRLIN)
+   if (total == 0)
       {
-      // Metadata and trace on separate lines for clarity
-      uprintf ("%s port %s", reporter, portnum);
-      if (*isRF) uprintf (*isRF == 't' ? " (RF)" : " (Non-RF)");
-      if (*dirn) uprintf (" %s", dirn);
-      uprintf (":\n  ");
+      printf ("Nothing to generate\n");
+      return (-1);
       }
-   else // Metadata and trace on one messy line
-      {
-      sprintf (tmp, "%s(%s)%c",
-         reporter, portnum, *dirn ? toupper (*dirn) : ' ');
 
-      uprintf ("%s ", tmp);
-      }
+   if ((payload = malloc (GenPayload + 1)) == NULL) return (-1);
 
-   // Display L2 source, destination and type
-   uprintf ("%s>%s <%s", src, dst, l2type);
+   for (i = 0; i < GenPayload; i++)
+      payload [i] = text [i % (sizeof (text) - 1)];
+   payload [GenPayload] = 0;
 
-   // The format of these varies with frame type...
-   if (json_getValue (json, "cr", tmp, 2)) uprintf (" %s", tmp);
-   if (json_getValue (json, "pf", tmp, 2)) uprintf (" %s", tmp);
-   if (json_getValue (json, "rseq", tmp, 3)) uprintf (" R%s", tmp);
-   if (json_getValue (json, "tseq", tmp, 3)) uprintf (" S%s", tmp);
-   uprintf (">");
+   for (n = 0; n < GenCount; n++)
+      {
+      if (n % 10 == 0) t++;
 
-   // Display info field length and pid if present
-   if (json_getValue (json, "ilen", tmp, 10)) uprintf (" ilen=%s", tmp);
-   if (json_getValue (json, "pid", tmp, 10)) uprintf (" pid=%s", tmp);
-   if (*ptcl) uprintf (" %s", ptcl);
+      gen_random (r, GEN_RANDOMS);
 
-   // Decode some payloads
-   if (*ptcl)
-      {
-      if (strcmp (ptcl, "NET/ROM") == 0) trace_netrom (json);
+      for (kind = 0, i = r [15] % total; i >= GenWeight [kind];
+         i -= GenWeight [kind++]);
 
-      else if (strcmp (ptcl, "DATA") == 0)
+      switch (kind)
          {
-         // The "info" field is present only for "UI" frames
-         if (json_getValue (json, "info", tmp, 1023))
-            uprintf (":%s%s", Margin, tmp);
+         case GEN_UI:
+            gen_l2 (t, "UI", r);
+            printf (",\"ptcl\":\"DATA\",\"pid\":240,\"ilen\":%d,"
+               "\"info\":\"%.*s\"", 20, 20, payload);
+            break;
+
+         case GEN_I:
+            gen_l2 (t, "I", r);
+            printf (",\"rseq\":%u,\"tseq\":%u,\"ptcl\":\"DATA\","
+               "\"pid\":240,\"ilen\":%d,\"info\":\"%.*s\"",
+               r [8] & 7, r [9] & 7, 32, 32, payload);
+            break;
+
+         case GEN_RR:
+            gen_l2 (t, stype [r [8] & 3], r);
+            printf (",\"rseq\":%u,\"pf\":\"%s\"", r [9] & 7,
+               (r [10] & 1) ? "P" : "F");
+            break;
+
+         case GEN_NODES:
+            gen_l2 (t, "UI", r);
+            printf (",\"ptcl\":\"NET/ROM\",\"pid\":207,\"ilen\":%d,"
+               "\"l3Type\":\"Routing info\",\"type\":\"NODES\","
+               "\"fromAlias\":\"%s\",\"nodes\":[", 7 + GenEntries * 21,
+               GEN_ALIAS (r [8]));
+
+            for (i = 0; i < GenEntries; i++)
+               {
+               gen_random (e, 4);
+               printf ("%s{\"call\":\"%s\",\"alias\":\"%s\","
+                  "\"via\":\"%s\",\"qual\":%u}", i ? "," : "",
+                  GEN_CALL (e [0]), GEN_ALIAS (e [1]), GEN_CALL (e [2]),
+                  e [3] & 0xFF);
+               }
 
-         // The "icrc" field is present only for "I" frames
-         else if (json_getValue (json, "icrc", tmp, 8))
-            uprintf (" CRC=%s", tmp);
-         }
+            printf ("]");
+            break;
 
-      else if (strcmp (ptcl, "IP") == 0) trace_ip (json);
+         case GEN_INP3:
+            gen_l2 (t, "I", r);
+            printf (",\"rseq\":%u,\"tseq\":%u,\"ptcl\":\"NET/ROM\","
+               "\"pid\":207,\"ilen\":%d,\"l3Type\":\"Routing info\","
+               "\"type\":\"INP3\",\"nodes\":[", r [8] & 7, r [9] & 7,
+               10 + GenEntries * 12);
 
-      else if (strcmp (ptcl, "ARP") == 0) trace_arp (json);
-      /// TODO: Add flexnet
+            for (i = 0; i < GenEntries; i++)
+               {
+               gen_random (e, 8);
+               printf ("%s{\"call\":\"%s\",\"hops\":%u,\"tt\":%u",
+                  i ? "," : "", GEN_CALL (e [0]), e [1] % 9 + 1,
+                  e [2] % 60000 + 1);
+
+               // The optional fields are sent now and then
+               if (e [3] & 1) printf (",\"alias\":\"%s\"",
+                  GEN_ALIAS (e [4]));
+
+               if ((e [5] & 3) == 0) printf (",\"latitude\":"
+                  "\"5128.75N\",\"longitude\":\"00146.46W\"");
+
+               if ((e [6] & 3) == 0) printf (",\"software\":"
+                  "\"XRPi\",\"version\":\"504k\",\"isNode\":true,"
+                  "\"isBBS\":%s,\"tzMins\":60", GEN_BOOL (e [7]));
+
+               printf ("}");
+               }
+
+            printf ("]");
+            break;
+
+         case GEN_L4:
+            gen_l2 (t, "I", r);
+            printf (",\"rseq\":%u,\"tseq\":%u,\"ptcl\":\"NET/ROM\","
+               "\"pid\":207,\"ilen\":%d,\"l3Type\":\"NetRom\","
+               "\"l3src\":\"%s\",\"l3dst\":\"%s\",\"ttl\":%u,"
+               "\"l4type\":\"INFO\",\"toCct\":%u,\"fromCct\":%u,"
+               "\"txSeq\":%u,\"rxSeq\":%u,\"paylen\":%d,"
+               "\"payload\":\"%s\"", r [8] & 7, r [9] & 7,
+               GenPayload + 20, GEN_CALL (r [10]), GEN_CALL (r [11]),
+               r [12] % 25 + 1, r [13] & 0xFFFF, r [13] >> 16,
+               r [14] & 0xFF, (r [14] >> 8) & 0xFF, GenPayload,
+               payload);
+            break;
+
+         case GEN_IP:
+            gen_l2 (t, "UI", r);
+            printf (",\"ptcl\":\"IP\",\"pid\":204,\"ilen\":60,"
+               "\"ipFrom\":\"44.131.%u.%u\",\"ipTo\":\"44.131.%u.%u\","
+               "\"ipLen\":60,\"ipTTL\":%u,\"ipID\":\"%04X\","
+               "\"ipPtcl\":1,\"ipProto\":\"ICMP\"", r [8] & 0xFF,
+               r [9] & 0xFF, r [10] & 0xFF, r [11] & 0xFF,
+               r [12] % 64 + 1, r [13] & 0xFFFF);
+            break;
+
+         case GEN_ARP:
+            gen_l2 (t, "UI", r);
+            printf (",\"ptcl\":\"ARP\",\"pid\":205,\"ilen\":30,"
+               "\"arpOp\":\"REQUEST\",\"arpHwType\":3,\"arpHwLen\":7,"
+               "\"arpPtcl\":\"IP\",\"arpSndAddr\":\"44.131.1.%u\","
+               "\"arpTgtAddr\":\"44.131.1.%u\",\"arpSndHw\":\"%s\","
+               "\"arpTgtHw\":\"%s\"", r [8] & 0xFF, r [9] & 0xFF,
+               GEN_CALL (r [10]), GEN_CALL (r [11]));
+            break;
+         }
+
+      printf ("}\n");
       }
 
-   uprintf ("\n");
+   free (payload);
+   fflush (stdout);
+
+   return (ferror (stdout) ? -1 : 0);
+   }
+
+/**********************************************************************/
+/* Purpose:    Write the benchmark report
+ * Called by:  main() on exit, if "-b" was used
+ * Actions:    Adds up the threads' counters, and writes the records
+ *             and bytes read, the rates, and the time spent in each
+ *             stage, as a JSON object on one line.  Formatting is
+ *             whatever the decoding took besides tokenizing and
+ *             filtering.
+ * Affects:    stderr, so as not to pollute the trace output.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void bench_report (void)
+   {
+   METRICS  m;
+   double   secs = (metric_now () - BenchStart) / 1e9;
+   uint64_t format;
+
+   metric_sum (&m);
+
+   format = m.decode.ns - m.extractNs - m.filterNs;
+   if (m.decode.ns < m.extractNs + m.filterNs) format = 0;
+   if (secs <= 0) secs = 1e-9;
+
+   fprintf (stderr, "{\"version\":\"%s\",\"threads\":%d,"
+      "\"records\":%llu,\"bytes\":%llu,\"secs\":%.6f,"
+      "\"records_per_sec\":%.0f,\"mb_per_sec\":%.3f,"
+      "\"frame_ns\":%llu,\"extract_ns\":%llu,\"filter_ns\":%llu,"
+      "\"format_ns\":%llu,\"output_ns\":%llu}\n",
+      VERSION, Threads, (unsigned long long) m.records,
+      (unsigned long long) m.bytes, secs, m.records / secs,
+      m.bytes / secs / 1e6, (unsigned long long) m.frameNs,
+      (unsigned long long) m.extractNs,
+      (unsigned long long) m.filterNs, (unsigned long long) format,
+      (unsigned long long) m.output.ns);
+   }
+
+/**********************************************************************/
+/* Purpose:    Handle SIGINT and SIGTERM
+ * Actions:    Sets the "Quit" flag, so that the input loop ends and
+ *             the program can report its counts and exit tidily.
+ * Created:    14/10/2026
+ * Modified:   */
+/**********************************************************************/
+
+static void on_signal (int sig)
+   {
+   Quit = 1;
+   }
+
+#ifndef WIN32
+// Handle SIGUSR1, asking for the route table to be shown
+static void on_query (int sig)
+   {
+   RouteQuery = 1;
+   }
+
+// Handle SIGHUP, asking for the "-e" file to be read again
+static void on_reload (int sig)
+   {
+   Reload = 1;
    }
 
+#ifdef PROFILE
+// Handle SIGUSR2, asking for the profile report
+static void on_profile (int sig)
+   {
+   ProfQuery = 1;
+   }
+#endif
+#endif
+
 /**********************************************************************/
 /* Purpose:    Display program help.
  * Called by:  main() if "-h" switch is found.
@@ -1226,47 +10910,77 @@ static void showHelp (void)
    "   -3              Don't trace NetRom layer 3 or above\n"
    "   -4              Don't trace NetRom layer 4 or above\n"
    "   -a <callsign>   Show ALL frames to or from <callsign>\n"
+   "                   (callsigns may be lists, e.g. \"G8PZT*,M1BFP-1\",\n"
+   "                   or \"@file\" to read a list from a file)\n"
+   "   -b              Time each stage, and report to stderr on exit\n"
+   "   -B <file>       Save the JSON records to binary capture <file>\n"
    "   -c              Don't colourise the traces\n"
+   "   -d <secs>[:<n>] Drop duplicate reports of a frame within <secs>\n"
+   "                   (by the reporters' clocks, so allow for skew)\n"
+   "   -e <file>       Read more filter/display options from <file>,\n"
+   "                   and again on SIGHUP\n"
+   "   -E [<host>:]<port> Serve Prometheus metrics on <port>\n"
    "   -C              Include colour information in capture file\n"
    "   -f <callsign>   Show only frames addressed FROM <callsign>\n"
+   "   -F <n>[s]       Flush output every <n> traces or <n>s seconds\n"
+   "   -G <n>[:<mix>]  Write <n> synthetic records to stdout and exit\n"
    "   -h              Show this message and exit\n"
    "   -H              Show header on separate line to trace\n"
    "   -i              Don't trace contents of INP3 routing unicasts\n"
+   "   -I <file>       Replay JSON from <file> instead of stdin\n"
+   "                   (\"-\" is stdin, may be repeated to merge inputs)\n"
    "   -j              Show the raw JSON before each trace\n"
+   "   -J <file>       Archive the JSON of each trace shown to <file>\n"
    "   -k              Don't show L3RTT info field\n"
    "   -l              Suppress blank line between traces\n"
+   "   -L <secs>[:<n>] Show AX25 link health every <secs> instead\n"
+   "   -m <threads>    Number of decode threads (default 1)\n"
+   "   -M <broker>     Subscribe to MQTT broker, host[:port][/topic]\n"
    "   -n              Don't trace contents of NetRom nodes broadcasts\n"
+   "   -N <secs>[:<n>] Show NetRom route table every <secs> instead\n"
    "   -o <file>       Output trace to <file>\n"
+   "   -O <format>     Write \"ndjson\", \"csv\" or \"bin\" records instead\n"
    "   -p <portnum>    Show reports only from <portnum>\n"
-   "   -P <protocol>   Show only frames with this L3 protocol\n"
+   "   -P <protocol>   Show only frames with this L3 protocol(s)\n"
    "   -q              No display when capturing to file (quiet)\n"
+   "   -Q <policy>[:<n>] Queue <n> records, \"block\", \"oldest\" or \"low\"\n"
    "   -r <callsign>   Show reports only from <callsign>\n"
+   "   -R <seconds>    Reorder window when merging inputs (default 2)\n"
    "   -s              Suppress time stamp\n"
+   "   -S <seconds>    Show statistics every <seconds> instead of traces\n"
    "   -t <callsign>   Show only frames addressed TO <callsign>\n"
-   "   -T <frametype>  Show only this AX25 frametype, e.g. \"-T UI\"\n"
+   "   -T <frametype>  Show only this AX25 frametype(s), e.g. \"-T I,UI\"\n"
    "   -u              Don't display UI frames\n"
+   "   -V <timeout>    Show a summary of each NetRom circuit instead\n"
    "   -w <width>      Display width (default 80 cols)\n"
-   "   -W              Enable warnings of missing/bad JSON fields\n\n");
+   "   -W              Enable warnings of missing/bad JSON fields\n"
+   "   -X <size>       Rotate -o/-J files after <size>, e.g. \"100M\"\n"
+   "   -Y <interval>   Rotate -o/-J files every <interval>, e.g. \"1h\"\n"
+   "   -z <method>     Compress -o/-J files with \"gzip\" or \"zstd\"\n"
+   "   --from <time>   Show only records from <time>, e.g. \"14:05\"\n"
+   "   --to <time>     Show only records before <time>\n\n");
    }
 
 /**********************************************************************/
 /* Purpose:    Main function
  * Called by:  From command line
  * Arguments:  Program name, plus zero or more options
- * Actions:    Sets filters according to argument list, then loops to
- *             assemble un-named JSON objects from stdin, dispatching
- *             completed objects to the process_json() function.
+ * Actions:    Sets filters according to argument list, then calls
+ *             frame_stream() to assemble un-named JSON objects from
+ *             stdin, or frame_mapped() to find them in a replay file,
+ *             dispatching completed objects to process_json().  With
+ *             "-M", or more than one input, input_run() reads them all
+ *             together instead.
  * Returns:    0 upon normal exit, else -1
  * Notes:      x
  * Created:    24/10/2025 by Paula Dowie G8PZT.
- * Modified:   */
+ * Modified:   14/10/2026 to queue the input with "-Q", and to take
+ *             "--from" and "--to". */
 /**********************************************************************/
 
 int main (int argc, char *argv[])
    {
-   char  buffer [4096], *cp;
-   int   braceLevel = 0;
-   int   c, ch, escaped = 0, inString=0;
+   int   c, rc = 0;
 
    uprintf ("\n\"pnmptrace\" JSON to AX25 Trace Decoder for PNMP\n");
    uprintf ("Version %s, Copyright (C) 2025 G8PZT\n\n", VERSION);
@@ -1275,162 +10989,414 @@ int main (int argc, char *argv[])
 
     while (1)
       {
-      if ((c = getopt (argc, argv, "34a:cijklnqsuhHWf:o:p:r:t:P:T:w:")) < 0)
-         break;   // End of options
+      c = getopt_long (argc, argv, Options, LongOptions, NULL);
+      if (c < 0) break;    // End of options
 
       switch (c)
          {
-         case 'h':   showHelp ();                        return (0);
-         case 'c':   TraceFlags &= ~TRACE_COLOR;         break;
-         case 'C':   TraceFlags |= TRACE_COLOR2FILE;     break;
-         case 'u':   TraceFlags &= ~TRACE_UI;            break;
-         case 'i':   TraceFlags &= ~TRACE_INP3;          break;
-         case 'n':   TraceFlags &= ~TRACE_NODES;         break;
-         case '3':   TraceFlags &= ~TRACE_NETROM;        break;
-         case '4':   TraceFlags &= ~TRACE_L4;            break;
-         case 's':   TraceFlags &= ~TRACE_STAMP;         break;
-         case 'k':   TraceFlags &= ~TRACE_L3RTT;         break;
-         case 'l':   TraceFlags &= ~TRACE_LBRK;          break;
-         case 'j':   TraceFlags |= TRACE_JSON;           break;
-         case 'H':   TraceFlags |= TRACE_HDRLIN;         break;
-         case 'a':   strncpy (AllFilter, optarg, 15);    break;
-         case 'f':   strncpy (SrcFilter, optarg, 15);    break;
-         case 't':   strncpy (DstFilter, optarg, 15);    break;
-         case 'T':   strncpy (TypeFilter, optarg, 15);   break;
-         case 'r':   strncpy (ReportFilter, optarg, 15); break;
-         case 'o':   strncpy (CaptureFile, optarg, 255); break;
-         case 'p':   PortFilter = atoi (optarg);         break;
-         case 'P':   strncpy (ProtoFilter, optarg, 15);  break;
-         case 'q':   TraceFlags |= TRACE_QUIET;          break;
-         case 'w':   DisplayWidth = atoi (optarg);       break;
-         case 'W':   TraceFlags |= TRACE_WARNINGS;       break;
-         }
-      }
-
-   if (*CaptureFile)
-      {
-      if ((FpCapture = fopen (CaptureFile, "w")) == NULL)
-         {
-         printf ("Can't open capture file '%s'\n", CaptureFile);
+         case 'h':   out_flush (); showHelp ();          return (0);
+         case 'e':   strncpy (ConfigFile, optarg, 255);  break;
+         case 'b':   Bench = 1;                          break;
+         case 'G':   rc |= gen_option (optarg);          break;
+
+         case 'o':   strncpy (TraceLog.name, optarg, 255); break;
+         case 'J':   strncpy (JsonLog.name, optarg, 255);  break;
+         case 'z':   rc |= log_option (optarg);            break;
+
+         case 'X':   // Rotate the files after this size
+            if ((LogMaxBytes = log_limit (optarg, 0)) < 0)
+               {
+               printf ("Bad size '%s'\n", optarg);
+               rc = -1;
+               }
+            break;
+
+         case 'Y':   // Or at this interval
+            if ((LogMaxSecs = log_limit (optarg, 1)) < 0)
+               {
+               printf ("Bad interval '%s'\n", optarg);
+               rc = -1;
+               }
+            break;
+
+         case 'B':   strncpy (BinaryFile, optarg, 255);  break;
+         case 'I':   // Input file, may be given more than once
+            if (source_add (SRC_FILE, optarg) == NULL) rc = -1;
+            break;
+
+         case 'd':   dedup_option (optarg);              break;
+         case 'Q':   rc |= queue_option (optarg);        break;
+         case OPT_FROM: rc |= range_option (optarg, 0);  break;
+         case OPT_TO:   rc |= range_option (optarg, 1);  break;
+
+         case 'R':   // Reorder window for merging inputs, seconds
+            MergeWindow = atof (optarg) * 1000;
+            if (MergeWindow < 0) MergeWindow = 0;
+            break;
+
+         case 'F':   // Flush policy, "<n>" traces or "<n>s" seconds
+            if (strchr (optarg, 's')) FlushSecs = atoi (optarg);
+            else FlushRecords = atoi (optarg);
+            if (FlushRecords < 1) FlushRecords = 1;
+            break;
+
+         case 'S':   StatSecs = atoi (optarg);           break;
+         case 'N':   route_option (optarg);              break;
+         case 'L':   link_option (optarg);               break;
+
+         case 'V':   // Track L4 circuits, with this idle timeout
+            if ((CctTimeout = atoi (optarg)) <= 0)
+               CctTimeout = CCT_TIMEOUT;
+            break;
+
+         case 'O':   // Structured output format
+            if (emit_option (optarg) < 0)
+               {
+               printf ("Unknown output format '%s'\n", optarg);
+               rc = -1;
+               }
+            break;
+
+         case 'm':   // Number of decode threads
+            Threads = atoi (optarg);
+            if (Threads < 1) Threads = 1;
+            if (Threads > MAX_THREADS) Threads = MAX_THREADS;
+            break;
+
+         case 'M':   // Subscribe to MQTT broker instead of stdin
+#ifndef WIN32
+            rc |= mqtt_option (optarg);
+#else
+            printf ("MQTT is not supported on Windows\n");
+            rc = -1;
+#endif
+            break;
+
+         case 'E':   // Export metrics over HTTP
+#ifndef WIN32
+            strncpy (MetricAddr, optarg, sizeof (MetricAddr) - 1);
+            Metrics = 1;
+#else
+            printf ("Metrics are not supported on Windows\n");
+            rc = -1;
+#endif
+            break;
+
+         default:    // Filter and display options
+            if (config_option (&BaseConfig, c, optarg) < 0) rc = -1;
+            break;
+         }
+      }
+
+   // Filters and display options from a file, as if on command line
+   if (*ConfigFile && config_file (&BaseConfig, ConfigFile) < 0)
+      rc = -1;
+
+   ConfigArgc = argc;   // Kept for reloads
+   ConfigArgv = argv;
+
+   // The banner is held back until the output format is known
+   if (OutFormat != OUTF_TEXT || GenCount) MainOut.screen.len = 0;
+   out_flush ();
+
+   if (rc) return (-1);   // Bad filter list, already reported
+
+   if (GenCount) return (gen_run ());   // Just write a corpus
+
+   Timing = Metrics || Bench;
+
+#ifdef WIN32
+   if (NumSources > 1)
+      {
+      printf ("Only one input is supported on Windows\n");
+      return (-1);
+      }
+#endif
+
+   Merging = (NumSources > 1);
+
+   if (DedupWindow > 0
+   && (DedupTable = calloc (DedupSlots, sizeof (DEDUPENT))) == NULL)
+      {
+      printf ("Not enough memory for %d duplicate slots\n", DedupSlots);
+      return (-1);
+      }
+
+   if (*TraceLog.name || *JsonLog.name)
+      {
+      if (log_start () < 0) return (-1);
+
+      if (*TraceLog.name && OutFormat == OUTF_TEXT)
+         printf ("Capturing traces to file '%s'\n", TraceLog.path);
+
+      if (*JsonLog.name && OutFormat == OUTF_TEXT)
+         printf ("Archiving JSON to file '%s'\n", JsonLog.path);
+      }
+
+#ifndef WIN32
+   if (Metrics)
+      {
+      if (metric_start () < 0) return (-1);
+      if (OutFormat == OUTF_TEXT)
+         printf ("Serving metrics on %s\n", MetricAddr);
+      }
+#endif
+
+   if (*BinaryFile)
+      {
+      if (cap_open (BinaryFile) < 0)
+         {
+         printf ("Can't open binary capture file '%s'\n", BinaryFile);
          return (-1);
          }
-      printf ("Capturing traces to file '%s'\n", CaptureFile);
+      printf ("Saving records to binary file '%s'\n", BinaryFile);
       }
 
-   if (*ReportFilter)
-      uprintf ("Showing reports from node '%s' only\n", ReportFilter);
+   mnem_initAll ();
+   filter_build (&BaseConfig);
+
+   if (Cfg->reportFilter.count)
+      uprintf ("Showing reports from node '%s' only\n",
+         Cfg->reportFilter.desc);
 
-   if (PortFilter)
+   if (Cfg->portFilter)
       uprintf ("Showing frames to/from port (%d) only\n",
-         PortFilter);
+         Cfg->portFilter);
 
-   if (*SrcFilter)
+   if (Cfg->srcFilter.count)
       uprintf ("Showing frames with L2 source call '%s' only\n",
-         SrcFilter);
+         Cfg->srcFilter.desc);
 
-   if (*DstFilter)
+   if (Cfg->dstFilter.count)
       uprintf ("Showing frames with L2 destination call '%s' only\n",
-         DstFilter);
+         Cfg->dstFilter.desc);
 
-   if (*AllFilter)
-      uprintf ("Showing frames to/from L2 call '%s' only\n", AllFilter);
+   if (Cfg->allFilter.count)
+      uprintf ("Showing frames to/from L2 call '%s' only\n",
+         Cfg->allFilter.desc);
 
-   if (*TypeFilter)
-      uprintf ("Showing '%s' frames only\n", TypeFilter);
+   if (Cfg->typeFilter.count)
+      uprintf ("Showing '%s' frames only\n", Cfg->typeFilter.desc);
 
-   if (*ProtoFilter)
+   if (Ranged) uprintf ("Showing records from %s to %s only\n",
+      RangeDesc [0], RangeDesc [1]);
+
+   if (Cfg->protoFilter.count)
       uprintf ("Showing frames with L3 protocol '%s' only\n",
-         ProtoFilter);
+         Cfg->protoFilter.desc);
 
-   if ((TraceFlags & TRACE_UI) == 0) uprintf ("Not showing UI frames\n");
+   if ((Cfg->traceFlags & TRACE_UI) == 0)
+      uprintf ("Not showing UI frames\n");
 
-   if ((TraceFlags & TRACE_NETROM) == 0)
+   if ((Cfg->traceFlags & TRACE_NETROM) == 0)
       uprintf ("Not decoding NODES broadcasts\n");
 
-   if ((TraceFlags & TRACE_INP3) == 0)
+   if ((Cfg->traceFlags & TRACE_INP3) == 0)
       uprintf ("Not decoding INP3 unicasts\n");
 
-   if ((TraceFlags & TRACE_NETROM) == 0)
+   if ((Cfg->traceFlags & TRACE_NETROM) == 0)
       uprintf ("Not decoding NetRom Layer 3 or above\n");
 
-   if ((TraceFlags & TRACE_L4) == 0)
+   if ((Cfg->traceFlags & TRACE_L4) == 0)
       uprintf ("Not decoding NetRom Layer 4 or above\n");
 
-   if ((TraceFlags & TRACE_L3RTT) == 0)
+   if ((Cfg->traceFlags & TRACE_L3RTT) == 0)
       uprintf ("Not showing L3RTT frame contents\n");
 
-   if (TraceFlags & TRACE_JSON) uprintf ("Including JSON data\n");
+   if (Cfg->traceFlags & TRACE_JSON) uprintf ("Including JSON data\n");
 
-   if ((TraceFlags & TRACE_STAMP) == 0)
+   if ((Cfg->traceFlags & TRACE_STAMP) == 0)
       uprintf ("Time stamp disabled\n");
 
-   cp = buffer;
+   if (FlushSecs) uprintf ("Flushing output every %d seconds\n",
+      FlushSecs);
 
-   while (1)   // Forever loop
-      {
-      // Get a char from stdin - blocking
-      if ((ch = getchar ()) == EOF) break;
+   else if (FlushRecords > 1)
+      uprintf ("Flushing output every %d traces\n", FlushRecords);
 
-      if (braceLevel == 0) // Waiting for opening brace
+   if (StatSecs >= 0)
+      {
+      if ((StatRow = calloc (STAT_MAX, sizeof (STATROW))) == NULL)
          {
-         if (ch == '{')    // Found the opening brace
-            {
-            braceLevel = 1;
-            cp = buffer;   // Point cp at start of object buffer
-            }
-         continue;
+         printf ("Not enough memory for statistics\n");
+         return (-1);
          }
 
-      // If we get here, braceLevel is > 0
+      Threads = 1;   // See stat_count()
+      StatLast = time (NULL);
+
+      if (StatSecs) uprintf ("Showing statistics every %d seconds\n",
+         StatSecs);
+      else uprintf ("Showing statistics on exit\n");
+      }
 
-      if (ch == '}')       // Possible end of object
+   if (RouteSecs >= 0)
+      {
+      if ((RouteTable = calloc (RouteSlots, sizeof (ROUTE))) == NULL)
          {
-         if (!escaped            // If not in "escaped" mode,
-         && !inString            // and not within a string,
-         && --braceLevel == 0)   // and it is the final brace
-            {
-            *cp++ = 0;              // Terminate the string
-            process_json (buffer);  // Process the object
-            cp = buffer;            // Reset the pointer
-            continue;
-            }
+         printf ("Not enough memory for %d routes\n", RouteSlots);
+         return (-1);
          }
 
-      *cp++ = ch;     // Copy the character to the object buffer
+      Threads = 1;   // See route_count()
+      RouteLast = time (NULL);
 
-      if (ch == '{'     // Possible start of object within object
-      && !escaped && !inString)
-         {
-         braceLevel++;
-         continue;
-         }
+      if (RouteSecs) uprintf ("Showing the route table every %d "
+         "seconds\n", RouteSecs);
+      else uprintf ("Showing the route table on exit\n");
+      }
 
-      if (escaped)
-         {
-         escaped = 0;
-         continue;
-         }
-      else  // Not in escaped mode
+   if (LinkSecs >= 0)
+      {
+      if ((LinkTable = calloc (LinkSlots, sizeof (LINK))) == NULL)
          {
-         if (ch == '\\')   // If it's the escape character
-            {
-            escaped = 1;   // Set escaped mode
-            continue;
-            }
+         printf ("Not enough memory for %d links\n", LinkSlots);
+         return (-1);
          }
 
-      // Not escape and not '\'
+      Threads = 1;   // See link_count()
+      LinkLast = time (NULL);
+
+      if (LinkSecs) uprintf ("Showing the link table every %d "
+         "seconds\n", LinkSecs);
+      else uprintf ("Showing the link table on exit\n");
+      }
+
+   if (CctTimeout >= 0)
+      {
+      Threads = 1;   // See cct_count()
+      uprintf ("Tracking circuits, idle timeout %d seconds\n",
+         CctTimeout);
+      }
+
+   if (Threads > 1) uprintf ("Decoding with %d threads\n", Threads);
+
+   // The tables are only kept single-threaded, see stat_count()
+   if (StatSecs >= 0 || RouteSecs >= 0 || CctTimeout >= 0
+   || LinkSecs >= 0) QueueSlots = 0;
+
+   if (QueueSlots)
+      uprintf ("Queueing up to %d records, policy \"%s\"\n",
+         QueueSlots, QueuePolicies [QueuePolicy]);
+
+#ifndef WIN32
+   for (c = 0; c < NumSources; c++)
+      {
+      if (Sources [c].type == SRC_MQTT)
+         uprintf ("Subscribing to '%s' at %s:%s\n", Sources [c].topic,
+            Sources [c].host, Sources [c].port);
+      }
+#endif
+
+   if (DedupWindow > 0)
+      uprintf ("Dropping duplicate frames within %d seconds\n",
+         DedupWindow);
+
+#ifndef WIN32
+   if (*ConfigFile)
+      uprintf ("Reloading options from '%s' on SIGHUP\n", ConfigFile);
+#endif
+
+   if (Merging)
+      uprintf ("Merging %d inputs, reorder window %g seconds\n",
+         NumSources, MergeWindow / 1000.0);
+
+   // A structured output stream starts with the records
+   if (OutFormat != OUTF_TEXT)
+      {
+      MainOut.screen.len = MainOut.file.len = 0;
+      if (OutFormat == OUTF_CSV) emit_header ();
+      }
+
+   out_flush ();
+   LastFlush = time (NULL);
+   BenchStart = metric_now ();
 
-      if (ch == '"') // Start of end of string
+#ifdef WIN32
+   signal (SIGINT, on_signal);
+   signal (SIGTERM, on_signal);
+#else
+   {
+   struct sigaction  sa;
+
+   memset (&sa, 0, sizeof (sa));
+   sa.sa_handler = on_signal;    // No SA_RESTART, so read() returns
+   sigaction (SIGINT, &sa, NULL);
+   sigaction (SIGTERM, &sa, NULL);
+
+   // SIGUSR1 asks for the route table now
+   if (RouteSecs >= 0)
+      {
+      sa.sa_handler = on_query;
+      sigaction (SIGUSR1, &sa, NULL);
+      }
+
+   // SIGHUP asks for the filters to be reloaded
+   if (*ConfigFile)
+      {
+      sa.sa_handler = on_reload;
+      sigaction (SIGHUP, &sa, NULL);
+      }
+
+#ifdef PROFILE
+   sa.sa_handler = on_profile;   // SIGUSR2 asks for the profile
+   sigaction (SIGUSR2, &sa, NULL);
+#endif
+   }
+#endif
+
+   if (Threads > 1 && pipe_start () < 0)
+      {
+      printf ("Can't start decode threads\n");
+      Threads = 1;
+      }
+
+   if (QueueSlots && queue_start () < 0)
+      {
+      printf ("Can't start input queue\n");
+      QueueSlots = 0;
+      }
+
+   if (NumSources == 0) frame_stream (STDIN_FILENO);
+
+   // A single file is replayed in place, and needn't be merged
+   else if (NumSources == 1 && Sources [0].type == SRC_FILE)
+      {
+      if (strcmp (Sources [0].name, "-") == 0)
+         frame_stream (STDIN_FILENO);
+
+      else if (frame_mapped (Sources [0].name) < 0)
          {
-         if (inString) inString = 0;
-         else inString = 1;
-         continue;
+         printf ("Can't open input file '%s'\n", Sources [0].name);
+         rc = -1;
          }
+      }
+
+#ifndef WIN32
+   else rc = input_run ();
+#endif
 
-      }  // end of while()
+   if (QueueSlots) queue_stop ();
+   if (Threads > 1) pipe_stop ();
 
-   if (FpCapture) fclose (FpCapture);
+   if (StatSecs >= 0) stat_print (time (NULL));
+   if (RouteSecs >= 0) route_print (time (NULL));
+   if (CctTimeout >= 0) cct_report ();
+   if (LinkSecs >= 0) link_print (time (NULL));
 
-   return (0);
+   out_flush ();
+
+   filter_report_counts ();
+   if (Bench) bench_report ();
+#ifdef PROFILE
+   prof_report ();
+#endif
+   dedup_report ();
+   queue_report ();
+   cap_report ();
+
+   log_stop ();
+   cap_close ();
+
+   return (rc);
    }